@@ -3,8 +3,17 @@
 layout (location = 0) in vec3 aPos;  // position from your ground mesh
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Per frame camera and light data, written once a frame by FrameUniforms (std140, mirrors FrameData)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPos;     // w unused
+    vec4 lightPos;      // w unused
+    vec4 lightColor;    // w unused
+    vec4 ambientLight;
+};
 
 out vec3 worldPos;
 
@@ -12,5 +21,5 @@ void main()
 {
     vec4 world = model * vec4(aPos, 1.0);
     worldPos = world.xyz;  // pass to fragment shader
-    gl_Position = projection * view * world;
+    gl_Position = viewProj * world;
 }
\ No newline at end of file
@@ -7,11 +7,20 @@ layout(location = 2) in vec2 aTex;     // optional
 out vec2 TexCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Per frame camera and light data, written once a frame by FrameUniforms (std140, mirrors FrameData)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPos;     // w unused
+    vec4 lightPos;      // w unused
+    vec4 lightColor;    // w unused
+    vec4 ambientLight;
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = viewProj * model * vec4(aPos, 1.0);
     TexCoord = aTex;
 }
\ No newline at end of file
@@ -3,12 +3,23 @@
 in vec3 Normal;
 in vec2 TexCoord;
 in vec3 FragPos;
+flat in int Layer;
 
-uniform vec4 ambientLight = vec4(0.5f,0.5f,0.5f, 1);
+// Per frame camera and light data, written once a frame by FrameUniforms (std140, mirrors FrameData)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPos;     // w unused
+    vec4 lightPos;      // w unused
+    vec4 lightColor;    // w unused
+    vec4 ambientLight;
+};
 
-uniform vec3 lightPos;
-uniform vec3 lightColor = vec3(1);
 uniform sampler2D texture_diffuse1;
+// Skins: sample this layer of the texture array instead of texture_diffuse1
+uniform bool useTextureArray = false;
+uniform sampler2DArray textureArray;
 
 
 out vec4 FragColor;
@@ -16,12 +27,13 @@ void main()
 {
     vec3 norm = normalize(Normal);
     
-    float dist = length(lightPos - FragPos);
+    float dist = length(lightPos.xyz - FragPos);
     float attenuation = 1.0 / (dist * dist);
     
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse =  diff * lightColor;
-    vec3 result = (diffuse + ambientLight.xyz) * attenuation * texture(texture_diffuse1, TexCoord).xyz ;
+    vec3 diffuse =  diff * lightColor.rgb;
+    vec3 albedo = useTextureArray ? texture(textureArray, vec3(TexCoord, Layer)).xyz : texture(texture_diffuse1, TexCoord).xyz;
+    vec3 result = (diffuse + ambientLight.xyz) * attenuation * albedo;
     FragColor = vec4(result, 1);
 }
\ No newline at end of file
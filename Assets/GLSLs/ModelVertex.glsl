@@ -3,20 +3,102 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTex;
+// Texture array layer (skin), a constant attribute set per draw
+layout (location = 3) in float aLayer;
+// Per instance data for Model::DrawInstanced, the instance transforms reach the shader through objectData
+layout (location = 8) in float aInstanceLayer;
+// Skinning, joint indices into the palette and unorm8 weights (Mesh::AttachSkin)
+layout (location = 9) in uvec4 aJoints;
+layout (location = 10) in vec4 aWeights;
+// Per instance Animator character
+layout (location = 11) in float aInstancePose;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Matrices of every draw and instance (ObjectBuffer), 11 texels from (objectBase + gl_InstanceID) * 11 on:
+// MVP, world and the normal matrix columns
+uniform samplerBuffer objectData;
+uniform int objectBase = 0;
+// Instanced draws share one object per copy between every mesh, the mesh's node matrix goes under it
+uniform mat4 nodeMatrix;
+uniform mat3 nodeNormalMatrix;
+
+// Per frame camera and light data, written once a frame by FrameUniforms (std140, mirrors FrameData)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPos;     // w unused
+    vec4 lightPos;      // w unused
+    vec4 lightColor;    // w unused
+    vec4 ambientLight;
+};
+
+uniform bool instanced = false;
+
+// Joint matrices of every character as 4 texels each (SkinPalette), a draw reads paletteStride of them from its pose on
+uniform bool skinned = false;
+uniform samplerBuffer bonePalette;
+uniform int pose = 0;
+uniform int paletteStride = 0;
+
+// Compact vertex format: positions are unorm16 inside the mesh AABB, normals octahedral encoded
+uniform bool compactVertices = false;
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
 
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
+flat out int Layer;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+mat4 objectMatrix(int texel)
+{
+    return mat4(texelFetch(objectData, texel), texelFetch(objectData, texel + 1),
+        texelFetch(objectData, texel + 2), texelFetch(objectData, texel + 3));
+}
+
+mat4 jointMatrix(int joint)
+{
+    int texel = joint * 4;
+    return mat4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+        texelFetch(bonePalette, texel + 2), texelFetch(bonePalette, texel + 3));
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = compactVertices ? boundsMin + aPos * boundsExtent : aPos;
+    vec3 normal = compactVertices ? octDecode(aNormal.xy) : aNormal;
+
+    // Skinned positions come out in model space, their object matrices then carry no node matrix
+    if (skinned) {
+        int base = (instanced ? int(aInstancePose + 0.5) : pose) * paletteStride;
+        mat4 skin = aWeights.x * jointMatrix(base + int(aJoints.x)) + aWeights.y * jointMatrix(base + int(aJoints.y))
+            + aWeights.z * jointMatrix(base + int(aJoints.z)) + aWeights.w * jointMatrix(base + int(aJoints.w));
+        position = vec3(skin * vec4(position, 1.0));
+        normal = mat3(skin) * normal;
+    }
+
+    vec4 local = vec4(position, 1.0);
+    if (instanced) {
+        local = nodeMatrix * local;
+        normal = nodeNormalMatrix * normal;
+    }
+
+    // Plain draws run as instance 0
+    int object = (objectBase + gl_InstanceID) * 11;
+    mat3 normalMatrix = mat3(texelFetch(objectData, object + 8).xyz, texelFetch(objectData, object + 9).xyz,
+        texelFetch(objectData, object + 10).xyz);
+    gl_Position = objectMatrix(object) * local;
     TexCoord = aTex;
-     Normal = mat3(transpose(inverse(model))) * aNormal;
-     Normal = aNormal;
-     FragPos = vec3(model * vec4(aPos, 1.0));
+    Layer = int((instanced && aInstanceLayer >= 0.0 ? aInstanceLayer : aLayer) + 0.5);
+    Normal = normalMatrix * normal;
+    FragPos = vec3(objectMatrix(object + 4) * local);
 }
\ No newline at end of file
@@ -8,10 +8,18 @@ out vec2 Texcoord;
 
 uniform vec3 overrideColor;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+// Per frame camera and light data, written once a frame by FrameUniforms (std140, mirrors FrameData)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 cameraPos;     // w unused
+    vec4 lightPos;      // w unused
+    vec4 lightColor;    // w unused
+    vec4 ambientLight;
+};
 void main(){
     Color = overrideColor * color;
     Texcoord = texcoord;
-    gl_Position = proj * view *  model * vec4(position, 1.0);
+    gl_Position = viewProj *  model * vec4(position, 1.0);
 }   
\ No newline at end of file
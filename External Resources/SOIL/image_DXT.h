@@ -45,6 +45,44 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	compress only the 4 pixel high block rows
+	[first_block_row, first_block_row + block_rows) into compressed,
+	which has to be sized for the whole image like the output of
+	convert_image_to_DXT1 / convert_image_to_DXT5.  Different rows of
+	one image can be compressed on different threads at the same time.
+	use_SIMD picks the SIMD block encoder when it is compiled in (see
+	DXT_has_SIMD), otherwise the scalar one
+**/
+void
+convert_image_to_DXT1_rows
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int first_block_row, int block_rows,
+    unsigned char *compressed, int use_SIMD
+);
+
+void
+convert_image_to_DXT5_rows
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int first_block_row, int block_rows,
+    unsigned char *compressed, int use_SIMD
+);
+
+/**
+	whether the SIMD block encoder is compiled in.  Without it use_SIMD
+	is ignored and the scalar reference runs, both produce the same bits
+	\return 1 if the SIMD encoder is compiled in, otherwise 0
+**/
+int
+DXT_has_SIMD
+(
+    void
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -43,6 +43,33 @@ int
 		int block_size_x, int block_size_y
 	);
 
+/**	filters for mipmap_image_rows	**/
+enum
+{
+	MIP_FILTER_BOX = 0,
+	MIP_FILTER_KAISER = 1
+};
+
+/**
+	Builds rows [first_row, first_row + row_count) of the next
+	MIPmap level (width/2 x height/2, at least 1) of an 8 bit image
+	with 1 to 4 channels.  Any size works, taps past the edge clamp.
+	MIP_FILTER_BOX averages 2x2 pixels, MIP_FILTER_KAISER is an
+	8x8 tap Kaiser windowed sinc.  With srgb set the color channels
+	are filtered in linear light (alpha, the last of 2 or 4 channels,
+	never is).  Different rows can be built on different threads.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	mipmap_image_rows
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int filter, int srgb,
+		int first_row, int row_count
+	);
+
 /**
 	This function takes the RGB components of the image
 	and scales each channel from [0,255] to [16,235].
@@ -0,0 +1,239 @@
+#pragma once
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ANIMATION_SSE 1
+#endif
+
+using namespace std;
+
+// Joints skinned meshes are bound to. Joint j follows hierarchy node jointNodes[j], inverseBind[j] takes
+// mesh space into that joint's bind space (aiBone::mOffsetMatrix)
+struct Skeleton {
+    vector<int> jointNodes;
+    vector<glm::mat4> inverseBind;
+
+    size_t JointCount() const { return jointNodes.size(); }
+    bool Empty() const { return jointNodes.empty(); }
+
+    // Index of the joint for this node and bind matrix, added if the pair is new
+    int Joint(int node, const glm::mat4& offset) {
+        for (size_t i = 0; i < jointNodes.size(); i++)
+            if (jointNodes[i] == node && inverseBind[i] == offset)
+                return (int)i;
+        jointNodes.push_back(node);
+        inverseBind.push_back(offset);
+        return (int)jointNodes.size() - 1;
+    }
+};
+
+// Local transform of one animated node, padded so a clip frame is a flat float array
+struct ChannelPose {
+    glm::vec4 translation = glm::vec4(0.0f);            // w unused
+    glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);  // quaternion x, y, z, w
+    glm::vec4 scale = glm::vec4(1.0f);                  // w unused
+};
+static_assert(sizeof(ChannelPose) == 48, "ChannelPose rows are blended as float arrays");
+
+// A clip resampled at a fixed rate on import. Frame f holds every channel's pose back to back, so sampling a
+// time is one blend between two contiguous rows instead of a key search per channel.
+// Rotations of neighbouring frames are kept in the same hemisphere, a blend plus normalize is then an nlerp
+struct AnimationClip {
+    static constexpr float DefaultFrameRate = 30.0f;
+
+    string name;
+    float duration = 0.0f;          // seconds
+    float frameRate = DefaultFrameRate;
+    vector<int> channelNodes;       // hierarchy node each channel drives
+    vector<ChannelPose> frames;     // FrameCount() rows of channelNodes.size() poses
+
+    size_t ChannelCount() const { return channelNodes.size(); }
+    size_t FrameCount() const { return channelNodes.empty() ? 0 : frames.size() / channelNodes.size(); }
+    const ChannelPose* Frame(size_t frame) const { return &frames[frame * channelNodes.size()]; }
+};
+
+// Plays clips on any number of characters sharing one skeleton and writes their joint matrices into one palette.
+// Characters are evaluated in chunks on the worker pool: blend two clip rows, build the animated locals,
+// walk the node arrays parent first and multiply the joints by their inverse bind matrices
+class Animator {
+public:
+    static constexpr int BindPose = -1;
+
+    // Binds the animator to a model's skeleton and clips, both have to outlive it. Drops every character
+    void Reset(const Skeleton& skeleton, const TransformHierarchy& hierarchy, const vector<AnimationClip>& clips) {
+        this->skeleton = &skeleton;
+        this->clips = &clips;
+        parents.resize(hierarchy.Size());
+        bindLocals.resize(hierarchy.Size());
+        for (size_t i = 0; i < hierarchy.Size(); i++) {
+            parents[i] = hierarchy.Parent((int)i);
+            bindLocals[i] = hierarchy.Local((int)i);
+        }
+        Clear();
+    }
+
+    // Returns the character's index, its joints start at index * JointCount() in the palette
+    size_t Add(int clip, float time = 0.0f, float speed = 1.0f) {
+        Character character;
+        character.clip = validClip(clip);
+        character.time = time;
+        character.speed = speed;
+        characters.push_back(character);
+        palette.resize(characters.size() * JointCount());
+        return characters.size() - 1;
+    }
+
+    // Restarts the character on another clip, BindPose holds the bind pose
+    void SetClip(size_t character, int clip) {
+        characters[character].clip = validClip(clip);
+        characters[character].time = 0.0f;
+    }
+
+    void Clear() {
+        characters.clear();
+        palette.clear();
+    }
+
+    size_t Count() const { return characters.size(); }
+    size_t JointCount() const { return skeleton ? skeleton->JointCount() : 0; }
+
+    // Advances every character and evaluates its pose, parallel spreads the characters over the worker pool
+    void Update(float deltaTime, bool parallel = true) {
+        auto updateStart = std::chrono::high_resolution_clock::now();
+        for (Character& character : characters) {
+            if (character.clip == BindPose)
+                continue;
+            float duration = (*clips)[character.clip].duration;
+            character.time += deltaTime * character.speed;
+            character.time = duration > 0.0f ? std::fmod(character.time, duration) : 0.0f;
+            if (character.time < 0.0f)
+                character.time += duration;
+        }
+
+        size_t chunks = (characters.size() + ChunkSize - 1) / ChunkSize;
+        auto evaluateChunk = [&](size_t chunk) {
+            Scratch scratch;
+            size_t end = std::min(characters.size(), (chunk + 1) * ChunkSize);
+            for (size_t c = chunk * ChunkSize; c < end; c++)
+                evaluate(characters[c], &palette[c * JointCount()], scratch);
+        };
+        if (parallel) {
+            ThreadPool::Instance().ParallelFor(chunks, evaluateChunk);
+        }
+        else {
+            for (size_t chunk = 0; chunk < chunks; chunk++)
+                evaluateChunk(chunk);
+        }
+        updateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - updateStart).count();
+    }
+
+    // Count() * JointCount() matrices, model space joint transform times inverse bind
+    const vector<glm::mat4>& Palette() const { return palette; }
+
+    float LastUpdateMs() const { return updateMs; }
+
+    // out = a + (b - a) * weight over count floats, 4 per SSE step
+    static void Blend(const float* a, const float* b, float weight, float* out, size_t count) {
+        size_t i = 0;
+#ifdef ANIMATION_SSE
+        __m128 w = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4) {
+            __m128 va = _mm_loadu_ps(a + i);
+            __m128 vb = _mm_loadu_ps(b + i);
+            _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+        }
+#endif
+        for (; i < count; i++)
+            out[i] = a[i] + (b[i] - a[i]) * weight;
+    }
+
+    // Translation * rotation * scale, the blended rotation is renormalized here
+    static void Compose(const ChannelPose& pose, glm::mat4& out) {
+        glm::quat rotation = glm::normalize(glm::quat(pose.rotation.w, pose.rotation.x, pose.rotation.y, pose.rotation.z));
+        glm::mat3 r = glm::mat3_cast(rotation);
+        out[0] = glm::vec4(r[0] * pose.scale.x, 0.0f);
+        out[1] = glm::vec4(r[1] * pose.scale.y, 0.0f);
+        out[2] = glm::vec4(r[2] * pose.scale.z, 0.0f);
+        out[3] = glm::vec4(glm::vec3(pose.translation), 1.0f);
+    }
+
+    // Inverse of Compose for matrices without shear, used for channels that leave a component unanimated
+    static ChannelPose Decompose(const glm::mat4& m) {
+        ChannelPose pose;
+        pose.translation = glm::vec4(glm::vec3(m[3]), 0.0f);
+        glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+        pose.scale = glm::vec4(scale, 1.0f);
+        glm::mat3 r;
+        for (int k = 0; k < 3; k++)
+            r[k] = scale[k] > 0.0f ? glm::vec3(m[k]) / scale[k] : glm::vec3(0.0f);
+        glm::quat q = glm::quat_cast(r);
+        pose.rotation = glm::vec4(q.x, q.y, q.z, q.w);
+        return pose;
+    }
+
+private:
+    struct Character {
+        int clip = BindPose;
+        float time = 0.0f;
+        float speed = 1.0f;
+    };
+
+    // Per chunk buffers so evaluation doesn't allocate per character
+    struct Scratch {
+        vector<ChannelPose> blended;
+        vector<glm::mat4> locals;
+        vector<glm::mat4> worlds;
+    };
+
+    static constexpr size_t ChunkSize = 16;
+
+    int validClip(int clip) const {
+        return clips && clip >= 0 && clip < (int)clips->size() && (*clips)[clip].FrameCount() > 0 ? clip : BindPose;
+    }
+
+    void evaluate(const Character& character, glm::mat4* out, Scratch& scratch) const {
+        scratch.locals = bindLocals;
+        if (character.clip != BindPose) {
+            const AnimationClip& clip = (*clips)[character.clip];
+            size_t frameCount = clip.FrameCount();
+            float frame = character.time * clip.frameRate;
+            size_t first = std::min((size_t)frame, frameCount - 1);
+            size_t second = std::min(first + 1, frameCount - 1);
+            float weight = std::min(std::max(frame - (float)first, 0.0f), 1.0f);
+
+            scratch.blended.resize(clip.ChannelCount());
+            Blend(&clip.Frame(first)->translation.x, &clip.Frame(second)->translation.x, weight,
+                &scratch.blended[0].translation.x, clip.ChannelCount() * sizeof(ChannelPose) / sizeof(float));
+            for (size_t c = 0; c < clip.ChannelCount(); c++)
+                Compose(scratch.blended[c], scratch.locals[clip.channelNodes[c]]);
+        }
+
+        scratch.worlds.resize(scratch.locals.size());
+        for (size_t i = 0; i < scratch.locals.size(); i++) {
+            if (parents[i] >= 0)
+                TransformHierarchy::Multiply(scratch.worlds[parents[i]], scratch.locals[i], scratch.worlds[i]);
+            else
+                scratch.worlds[i] = scratch.locals[i];
+        }
+        for (size_t j = 0; j < skeleton->JointCount(); j++)
+            TransformHierarchy::Multiply(scratch.worlds[skeleton->jointNodes[j]], skeleton->inverseBind[j], out[j]);
+    }
+
+private:
+    const Skeleton* skeleton = nullptr;
+    const vector<AnimationClip>* clips = nullptr;
+    vector<int> parents;
+    vector<glm::mat4> bindLocals;
+
+    vector<Character> characters;
+    vector<glm::mat4> palette;
+    float updateMs = 0.0f;
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "Model.h"
+#include "ObjLoader.h"
+#include "Animation.h"
+#include "DdsCache.h"
+
+using namespace std;
+
+// Console benchmarks, run from the viewer command line
+class Benchmarks {
+public:
+    // Times the native OBJ reader against the Assimp import + conversion for the same file.
+    // Both produce MeshData only, no optimization, cache or GL work is included
+    static void ObjImport(const string& path, int runs = 5) {
+        if (!ObjLoader::IsObjPath(path)) {
+            cout << "[Benchmark] Not an OBJ file: " << path << endl;
+            return;
+        }
+
+        cout << "[Benchmark] OBJ import: " << path << " (" << runs << " runs, best time)" << endl;
+
+        vector<MeshData> meshData;
+        double nativeMs = BestOf(runs, [&] { ObjLoader::Load(path, meshData); });
+        Report("Native", nativeMs, meshData);
+
+        vector<NodeData> nodes;
+        double assimpMs = BestOf(runs, [&] { Model::ImportAssimp(path, meshData, nodes); });
+        Report("Assimp", assimpMs, meshData);
+
+        if (nativeMs > 0.0)
+            cout << "  Speedup: " << assimpMs / nativeMs << "x" << endl;
+    }
+
+    // Animates characters copies of a rigged model through its clips, each starting at a different time, and times
+    // the pose evaluation per frame on the calling thread alone and spread over the worker pool, best of runs passes of
+    // frames each. CPU only, no upload
+    static void Skinning(const Model& model, int characters, int frames = 60, int runs = 5) {
+        if (!model.IsSkinned() || model.getClips().empty()) {
+            cout << "[Benchmark] Model has no skeleton or no clips" << endl;
+            return;
+        }
+
+        Animator animator;
+        animator.Reset(model.getSkeleton(), model.getHierarchy(), model.getClips());
+        const vector<AnimationClip>& clips = model.getClips();
+        for (int i = 0; i < characters; i++) {
+            const AnimationClip& clip = clips[i % clips.size()];
+            animator.Add(i % (int)clips.size(), clip.duration * (float)i / (float)std::max(characters, 1));
+        }
+
+        cout << "[Benchmark] Skinning: " << characters << " characters, " << animator.JointCount() << " joints, "
+            << (animator.Palette().size() * sizeof(glm::mat4)) / 1024 << " KB palette, " << frames << " frames, "
+            << runs << " runs, best time" << endl;
+
+        double serialMs = BestOf(runs, [&] {
+            for (int f = 0; f < frames; f++)
+                animator.Update(1.0f / 60.0f, false);
+        }) / std::max(frames, 1);
+        double parallelMs = BestOf(runs, [&] {
+            for (int f = 0; f < frames; f++)
+                animator.Update(1.0f / 60.0f, true);
+        }) / std::max(frames, 1);
+
+        cout << "  Serial: " << serialMs << " ms/frame" << endl;
+        cout << "  Parallel (" << ThreadPool::Instance().WorkerCount() + 1 << " threads): " << parallelMs << " ms/frame, "
+            << (parallelMs > 0.0 ? characters / parallelMs : 0.0) << " characters/ms" << endl;
+        if (parallelMs > 0.0)
+            cout << "  Speedup: " << serialMs / parallelMs << "x" << endl;
+    }
+
+    // Compresses one synthetic RGBA image (smooth gradients, hard edges and noise so every block is different)
+    // to BC1 and BC3 with the scalar reference encoder, the SIMD encoder on one thread and the SIMD encoder over
+    // the worker pool. Checks the SIMD blocks against the reference bit for bit
+    static void DxtCompression(int size = 2048, int runs = 3) {
+        vector<unsigned char> pixels((size_t)size * size * 4);
+        unsigned int noise = 12345;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                unsigned char* p = &pixels[((size_t)y * size + x) * 4];
+                noise = noise * 1664525u + 1013904223u;
+                p[0] = (unsigned char)(x * 255 / size);
+                p[1] = (unsigned char)((x / 64 + y / 64) % 2 ? 220 : 40);
+                p[2] = (unsigned char)(noise >> 24);
+                p[3] = (unsigned char)(y * 255 / size);
+            }
+        }
+
+        double megapixels = (double)size * size / 1e6;
+        cout << "[Benchmark] DXT compression: " << size << "x" << size << " RGBA, " << runs << " runs, best time" << endl;
+        bool simd = DXT_has_SIMD() != 0;
+        if (!simd)
+            cout << "  SIMD encoder not compiled in, every variant runs the scalar code" << endl;
+
+        for (int format = 0; format < 2; format++) {
+            bool alpha = format == 1;
+            const char* name = alpha ? "BC3 (DXT5)" : "BC1 (DXT1)";
+            vector<unsigned char> reference, blocks;
+
+            double scalarMs = BestOf(runs, [&] {
+                reference.clear();
+                DdsCache::CompressLevel(pixels.data(), size, size, 4, alpha, reference, false, false);
+            });
+            double simdMs = BestOf(runs, [&] {
+                blocks.clear();
+                DdsCache::CompressLevel(pixels.data(), size, size, 4, alpha, blocks, false);
+            });
+            bool simdExact = blocks == reference;
+            double parallelMs = BestOf(runs, [&] {
+                blocks.clear();
+                DdsCache::CompressLevel(pixels.data(), size, size, 4, alpha, blocks, true);
+            });
+            bool parallelExact = blocks == reference;
+
+            cout << "  " << name << endl;
+            cout << "    Scalar: " << scalarMs << " ms, " << MegapixelsPerSecond(megapixels, scalarMs) << " MPix/s" << endl;
+            cout << "    SIMD: " << simdMs << " ms, " << MegapixelsPerSecond(megapixels, simdMs) << " MPix/s, "
+                << (simdExact ? "matches" : "DIFFERS FROM") << " reference" << endl;
+            cout << "    SIMD parallel (" << ThreadPool::Instance().WorkerCount() + 1 << " threads): " << parallelMs << " ms, "
+                << MegapixelsPerSecond(megapixels, parallelMs) << " MPix/s, " << (parallelExact ? "matches" : "DIFFERS FROM")
+                << " reference" << endl;
+            if (simdMs > 0.0 && parallelMs > 0.0)
+                cout << "    Speedup: " << scalarMs / simdMs << "x SIMD, " << scalarMs / parallelMs << "x SIMD parallel" << endl;
+        }
+    }
+
+private:
+    static double MegapixelsPerSecond(double megapixels, double ms) {
+        return ms > 0.0 ? megapixels * 1000.0 / ms : 0.0;
+    }
+
+    template<typename F>
+    static double BestOf(int runs, F&& run) {
+        double best = 0.0;
+        for (int i = 0; i < std::max(runs, 1); i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            run();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if (i == 0 || ms < best)
+                best = ms;
+        }
+        return best;
+    }
+
+    static void Report(const char* name, double ms, const vector<MeshData>& meshData) {
+        size_t vertices = 0, triangles = 0;
+        for (const MeshData& data : meshData) {
+            vertices += data.vertices.size();
+            triangles += data.indices.size() / 3;
+        }
+        cout << "  " << name << ": " << ms << " ms, meshes=" << meshData.size()
+            << " verts=" << vertices << " tris=" << triangles << endl;
+    }
+};
@@ -0,0 +1,438 @@
+#pragma once
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Ray with its reciprocal direction cached for slab tests. t is measured in units of direction,
+// transforming a ray keeps t valid so hits from different spaces compare directly
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f), inverseDirection(0.0f, 0.0f, -1.0f) {}
+    Ray(const glm::vec3& Origin, const glm::vec3& Direction) : origin(Origin), direction(Direction) {
+        // Division by zero gives inf, which the slab test handles
+        inverseDirection = 1.0f / direction;
+    }
+
+    Ray Transformed(const glm::mat4& matrix) const {
+        return Ray(glm::vec3(matrix * glm::vec4(origin, 1.0f)), glm::vec3(matrix * glm::vec4(direction, 0.0f)));
+    }
+
+    // World space ray through a window position (pixels, origin top left)
+    static Ray FromScreen(float x, float y, float width, float height, const glm::mat4& view, const glm::mat4& projection) {
+        glm::vec4 viewport(0.0f, 0.0f, width, height);
+        glm::vec3 nearPoint = glm::unProject(glm::vec3(x, height - y, 0.0f), view, projection, viewport);
+        glm::vec3 farPoint = glm::unProject(glm::vec3(x, height - y, 1.0f), view, projection, viewport);
+        return Ray(nearPoint, glm::normalize(farPoint - nearPoint));
+    }
+};
+
+// Closest intersection found so far, t doubles as the search limit
+struct RayHit {
+    static constexpr uint32_t None = 0xFFFFFFFFu;
+
+    float t = FLT_MAX;
+    uint32_t mesh = None;
+    uint32_t triangle = None;       // index into the mesh's LOD0 triangles
+    glm::vec3 barycentric = glm::vec3(0.0f);   // weights of the triangle's three corners
+    uint32_t instance = None;       // InstanceBuffer handle for instance picks
+
+    bool Hit() const { return triangle != None; }
+};
+
+// 32 byte node, children of an inner node are adjacent and always stored after their parent
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t leftFirst;     // inner: left child (right is leftFirst + 1), leaf: first primitive in the order array
+    glm::vec3 boundsMax;
+    uint32_t count;         // primitives in a leaf, 0 for inner nodes
+
+    bool IsLeaf() const { return count > 0; }
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode should stay half a cache line");
+
+// Binned SAH build and traversal over arbitrary primitive boxes, used by the triangle and instance hierarchies
+class Bvh {
+public:
+    // Builds nodes (root at 0) and order (primitive index per leaf slot) from primitive boxes.
+    // Large subtrees are split on the worker pool
+    static void Build(const vector<glm::vec3>& boxMin, const vector<glm::vec3>& boxMax, vector<BvhNode>& nodes,
+        vector<uint32_t>& order, uint32_t maxLeafSize = 4) {
+        size_t count = boxMin.size();
+        nodes.clear();
+        order.resize(count);
+        if (count == 0)
+            return;
+        for (size_t i = 0; i < count; i++)
+            order[i] = (uint32_t)i;
+
+        Context context(boxMin, boxMax, nodes, order, maxLeafSize);
+        context.centroids.resize(count);
+        for (size_t i = 0; i < count; i++)
+            context.centroids[i] = (boxMin[i] + boxMax[i]) * 0.5f;
+
+        nodes.resize(count * 2);
+        context.nodeCount = 1;
+        Subdivide(context, 0, 0, (uint32_t)count, 0);
+        nodes.resize(context.nodeCount.load());
+    }
+
+    // Near distance of a slab test, FLT_MAX if the box is missed or further than tMax
+    static float IntersectBox(const Ray& ray, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float tMax) {
+        glm::vec3 t1 = (boundsMin - ray.origin) * ray.inverseDirection;
+        glm::vec3 t2 = (boundsMax - ray.origin) * ray.inverseDirection;
+        glm::vec3 tLow = glm::min(t1, t2);
+        glm::vec3 tHigh = glm::max(t1, t2);
+        float tNear = std::max(std::max(tLow.x, tLow.y), std::max(tLow.z, 0.0f));
+        float tFar = std::min(std::min(tHigh.x, tHigh.y), std::min(tHigh.z, tMax));
+        return tNear <= tFar ? tNear : FLT_MAX;
+    }
+
+    // Front to back traversal, leaf(first, count) tests primitives and may shrink tMax
+    template<typename LeafTest>
+    static void Traverse(const vector<BvhNode>& nodes, const Ray& ray, float& tMax, LeafTest&& leaf) {
+        if (nodes.empty() || IntersectBox(ray, nodes[0].boundsMin, nodes[0].boundsMax, tMax) == FLT_MAX)
+            return;
+
+        // One push per level at most, Build keeps every tree within MaxDepth levels
+        uint32_t stack[MaxDepth];
+        int top = 0;
+        uint32_t current = 0;
+        for (;;) {
+            const BvhNode& node = nodes[current];
+            if (node.IsLeaf()) {
+                leaf(node.leftFirst, node.count);
+            }
+            else {
+                uint32_t closer = node.leftFirst, further = node.leftFirst + 1;
+                float tCloser = IntersectBox(ray, nodes[closer].boundsMin, nodes[closer].boundsMax, tMax);
+                float tFurther = IntersectBox(ray, nodes[further].boundsMin, nodes[further].boundsMax, tMax);
+                if (tFurther < tCloser) {
+                    std::swap(closer, further);
+                    std::swap(tCloser, tFurther);
+                }
+                if (tCloser != FLT_MAX) {
+                    if (tFurther != FLT_MAX)
+                        stack[top++] = further;
+                    current = closer;
+                    continue;
+                }
+            }
+            // Pop, skipping subtrees a closer hit has ruled out
+            bool found = false;
+            while (top > 0) {
+                uint32_t next = stack[--top];
+                if (IntersectBox(ray, nodes[next].boundsMin, nodes[next].boundsMax, tMax) != FLT_MAX) {
+                    current = next;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+                return;
+        }
+    }
+
+    // Refits node bounds bottom up after primitive boxes moved, topology stays as built
+    static void Refit(vector<BvhNode>& nodes, const vector<uint32_t>& order, const vector<glm::vec3>& boxMin, const vector<glm::vec3>& boxMax) {
+        for (size_t i = nodes.size(); i-- > 0;) {
+            BvhNode& node = nodes[i];
+            if (node.IsLeaf()) {
+                node.boundsMin = glm::vec3(FLT_MAX);
+                node.boundsMax = glm::vec3(-FLT_MAX);
+                for (uint32_t p = node.leftFirst; p < node.leftFirst + node.count; p++) {
+                    node.boundsMin = glm::min(node.boundsMin, boxMin[order[p]]);
+                    node.boundsMax = glm::max(node.boundsMax, boxMax[order[p]]);
+                }
+            }
+            else {
+                const BvhNode& left = nodes[node.leftFirst];
+                const BvhNode& right = nodes[node.leftFirst + 1];
+                node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+                node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+            }
+        }
+    }
+
+    // Deepest a built tree gets, the traversal stack holds this many nodes
+    static constexpr uint32_t MaxDepth = 64;
+
+private:
+    static constexpr int BinCount = 16;
+    // Nodes this deep split at the object median instead of by SAH. Halving a uint32_t count reaches single
+    // primitives within 32 more levels, so even degenerate input (e.g. boxes nested along one axis) stays within MaxDepth
+    static constexpr uint32_t MedianDepth = MaxDepth - 32;
+    // Subtrees with more primitives than this build their two halves in parallel
+    static constexpr uint32_t ParallelThreshold = 16384;
+
+    struct Context {
+        const vector<glm::vec3>& boxMin;
+        const vector<glm::vec3>& boxMax;
+        vector<BvhNode>& nodes;
+        vector<uint32_t>& order;
+        uint32_t maxLeafSize;
+        vector<glm::vec3> centroids;
+        std::atomic<uint32_t> nodeCount{ 0 };
+
+        Context(const vector<glm::vec3>& BoxMin, const vector<glm::vec3>& BoxMax, vector<BvhNode>& Nodes,
+            vector<uint32_t>& Order, uint32_t MaxLeafSize)
+            : boxMin(BoxMin), boxMax(BoxMax), nodes(Nodes), order(Order), maxLeafSize(MaxLeafSize) {}
+    };
+
+    static float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 e = boundsMax - boundsMin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    static void Subdivide(Context& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) {
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t p = context.order[i];
+            boundsMin = glm::min(boundsMin, context.boxMin[p]);
+            boundsMax = glm::max(boundsMax, context.boxMax[p]);
+            centroidMin = glm::min(centroidMin, context.centroids[p]);
+            centroidMax = glm::max(centroidMax, context.centroids[p]);
+        }
+
+        BvhNode& node = context.nodes[nodeIndex];
+        node.boundsMin = boundsMin;
+        node.boundsMax = boundsMax;
+        node.leftFirst = first;
+        node.count = count;
+        if (count <= context.maxLeafSize)
+            return;
+
+        if (depth >= MedianDepth) {
+            // Halve along the widest centroid axis
+            glm::vec3 extent = centroidMax - centroidMin;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            uint32_t* begin = context.order.data() + first;
+            std::nth_element(begin, begin + count / 2, begin + count, [&](uint32_t a, uint32_t b) {
+                return context.centroids[a][axis] < context.centroids[b][axis];
+            });
+            Split(context, node, first, count, first + count / 2, depth);
+            return;
+        }
+
+        // Bin every primitive on all three axes in one pass, the boxes are read once per level
+        glm::vec3 scale(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            scale[axis] = extent > 0.0f ? BinCount / extent : 0.0f;
+        }
+        uint32_t binCounts[3][BinCount] = {};
+        glm::vec3 binMin[3][BinCount], binMax[3][BinCount];
+        for (int axis = 0; axis < 3; axis++) {
+            for (int b = 0; b < BinCount; b++) {
+                binMin[axis][b] = glm::vec3(FLT_MAX);
+                binMax[axis][b] = glm::vec3(-FLT_MAX);
+            }
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t p = context.order[i];
+            const glm::vec3& low = context.boxMin[p];
+            const glm::vec3& high = context.boxMax[p];
+            glm::vec3 bins = (context.centroids[p] - centroidMin) * scale;
+            for (int axis = 0; axis < 3; axis++) {
+                int b = std::min(BinCount - 1, (int)bins[axis]);
+                binCounts[axis][b]++;
+                binMin[axis][b] = glm::min(binMin[axis][b], low);
+                binMax[axis][b] = glm::max(binMax[axis][b], high);
+            }
+        }
+
+        // Sweep each axis from the right, then from the left evaluating every plane
+        int bestAxis = -1, bestBin = 0;
+        float bestCost = FLT_MAX;
+        for (int axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f)
+                continue;
+            float rightArea[BinCount];
+            uint32_t rightCount[BinCount];
+            glm::vec3 runMin(FLT_MAX), runMax(-FLT_MAX);
+            uint32_t runCount = 0;
+            for (int b = BinCount - 1; b > 0; b--) {
+                runCount += binCounts[axis][b];
+                runMin = glm::min(runMin, binMin[axis][b]);
+                runMax = glm::max(runMax, binMax[axis][b]);
+                rightCount[b] = runCount;
+                rightArea[b] = runCount ? HalfArea(runMin, runMax) : 0.0f;
+            }
+            runMin = glm::vec3(FLT_MAX);
+            runMax = glm::vec3(-FLT_MAX);
+            runCount = 0;
+            for (int b = 0; b < BinCount - 1; b++) {
+                runCount += binCounts[axis][b];
+                runMin = glm::min(runMin, binMin[axis][b]);
+                runMax = glm::max(runMax, binMax[axis][b]);
+                if (runCount == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = runCount * HalfArea(runMin, runMax) + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        // SAH with unit traversal and intersection costs, a leaf costs its primitive count
+        float parentArea = HalfArea(boundsMin, boundsMax);
+        float splitCost = parentArea > 0.0f ? 1.0f + bestCost / parentArea : FLT_MAX;
+        if (bestAxis >= 0 && splitCost >= (float)count && count <= context.maxLeafSize * 4)
+            return;
+
+        uint32_t middle;
+        if (bestAxis >= 0) {
+            float low = centroidMin[bestAxis];
+            float axisScale = scale[bestAxis];
+            uint32_t* begin = context.order.data() + first;
+            uint32_t* split = std::partition(begin, begin + count, [&](uint32_t p) {
+                return std::min(BinCount - 1, (int)((context.centroids[p][bestAxis] - low) * axisScale)) <= bestBin;
+            });
+            middle = (uint32_t)(split - context.order.data());
+        }
+        else {
+            // Every centroid coincides, halve the range so leaves stay small
+            middle = first + count / 2;
+        }
+        if (middle == first || middle == first + count)
+            middle = first + count / 2;
+        Split(context, node, first, count, middle, depth);
+    }
+
+    // Turns node into an inner node over [first, middle) and [middle, first + count) and builds both children
+    static void Split(Context& context, BvhNode& node, uint32_t first, uint32_t count, uint32_t middle, uint32_t depth) {
+        uint32_t left = context.nodeCount.fetch_add(2);
+        node.leftFirst = left;
+        node.count = 0;
+
+        uint32_t leftCount = middle - first;
+        uint32_t rightCount = count - leftCount;
+        if (count > ParallelThreshold) {
+            ThreadPool::Instance().ParallelFor(2, [&](size_t side) {
+                if (side == 0) Subdivide(context, left, first, leftCount, depth + 1);
+                else Subdivide(context, left + 1, middle, rightCount, depth + 1);
+            });
+        }
+        else {
+            Subdivide(context, left, first, leftCount, depth + 1);
+            Subdivide(context, left + 1, middle, rightCount, depth + 1);
+        }
+    }
+};
+
+// Where a mesh's LOD0 triangles come from, positions are float xyz at any stride
+struct BvhTriangleSource {
+    const unsigned char* positions = nullptr;
+    size_t positionStride = 0;      // bytes
+    size_t vertexCount = 0;
+    const void* indices = nullptr;  // nullptr = unindexed triangle list
+    size_t indexSize = 4;           // bytes per index, 1, 2 or 4
+    size_t indexCount = 0;
+
+    size_t TriangleCount() const { return (indices ? indexCount : vertexCount) / 3; }
+
+    // Position of corner i of the triangle list
+    glm::vec3 Corner(size_t i) const {
+        size_t vertex = i;
+        if (indices) {
+            switch (indexSize) {
+            case 1: vertex = static_cast<const uint8_t*>(indices)[i]; break;
+            case 2: vertex = static_cast<const uint16_t*>(indices)[i]; break;
+            default: vertex = static_cast<const uint32_t*>(indices)[i]; break;
+            }
+        }
+        const float* p = reinterpret_cast<const float*>(positions + vertex * positionStride);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+};
+
+// Triangle hierarchy of one mesh in object space, keeps its own copy of the corners in leaf order
+class MeshBvh {
+public:
+    void Build(const BvhTriangleSource& source) {
+        size_t triangleCount = source.TriangleCount();
+        vector<glm::vec3> boxMin(triangleCount), boxMax(triangleCount);
+        vector<glm::vec3> triangleCorners(triangleCount * 3);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++)
+                triangleCorners[t * 3 + k] = source.Corner(t * 3 + k);
+            boxMin[t] = glm::min(triangleCorners[t * 3], glm::min(triangleCorners[t * 3 + 1], triangleCorners[t * 3 + 2]));
+            boxMax[t] = glm::max(triangleCorners[t * 3], glm::max(triangleCorners[t * 3 + 1], triangleCorners[t * 3 + 2]));
+        }
+
+        Bvh::Build(boxMin, boxMax, nodes, triangleIds);
+
+        // Store corners in leaf order so a leaf reads one contiguous block
+        corners.resize(triangleCount * 3);
+        for (size_t i = 0; i < triangleCount; i++)
+            for (int k = 0; k < 3; k++)
+                corners[i * 3 + k] = triangleCorners[triangleIds[i] * 3 + k];
+    }
+
+    // Updates hit if this mesh has a closer triangle, returns true if it did
+    bool Intersect(const Ray& ray, RayHit& hit) const {
+        bool found = false;
+        Bvh::Traverse(nodes, ray, hit.t, [&](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; i++) {
+                float t, u, v;
+                if (IntersectTriangle(ray, corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2], t, u, v) && t < hit.t) {
+                    hit.t = t;
+                    hit.triangle = triangleIds[i];
+                    hit.barycentric = glm::vec3(1.0f - u - v, u, v);
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+    size_t TriangleCount() const { return triangleIds.size(); }
+    size_t NodeCount() const { return nodes.size(); }
+    bool Empty() const { return nodes.empty(); }
+
+    size_t MemoryBytes() const {
+        return nodes.capacity() * sizeof(BvhNode) + corners.capacity() * sizeof(glm::vec3) + triangleIds.capacity() * sizeof(uint32_t);
+    }
+
+    const glm::vec3& BoundsMin() const { return nodes[0].boundsMin; }
+    const glm::vec3& BoundsMax() const { return nodes[0].boundsMax; }
+
+    // Moller-Trumbore, double sided
+    static bool IntersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t, float& u, float& v) {
+        glm::vec3 edge1 = b - a;
+        glm::vec3 edge2 = c - a;
+        glm::vec3 p = glm::cross(ray.direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::fabs(determinant) < 1e-12f)
+            return false;
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = ray.origin - a;
+        u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        v = glm::dot(ray.direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = glm::dot(edge2, q) * inverse;
+        return t >= 0.0f;
+    }
+
+private:
+    vector<BvhNode> nodes;
+    vector<glm::vec3> corners;      // 3 per triangle, leaf order
+    vector<uint32_t> triangleIds;   // leaf order -> source triangle
+};
@@ -122,13 +122,10 @@ public:
         cameraRight = glm::normalize(glm::cross(cameraFront, up));
         cameraUp = glm::normalize(glm::cross(cameraRight, cameraFront));
     }
-    public: void CameraUpdate(GLFWwindow* window, float deltaTime, GLuint shaderProgram) {
+    // Moves the camera, the view matrix reaches the shaders through FrameUniforms
+    public: void CameraUpdate(GLFWwindow* window, float deltaTime) {
         processInput(window, deltaTime);
 		updateCameraVectors();
-        GLint uniView = glGetUniformLocation(shaderProgram, "view");
-
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
         float radius = 10.0f;
         float camX = sin(glfwGetTime() * radius);
         float camZ = cos(glfwGetTime() * radius);
@@ -0,0 +1,313 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include "MappedFile.h"
+#include "ModelCache.h"
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+extern "C" {
+#include <image_DXT.h>
+}
+
+using namespace std;
+
+// Block compressed copies of model textures under Cache/Textures.
+// The first load of an image builds its full mip chain with MipGenerator, compresses every level to BC1 (DXT1) or, when the image
+// really has alpha, BC3 (DXT5) with SOIL's encoder and writes the result as a DDS. manifest.txt next to the files
+// records the source hash and mip filter each DDS was built from, so later loads skip the image decode entirely and the DDS goes
+// straight to SOIL's direct upload. Load and Store are called from worker threads
+class DdsCache {
+public:
+    // Bump whenever the encoder or the mip filter changes, older entries are then rebuilt
+    static constexpr uint32_t Version = 2;
+
+    static DdsCache& Instance() {
+        static DdsCache cache;
+        return cache;
+    }
+
+    DdsCache(const DdsCache&) = delete;
+    DdsCache& operator=(const DdsCache&) = delete;
+
+    // Reads the cached DDS for name (a path or e.g. "model.glb#image0") if it was built from a source with this hash
+    // using this mip filter
+    bool Load(const string& name, uint64_t sourceHash, MipGenerator::Filter filter, vector<unsigned char>& dds) {
+        string file = FileName(name);
+        {
+            std::lock_guard<std::mutex> lock(manifestMutex);
+            loadManifest();
+            auto entry = manifest.find(file);
+            if (entry == manifest.end() || entry->second != EntryHash(sourceHash, filter))
+                return false;
+        }
+
+        MappedFile mapped;
+        if (!mapped.open(Directory + file))
+            return false;
+        dds.assign(mapped.data(), mapped.data() + mapped.size());
+        int width, height, levels;
+        bool alpha;
+        if (!Parse(dds, width, height, levels, alpha)) {
+            dds.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Encodes the pixels into dds and writes it to the cache. Returns false if the image can't be encoded,
+    // a failed write only costs the next load a re-encode
+    bool Store(const string& name, uint64_t sourceHash, MipGenerator::Filter filter, const unsigned char* pixels,
+        int width, int height, int channels, vector<unsigned char>& dds) {
+        auto encodeStart = std::chrono::high_resolution_clock::now();
+        if (!Encode(pixels, width, height, channels, dds, filter))
+            return false;
+        float encodeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - encodeStart).count();
+
+        int levels;
+        bool alpha;
+        Parse(dds, width, height, levels, alpha);
+        std::cout << "[DdsCache] Compressed " << name << " " << width << "x" << height << " to " << (alpha ? "BC3" : "BC1")
+            << ", " << levels << " levels in " << encodeMs << " ms, " << dds.size() / 1024 << " KB (RGBA8 with mips "
+            << RawBytes(width, height, levels) / 1024 << " KB)" << std::endl;
+
+        string file = FileName(name);
+        std::error_code ec;
+        std::filesystem::create_directories(Directory, ec);
+        string tempPath = Directory + file + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "[DdsCache] Cannot write: " << tempPath << std::endl;
+                return true;
+            }
+            out.write(reinterpret_cast<const char*>(dds.data()), dds.size());
+            if (!out.good()) {
+                std::cerr << "[DdsCache] Failed writing: " << tempPath << std::endl;
+                out.close();
+                std::filesystem::remove(tempPath, ec);
+                return true;
+            }
+        }
+        std::filesystem::rename(tempPath, Directory + file, ec);
+        if (ec) {
+            std::cerr << "[DdsCache] Cannot replace " << file << ": " << ec.message() << std::endl;
+            std::filesystem::remove(tempPath, ec);
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        loadManifest();
+        manifest[file] = EntryHash(sourceHash, filter);
+        saveManifest();
+        return true;
+    }
+
+    // Full mip chain of a 1-4 channel image as an in-memory DDS. BC1 unless the alpha channel holds anything but 255.
+    // parallel spreads the mip filtering and each level's block rows over the worker pool
+    static bool Encode(const unsigned char* pixels, int width, int height, int channels, vector<unsigned char>& dds,
+        MipGenerator::Filter filter = MipGenerator::Kaiser, bool parallel = true) {
+        dds.clear();
+        if (!pixels || width < 1 || height < 1 || channels < 1 || channels > 4)
+            return false;
+
+        bool alpha = (channels == 2 || channels == 4) && HasAlpha(pixels, (size_t)width * height, channels);
+        int levels = MipGenerator::LevelCount(width, height);
+
+        DDS_header header;
+        memset(&header, 0, sizeof(header));
+        header.dwMagic = FourCC('D', 'D', 'S', ' ');
+        header.dwSize = 124;
+        header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+        header.dwHeight = height;
+        header.dwWidth = width;
+        header.dwPitchOrLinearSize = (unsigned int)LevelBytes(width, height, alpha);
+        header.dwMipMapCount = levels;
+        header.sPixelFormat.dwSize = 32;
+        header.sPixelFormat.dwFlags = DDPF_FOURCC;
+        header.sPixelFormat.dwFourCC = alpha ? FourCC('D', 'X', 'T', '5') : FourCC('D', 'X', 'T', '1');
+        header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+        dds.reserve(sizeof(header) + ChainBytes(width, height, levels, alpha));
+        dds.insert(dds.end(), reinterpret_cast<const unsigned char*>(&header), reinterpret_cast<const unsigned char*>(&header) + sizeof(header));
+
+        // The chain ends at 1x1 like glGenerateMipmap. Only linear textures are compressed, so no sRGB filtering
+        vector<unsigned char> chain;
+        if (!MipGenerator::Build(pixels, width, height, channels, filter, false, chain, parallel)) {
+            dds.clear();
+            return false;
+        }
+        for (int l = 0; l < levels; l++) {
+            const unsigned char* level = l == 0 ? pixels : chain.data() + MipGenerator::LevelOffset(width, height, channels, l);
+            CompressLevel(level, std::max(1, width >> l), std::max(1, height >> l), channels, alpha, dds, parallel);
+        }
+        return true;
+    }
+
+    // Appends one level's BC1/BC3 blocks to out. Tasks of RowsPerTask block rows each write their own slice.
+    // simd false runs the scalar reference encoder, which writes the same bits
+    static void CompressLevel(const unsigned char* pixels, int width, int height, int channels, bool alpha,
+        vector<unsigned char>& out, bool parallel = true, bool simd = true) {
+        size_t offset = out.size();
+        out.resize(offset + LevelBytes(width, height, alpha));
+        unsigned char* blocks = out.data() + offset;
+
+        int blockRows = (height + 3) / 4;
+        size_t tasks = (size_t)(blockRows + RowsPerTask - 1) / RowsPerTask;
+        auto compressRows = [&](size_t task) {
+            int first = (int)task * RowsPerTask;
+            int rows = std::min(RowsPerTask, blockRows - first);
+            if (alpha)
+                convert_image_to_DXT5_rows(pixels, width, height, channels, first, rows, blocks, simd ? 1 : 0);
+            else
+                convert_image_to_DXT1_rows(pixels, width, height, channels, first, rows, blocks, simd ? 1 : 0);
+        };
+        if (parallel && tasks > 1) {
+            ThreadPool::Instance().ParallelFor(tasks, compressRows);
+        }
+        else {
+            for (size_t task = 0; task < tasks; task++)
+                compressRows(task);
+        }
+    }
+
+    // Checks a DDS is one of ours (BC1/BC3, complete mip chain) so SOIL never reads past its end
+    static bool Parse(const vector<unsigned char>& dds, int& width, int& height, int& levels, bool& alpha) {
+        if (dds.size() < sizeof(DDS_header))
+            return false;
+        DDS_header header;
+        memcpy(&header, dds.data(), sizeof(header));
+        if (header.dwMagic != FourCC('D', 'D', 'S', ' ') || header.dwSize != 124 || header.sPixelFormat.dwSize != 32
+            || !(header.sPixelFormat.dwFlags & DDPF_FOURCC) || header.dwWidth < 1 || header.dwHeight < 1)
+            return false;
+        if (header.sPixelFormat.dwFourCC == FourCC('D', 'X', 'T', '5'))
+            alpha = true;
+        else if (header.sPixelFormat.dwFourCC == FourCC('D', 'X', 'T', '1'))
+            alpha = false;
+        else
+            return false;
+
+        width = (int)header.dwWidth;
+        height = (int)header.dwHeight;
+        levels = std::max(1, (int)header.dwMipMapCount);
+        return levels <= MipGenerator::LevelCount(width, height) && dds.size() == sizeof(header) + ChainBytes(width, height, levels, alpha);
+    }
+
+    // 8 bytes per 4x4 block for BC1, 16 for BC3
+    static size_t LevelBytes(int width, int height, bool alpha) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+    }
+
+    static size_t ChainBytes(int width, int height, int levels, bool alpha) {
+        size_t bytes = 0;
+        for (int l = 0; l < levels; l++)
+            bytes += LevelBytes(std::max(1, width >> l), std::max(1, height >> l), alpha);
+        return bytes;
+    }
+
+    // What the same chain takes uncompressed, for the load report
+    static size_t RawBytes(int width, int height, int levels) {
+        size_t bytes = 0;
+        for (int l = 0; l < levels; l++)
+            bytes += (size_t)std::max(1, width >> l) * std::max(1, height >> l) * 4;
+        return bytes;
+    }
+
+private:
+    static constexpr const char* Directory = "Cache/Textures/";
+    // 32 pixel rows per task, a 2048 wide level is 4096 blocks of work
+    static constexpr int RowsPerTask = 8;
+
+    std::mutex manifestMutex;
+    unordered_map<string, uint64_t> manifest;  // DDS file name -> EntryHash
+    bool manifestLoaded = false;
+
+    DdsCache() {}
+
+    static constexpr unsigned int FourCC(char a, char b, char c, char d) {
+        return (unsigned int)(unsigned char)a | ((unsigned int)(unsigned char)b << 8)
+            | ((unsigned int)(unsigned char)c << 16) | ((unsigned int)(unsigned char)d << 24);
+    }
+
+    // Source hash seeded with the filter so switching filters rebuilds the entries
+    static uint64_t EntryHash(uint64_t sourceHash, MipGenerator::Filter filter) {
+        int key = (int)filter;
+        return ModelCache::HashBytes(&key, sizeof(key), sourceHash);
+    }
+
+    static bool HasAlpha(const unsigned char* pixels, size_t count, int channels) {
+        for (size_t i = 0; i < count; i++)
+            if (pixels[i * channels + channels - 1] != 255)
+                return true;
+        return false;
+    }
+
+    // Last path component made file name safe plus a hash of the whole name, like ModelCache::CachePath
+    static string FileName(const string& name) {
+        string file = name;
+        size_t pos = file.find_last_of("/\\");
+        if (pos != string::npos)
+            file = file.substr(pos + 1);
+        for (char& c : file)
+            if (strchr(" :*?\"<>|#", c))
+                c = '_';
+
+        char nameKey[17];
+        snprintf(nameKey, sizeof(nameKey), "%016llx", (unsigned long long)ModelCache::HashBytes(name.data(), name.size()));
+        return file + "." + nameKey + ".dds";
+    }
+
+    // manifest.txt holds "version file hash" per line, entries of another version are dropped. Caller holds the lock
+    void loadManifest() {
+        if (manifestLoaded)
+            return;
+        manifestLoaded = true;
+
+        std::ifstream in(string(Directory) + "manifest.txt");
+        string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            uint32_t version = 0;
+            string file, hash;
+            if (!(fields >> version >> file >> hash) || version != Version)
+                continue;
+            manifest[file] = std::strtoull(hash.c_str(), nullptr, 16);
+        }
+    }
+
+    // Rewritten whole through a temp file like the DDS entries. Caller holds the lock
+    void saveManifest() {
+        string path = string(Directory) + "manifest.txt";
+        string tempPath = path + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "[DdsCache] Cannot write: " << tempPath << std::endl;
+                return;
+            }
+            char hash[17];
+            for (const auto& entry : manifest) {
+                snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)entry.second);
+                out << Version << " " << entry.first << " " << hash << "\n";
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec) {
+            std::cerr << "[DdsCache] Cannot replace manifest: " << ec.message() << std::endl;
+            std::filesystem::remove(tempPath, ec);
+        }
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm.hpp>
+
+#include <cstring>
+#include "ShaderProgram.h"
+
+using namespace std;
+
+// std140 image of the FrameData block declared by the GLSLs in Assets/GLSLs. Only mat4 and vec4 members,
+// so the C++ layout matches std140 without padding
+struct FrameData {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProj = glm::mat4(1.0f);
+    glm::vec4 cameraPos = glm::vec4(0.0f);     // w unused
+    glm::vec4 lightPos = glm::vec4(0.0f);      // w unused
+    glm::vec4 lightColor = glm::vec4(1.0f);    // w unused
+    glm::vec4 ambientLight = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+};
+static_assert(sizeof(FrameData) == 256, "FrameData mirrors the std140 FrameData block");
+
+// Camera and light data every program reads from one uniform buffer, written once per frame no matter how many
+// programs or passes draw. Frames rotate through RingSize slots of one buffer, a slot is only rewritten after
+// the fence of the frame that last read it, so the write never waits on the GPU or orphans storage.
+// ShaderProgram points each program's FrameData block at ShaderProgram::FrameBlockBinding after linking
+class FrameUniforms {
+public:
+    static constexpr int RingSize = 3;
+
+    FrameUniforms() {}
+    ~FrameUniforms() { Delete(); }
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    // Once per frame before anything draws. Fences the previous frame's slot, writes the next one and binds it
+    void Update(const FrameData& data) {
+        if (!buffer)
+            create();
+        else
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        slot = (slot + 1) % RingSize;
+        if (fences[slot]) {
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+
+        GLintptr offset = (GLintptr)(slot * slotSize);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void* mapped = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(FrameData),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped) {
+            memcpy(mapped, &data, sizeof(FrameData));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        else {
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameData), &data);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, ShaderProgram::FrameBlockBinding, buffer, offset, sizeof(FrameData));
+    }
+
+    void Delete() {
+        if (buffer && glfwGetCurrentContext()) {
+            for (GLsync& fence : fences) {
+                if (fence)
+                    glDeleteSync(fence);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+        memset(fences, 0, sizeof(fences));
+        buffer = 0;
+        slot = 0;
+    }
+
+private:
+    GLuint buffer = 0;
+    size_t slotSize = 0;
+    int slot = 0;
+    GLsync fences[RingSize] = {};
+
+    // Slots start on the driver's uniform buffer offset alignment so each can be bound on its own
+    void create() {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment < 1)
+            alignment = 256;
+        slotSize = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, slotSize * RingSize, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        slot = RingSize - 1;
+    }
+};
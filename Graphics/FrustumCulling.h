@@ -0,0 +1,188 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLING_SSE 1
+#endif
+
+using namespace std;
+
+// Six planes with inward facing normals, a point p is inside a plane when dot(xyz, p) + w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb/Hartmann extraction from a column major projection * view (* model) matrix
+    static Frustum FromMatrix(const glm::mat4& m) {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;    // left
+        frustum.planes[1] = row3 - row0;    // right
+        frustum.planes[2] = row3 + row1;    // bottom
+        frustum.planes[3] = row3 - row1;    // top
+        frustum.planes[4] = row3 + row2;    // near
+        frustum.planes[5] = row3 - row2;    // far
+        for (glm::vec4& plane : frustum.planes) {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f)
+                plane /= length;
+        }
+        return frustum;
+    }
+};
+
+// World space boxes as center/half extent in structure of arrays form so 4 go through the kernel at once
+struct CullBoxes {
+    vector<float> centerX, centerY, centerZ;
+    vector<float> extentX, extentY, extentZ;
+
+    void Clear() {
+        centerX.clear(); centerY.clear(); centerZ.clear();
+        extentX.clear(); extentY.clear(); extentZ.clear();
+    }
+
+    size_t Count() const { return centerX.size(); }
+
+    void Add(const glm::vec3& center, const glm::vec3& extent) {
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+    }
+
+    // Object space AABB under a matrix, the result still contains every transformed corner (Arvo)
+    void Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix) {
+        glm::vec3 center = glm::vec3(matrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 half = (boundsMax - boundsMin) * 0.5f;
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; column++)
+            extent += glm::abs(glm::vec3(matrix[column])) * half[column];
+        Add(center, extent);
+    }
+};
+
+// World space spheres in structure of arrays form
+struct CullSpheres {
+    vector<float> centerX, centerY, centerZ, radius;
+
+    void Clear() {
+        centerX.clear(); centerY.clear(); centerZ.clear(); radius.clear();
+    }
+
+    size_t Count() const { return centerX.size(); }
+
+    void Add(const glm::vec3& center, float r) {
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        radius.push_back(r);
+    }
+};
+
+// Per draw culling counters
+struct CullStats {
+    size_t meshesTested = 0;
+    size_t meshesCulled = 0;
+    size_t instancesTested = 0;
+    size_t instancesCulled = 0;
+    // Rejected by OcclusionCuller after passing the frustum, and the time those tests took
+    size_t meshesOccluded = 0;
+    size_t instancesOccluded = 0;
+    float occlusionMs = 0.0f;
+};
+
+// Frustum tests over whole sets, 4 boxes or spheres per SSE iteration with a scalar tail.
+// visible[i] is 1 if item i touches the frustum, the return value is how many do
+class FrustumCuller {
+public:
+    static size_t TestBoxes(const Frustum& frustum, const CullBoxes& boxes, vector<uint8_t>& visible) {
+        size_t count = boxes.Count();
+        visible.resize(count);
+        size_t inside = 0;
+        size_t i = 0;
+#ifdef FRUSTUM_CULLING_SSE
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+            __m128 outside = zero;
+            for (const glm::vec4& plane : frustum.planes) {
+                // Signed distance of the center plus the box's projected radius onto the normal
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                    _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+                    _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+            }
+            inside += StoreMask(_mm_movemask_ps(outside), &visible[i]);
+        }
+#endif
+        for (; i < count; i++) {
+            bool in = true;
+            for (const glm::vec4& plane : frustum.planes) {
+                float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+                float reach = std::fabs(plane.x) * boxes.extentX[i] + std::fabs(plane.y) * boxes.extentY[i] + std::fabs(plane.z) * boxes.extentZ[i];
+                if (distance + reach < 0.0f) {
+                    in = false;
+                    break;
+                }
+            }
+            visible[i] = in ? 1 : 0;
+            inside += in ? 1 : 0;
+        }
+        return inside;
+    }
+
+    static size_t TestSpheres(const Frustum& frustum, const CullSpheres& spheres, vector<uint8_t>& visible) {
+        size_t count = spheres.Count();
+        visible.resize(count);
+        size_t inside = 0;
+        size_t i = 0;
+#ifdef FRUSTUM_CULLING_SSE
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 cx = _mm_loadu_ps(&spheres.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&spheres.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&spheres.centerZ[i]);
+            __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+            __m128 outside = zero;
+            for (const glm::vec4& plane : frustum.planes) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                    _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, r), zero));
+            }
+            inside += StoreMask(_mm_movemask_ps(outside), &visible[i]);
+        }
+#endif
+        for (; i < count; i++) {
+            bool in = true;
+            for (const glm::vec4& plane : frustum.planes) {
+                float distance = plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i] + plane.z * spheres.centerZ[i] + plane.w;
+                if (distance + spheres.radius[i] < 0.0f) {
+                    in = false;
+                    break;
+                }
+            }
+            visible[i] = in ? 1 : 0;
+            inside += in ? 1 : 0;
+        }
+        return inside;
+    }
+
+private:
+    // Expands a 4 lane outside mask into visible flags, returns the visible count
+    static size_t StoreMask(int outsideMask, uint8_t* visible) {
+        size_t inside = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            visible[lane] = (outsideMask >> lane) & 1 ? 0 : 1;
+            inside += visible[lane];
+        }
+        return inside;
+    }
+};
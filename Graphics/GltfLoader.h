@@ -0,0 +1,478 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Json.h"
+#include "TransformHierarchy.h"
+
+using namespace std;
+
+// A glTF bufferView as a range of mapped file memory
+struct GltfView {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    bool geometry = false;  // referenced by a vertex attribute or index accessor, needs a GL buffer
+};
+
+// Either an external file (uri) or encoded bytes inside a bufferView
+struct GltfImage {
+    string uri;
+    int bufferView = -1;
+    string mimeType;
+};
+
+// One triangle primitive, laid out exactly as the file stores it.
+// attributes[i].buffer holds a view index until the GL buffers exist
+struct GltfPrimitive {
+    vector<BufferAttribute> attributes;
+    int indexView = -1;                     // -1 means non-indexed
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexOffset = 0;                 // bytes into the index view
+    size_t indexCount = 0;
+    size_t vertexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    int baseColorImage = -1;
+    unsigned int node = 0;                  // index into GltfLoader::nodes
+};
+
+// glTF 2.0 reader for .glb and .gltf with external buffers.
+// Nothing is repacked: views point into the mapped file and primitives describe accessors as GL attribute
+// pointers, so Model can hand the bytes to glBufferData directly. Keep the loader alive while uploading.
+// Files using sparse accessors, data URIs or required extensions are rejected so the caller can fall back.
+class GltfLoader {
+public:
+    vector<GltfView> views;
+    vector<GltfImage> images;
+    vector<GltfPrimitive> primitives;
+    vector<NodeData> nodes;                 // nodes of the default scene, parents first
+
+    static bool IsGltfPath(const string& path) {
+        string extension;
+        size_t dot = path.find_last_of('.');
+        if (dot != string::npos)
+            extension = path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return extension == ".glb" || extension == ".gltf";
+    }
+
+    bool Load(const string& path) {
+        views.clear();
+        images.clear();
+        primitives.clear();
+        nodes.clear();
+        buffers.clear();
+        externalFiles.clear();
+
+        size_t slash = path.find_last_of("/\\");
+        directory = slash != string::npos ? path.substr(0, slash) : ".";
+
+        if (!file.open(path)) {
+            std::cerr << "[GltfLoader] Cannot open: " << path << std::endl;
+            return false;
+        }
+
+        const unsigned char* json = file.data();
+        size_t jsonSize = file.size();
+        binChunk = nullptr;
+        binChunkSize = 0;
+        if (file.size() >= 12 && ReadU32(file.data()) == GlbMagic) {
+            if (!ReadGlbChunks(json, jsonSize))
+                return false;
+        }
+
+        if (!JsonValue::Parse(reinterpret_cast<const char*>(json), jsonSize, document)) {
+            std::cerr << "[GltfLoader] Malformed JSON in: " << path << std::endl;
+            return false;
+        }
+
+        const string& version = document["asset"]["version"].asString();
+        if (version.empty() || version[0] != '2') {
+            std::cerr << "[GltfLoader] Unsupported glTF version '" << version << "' in: " << path << std::endl;
+            return false;
+        }
+        if (document["extensionsRequired"].size() > 0) {
+            std::cerr << "[GltfLoader] Required extension " << document["extensionsRequired"][0].asString() << " not supported" << std::endl;
+            return false;
+        }
+
+        if (!LoadBuffers() || !LoadViews())
+            return false;
+
+        LoadImages();
+
+        // Meshes in depth first node order of the default scene, like Model::collectMeshes
+        const JsonValue& scenes = document["scenes"];
+        if (scenes.size() > 0) {
+            const JsonValue& scene = scenes[(size_t)std::max(document["scene"].asInt(0), 0)];
+            for (size_t i = 0; i < scene["nodes"].size(); i++)
+                if (!CollectNode(scene["nodes"][i].asInt(), -1, 0))
+                    return false;
+        }
+        else {
+            nodes.push_back(NodeData());
+            nodes.back().name = "root";
+            for (size_t i = 0; i < document["meshes"].size(); i++)
+                if (!LoadMesh(document["meshes"][i], 0))
+                    return false;
+        }
+        if (nodes.empty())
+            nodes.push_back(NodeData());
+        return true;
+    }
+
+private:
+    static const uint32_t GlbMagic = 0x46546C67;        // "glTF"
+    static const uint32_t GlbChunkJson = 0x4E4F534A;    // "JSON"
+    static const uint32_t GlbChunkBin = 0x004E4942;     // "BIN\0"
+
+    struct Buffer {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+
+    MappedFile file;
+    vector<unique_ptr<MappedFile>> externalFiles;
+    vector<Buffer> buffers;
+    const unsigned char* binChunk = nullptr;
+    size_t binChunkSize = 0;
+    JsonValue document;
+    string directory;
+
+    static uint32_t ReadU32(const unsigned char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    bool ReadGlbChunks(const unsigned char*& json, size_t& jsonSize) {
+        uint32_t version = ReadU32(file.data() + 4);
+        size_t length = std::min<size_t>(ReadU32(file.data() + 8), file.size());
+        if (version != 2) {
+            std::cerr << "[GltfLoader] Unsupported GLB container version " << version << std::endl;
+            return false;
+        }
+
+        json = nullptr;
+        size_t offset = 12;
+        while (offset + 8 <= length) {
+            size_t chunkLength = ReadU32(file.data() + offset);
+            uint32_t chunkType = ReadU32(file.data() + offset + 4);
+            const unsigned char* chunk = file.data() + offset + 8;
+            if (chunkLength > length - offset - 8) {
+                std::cerr << "[GltfLoader] GLB chunk runs past the end of the file" << std::endl;
+                return false;
+            }
+            if (chunkType == GlbChunkJson && !json) {
+                json = chunk;
+                jsonSize = chunkLength;
+            }
+            else if (chunkType == GlbChunkBin && !binChunk) {
+                binChunk = chunk;
+                binChunkSize = chunkLength;
+            }
+            offset += 8 + ((chunkLength + 3) & ~(size_t)3);
+        }
+
+        if (!json) {
+            std::cerr << "[GltfLoader] GLB has no JSON chunk" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static string DecodeUri(const string& uri) {
+        string decoded;
+        for (size_t i = 0; i < uri.size(); i++) {
+            if (uri[i] == '%' && i + 2 < uri.size()) {
+                decoded += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+                i += 2;
+            }
+            else {
+                decoded += uri[i];
+            }
+        }
+        return decoded;
+    }
+
+    bool LoadBuffers() {
+        const JsonValue& list = document["buffers"];
+        for (size_t i = 0; i < list.size(); i++) {
+            const JsonValue& entry = list[i];
+            Buffer buffer;
+            size_t byteLength = entry["byteLength"].asSize();
+
+            if (!entry.has("uri")) {
+                // The GLB binary chunk, may carry up to 3 bytes of padding
+                if (i != 0 || !binChunk) {
+                    std::cerr << "[GltfLoader] Buffer " << i << " has no data" << std::endl;
+                    return false;
+                }
+                buffer.data = binChunk;
+                buffer.size = binChunkSize;
+            }
+            else {
+                const string& uri = entry["uri"].asString();
+                if (uri.compare(0, 5, "data:") == 0) {
+                    std::cerr << "[GltfLoader] Embedded data URI buffers are not supported" << std::endl;
+                    return false;
+                }
+                unique_ptr<MappedFile> external(new MappedFile());
+                if (!external->open(directory + "/" + DecodeUri(uri))) {
+                    std::cerr << "[GltfLoader] Cannot open buffer: " << uri << std::endl;
+                    return false;
+                }
+                buffer.data = external->data();
+                buffer.size = external->size();
+                externalFiles.push_back(std::move(external));
+            }
+
+            if (byteLength > buffer.size) {
+                std::cerr << "[GltfLoader] Buffer " << i << " is shorter than its byteLength" << std::endl;
+                return false;
+            }
+            buffer.size = byteLength;
+            buffers.push_back(buffer);
+        }
+        return true;
+    }
+
+    bool LoadViews() {
+        const JsonValue& list = document["bufferViews"];
+        for (size_t i = 0; i < list.size(); i++) {
+            const JsonValue& entry = list[i];
+            size_t buffer = entry["buffer"].asSize(buffers.size());
+            size_t offset = entry["byteOffset"].asSize();
+            size_t length = entry["byteLength"].asSize();
+            if (buffer >= buffers.size() || offset > buffers[buffer].size || length > buffers[buffer].size - offset) {
+                std::cerr << "[GltfLoader] bufferView " << i << " is out of range" << std::endl;
+                return false;
+            }
+            GltfView view;
+            view.data = buffers[buffer].data + offset;
+            view.size = length;
+            views.push_back(view);
+        }
+        return true;
+    }
+
+    void LoadImages() {
+        const JsonValue& list = document["images"];
+        for (size_t i = 0; i < list.size(); i++) {
+            GltfImage image;
+            if (list[i].has("uri") && list[i]["uri"].asString().compare(0, 5, "data:") != 0)
+                image.uri = DecodeUri(list[i]["uri"].asString());
+            image.bufferView = list[i]["bufferView"].asInt();
+            if (image.bufferView >= (int)views.size())
+                image.bufferView = -1;
+            image.mimeType = list[i]["mimeType"].asString();
+            images.push_back(image);
+        }
+    }
+
+    bool CollectNode(int index, int parent, int depth) {
+        const JsonValue& node = document["nodes"][index];
+        if (index < 0 || node.isNull() || depth > 64)
+            return true;
+
+        unsigned int flat = (unsigned int)nodes.size();
+        NodeData data;
+        data.name = node["name"].asString();
+        data.parent = parent;
+        data.local = LocalMatrix(node);
+        nodes.push_back(data);
+
+        if (node.has("mesh") && !LoadMesh(document["meshes"][node["mesh"].asInt()], flat))
+            return false;
+        for (size_t i = 0; i < node["children"].size(); i++)
+            if (!CollectNode(node["children"][i].asInt(), (int)flat, depth + 1))
+                return false;
+        return true;
+    }
+
+    // Either a column major matrix or translation * rotation * scale
+    static glm::mat4 LocalMatrix(const JsonValue& node) {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.size() == 16) {
+            glm::mat4 m;
+            for (int i = 0; i < 16; i++)
+                m[i / 4][i % 4] = (float)matrix[i].asNumber();
+            return m;
+        }
+
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        glm::mat4 local(1.0f);
+        if (t.size() == 3)
+            local = glm::translate(local, glm::vec3(t[0].asNumber(), t[1].asNumber(), t[2].asNumber()));
+        if (r.size() == 4)
+            local *= glm::mat4_cast(glm::quat((float)r[3].asNumber(), (float)r[0].asNumber(), (float)r[1].asNumber(), (float)r[2].asNumber()));
+        if (s.size() == 3)
+            local = glm::scale(local, glm::vec3(s[0].asNumber(), s[1].asNumber(), s[2].asNumber()));
+        return local;
+    }
+
+    static size_t ComponentCount(const string& type) {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    // glTF component types are the GL enums
+    static size_t ComponentBytes(int componentType) {
+        switch (componentType) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    // Validates an accessor and describes it as an attribute pointer into its view
+    bool ReadAccessor(int index, size_t expectedComponents, BufferAttribute& attribute, size_t& count) {
+        const JsonValue& accessor = document["accessors"][(size_t)std::max(index, 0)];
+        if (index < 0 || accessor.isNull()) {
+            std::cerr << "[GltfLoader] Missing accessor " << index << std::endl;
+            return false;
+        }
+        if (accessor.has("sparse") || !accessor.has("bufferView")) {
+            std::cerr << "[GltfLoader] Sparse or view-less accessors are not supported" << std::endl;
+            return false;
+        }
+
+        size_t view = accessor["bufferView"].asSize(views.size());
+        size_t components = ComponentCount(accessor["type"].asString());
+        int componentType = accessor["componentType"].asInt(0);
+        size_t componentBytes = ComponentBytes(componentType);
+        count = accessor["count"].asSize();
+        if (view >= views.size() || components != expectedComponents || componentBytes == 0) {
+            std::cerr << "[GltfLoader] Accessor " << index << " has an unexpected layout" << std::endl;
+            return false;
+        }
+
+        size_t elementBytes = components * componentBytes;
+        size_t stride = document["bufferViews"][view]["byteStride"].asSize();
+        size_t offset = accessor["byteOffset"].asSize();
+        size_t span = count == 0 ? 0 : (stride ? stride : elementBytes) * (count - 1) + elementBytes;
+        if (offset > views[view].size || span > views[view].size - offset) {
+            std::cerr << "[GltfLoader] Accessor " << index << " runs past its bufferView" << std::endl;
+            return false;
+        }
+
+        attribute.buffer = (GLuint)view;
+        attribute.size = (GLint)components;
+        attribute.type = (GLenum)componentType;
+        attribute.normalized = accessor["normalized"].asBool() ? GL_TRUE : GL_FALSE;
+        attribute.stride = (GLsizei)stride;
+        attribute.offset = offset;
+        views[view].geometry = true;
+        return true;
+    }
+
+    // Position bounds from the accessor min/max (required by the spec), scanned if a file leaves them out
+    void ReadBounds(int positionAccessor, GltfPrimitive& primitive) {
+        const JsonValue& accessor = document["accessors"][(size_t)positionAccessor];
+        const JsonValue& min = accessor["min"];
+        const JsonValue& max = accessor["max"];
+        if (min.size() == 3 && max.size() == 3) {
+            primitive.boundsMin = glm::vec3(min[0].asNumber(), min[1].asNumber(), min[2].asNumber());
+            primitive.boundsMax = glm::vec3(max[0].asNumber(), max[1].asNumber(), max[2].asNumber());
+            return;
+        }
+
+        const BufferAttribute& position = primitive.attributes[0];
+        if (position.type != GL_FLOAT)
+            return;
+        size_t stride = position.stride ? position.stride : 3 * sizeof(float);
+        const unsigned char* base = views[position.buffer].data + position.offset;
+        for (size_t i = 0; i < primitive.vertexCount; i++) {
+            glm::vec3 p;
+            memcpy(&p, base + i * stride, sizeof(p));
+            primitive.boundsMin = i == 0 ? p : glm::min(primitive.boundsMin, p);
+            primitive.boundsMax = i == 0 ? p : glm::max(primitive.boundsMax, p);
+        }
+    }
+
+    int BaseColorImage(const JsonValue& primitive) {
+        if (!primitive.has("material"))
+            return -1;
+        const JsonValue& material = document["materials"][primitive["material"].asSize()];
+        const JsonValue& textureInfo = material["pbrMetallicRoughness"]["baseColorTexture"];
+        if (!textureInfo.has("index"))
+            return -1;
+        int image = document["textures"][textureInfo["index"].asSize()]["source"].asInt();
+        return image < (int)images.size() ? image : -1;
+    }
+
+    bool LoadMesh(const JsonValue& mesh, unsigned int node) {
+        const JsonValue& list = mesh["primitives"];
+        for (size_t p = 0; p < list.size(); p++) {
+            const JsonValue& entry = list[p];
+            if (entry["mode"].asInt(4) != 4) {
+                std::cout << "[GltfLoader] Skipping non triangle primitive (mode " << entry["mode"].asInt() << ")" << std::endl;
+                continue;
+            }
+
+            const JsonValue& attributes = entry["attributes"];
+            if (!attributes.has("POSITION")) {
+                std::cout << "[GltfLoader] Skipping primitive without positions" << std::endl;
+                continue;
+            }
+
+            // Same locations as Mesh::SetupModelBuffers
+            GltfPrimitive primitive;
+            static const struct { const char* name; GLuint location; size_t components; } semantics[] = {
+                { "POSITION", 0, 3 }, { "NORMAL", 1, 3 }, { "TEXCOORD_0", 2, 2 } };
+            for (const auto& semantic : semantics) {
+                if (!attributes.has(semantic.name))
+                    continue;
+                BufferAttribute attribute;
+                attribute.location = semantic.location;
+                size_t count = 0;
+                if (!ReadAccessor(attributes[semantic.name].asInt(), semantic.components, attribute, count))
+                    return false;
+                if (semantic.location == 0)
+                    primitive.vertexCount = count;
+                else if (count < primitive.vertexCount) {
+                    std::cerr << "[GltfLoader] " << semantic.name << " has fewer elements than POSITION" << std::endl;
+                    return false;
+                }
+                primitive.attributes.push_back(attribute);
+            }
+
+            if (entry.has("indices")) {
+                BufferAttribute indices;
+                if (!ReadAccessor(entry["indices"].asInt(), 1, indices, primitive.indexCount))
+                    return false;
+                if (indices.type != GL_UNSIGNED_BYTE && indices.type != GL_UNSIGNED_SHORT && indices.type != GL_UNSIGNED_INT) {
+                    std::cerr << "[GltfLoader] Invalid index component type" << std::endl;
+                    return false;
+                }
+                primitive.indexView = (int)indices.buffer;
+                primitive.indexType = indices.type;
+                primitive.indexOffset = indices.offset;
+            }
+
+            ReadBounds(attributes["POSITION"].asInt(), primitive);
+            primitive.baseColorImage = BaseColorImage(entry);
+            primitive.node = node;
+            primitives.push_back(primitive);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,228 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// One copy of a model. The transform stays on the CPU (Model::DrawInstanced turns it into an ObjectBuffer object),
+// layer and pose go to the GPU as InstanceAttributes
+struct InstanceData {
+    glm::mat4 transform = glm::mat4(1.0f);
+    float layer = -1.0f;    // texture array layer, -1 keeps the mesh's own
+    float pose = 0.0f;      // Animator character whose joints skin this copy
+};
+
+// Per instance vertex data, read by ModelVertex.glsl at locations 8 (layer) and 11 (pose)
+struct InstanceAttributes {
+    float layer;
+    float pose;
+};
+static_assert(sizeof(InstanceAttributes) == 8, "InstanceAttributes is the instance attribute stride");
+
+// Copies of one Model drawn by Model::DrawInstanced.
+// Instances live densely packed so the GL buffer is one contiguous upload. Handles go through a slot
+// table, Remove swaps the last instance into the hole, so add/remove/move are all O(1).
+// Changes are streamed to the GPU on the next draw by orphaning the buffer, Version() tells
+// users with their own per instance data (the model's object matrices) when to rebuild it
+class InstanceBuffer {
+public:
+    typedef uint32_t Handle;
+    static constexpr Handle InvalidHandle = 0xFFFFFFFFu;
+
+    // Attribute locations
+    static constexpr GLuint LayerLocation = 8;
+    static constexpr GLuint PoseLocation = 11;
+
+    InstanceBuffer() {}
+    ~InstanceBuffer() { Delete(); }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    Handle Add(const glm::mat4& transform, int layer = -1, int pose = 0) {
+        Handle handle;
+        if (!freeSlots.empty()) {
+            handle = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            handle = (Handle)slots.size();
+            slots.push_back(InvalidHandle);
+        }
+        InstanceData data;
+        data.transform = transform;
+        data.layer = (float)layer;
+        data.pose = (float)pose;
+        slots[handle] = (uint32_t)instances.size();
+        instances.push_back(data);
+        owners.push_back(handle);
+        changed();
+        return handle;
+    }
+
+    // Handles are reused by later Adds, don't keep one after removing it
+    bool Remove(Handle handle) {
+        if (!Contains(handle))
+            return false;
+        uint32_t index = slots[handle];
+        uint32_t last = (uint32_t)instances.size() - 1;
+        if (index != last) {
+            instances[index] = instances[last];
+            owners[index] = owners[last];
+            slots[owners[index]] = index;
+        }
+        instances.pop_back();
+        owners.pop_back();
+        slots[handle] = InvalidHandle;
+        freeSlots.push_back(handle);
+        changed();
+        return true;
+    }
+
+    bool Move(Handle handle, const glm::mat4& transform) {
+        if (!Contains(handle))
+            return false;
+        // Transforms never reach the GL buffer, only users of Version() care
+        instances[slots[handle]].transform = transform;
+        version++;
+        return true;
+    }
+
+    bool SetLayer(Handle handle, int layer) {
+        if (!Contains(handle))
+            return false;
+        instances[slots[handle]].layer = (float)layer;
+        changed();
+        return true;
+    }
+
+    bool SetPose(Handle handle, int pose) {
+        if (!Contains(handle))
+            return false;
+        instances[slots[handle]].pose = (float)pose;
+        changed();
+        return true;
+    }
+
+    bool Contains(Handle handle) const {
+        return handle < slots.size() && slots[handle] != InvalidHandle;
+    }
+
+    const glm::mat4& Transform(Handle handle) const { return instances[slots[handle]].transform; }
+
+    void Clear() {
+        instances.clear();
+        owners.clear();
+        slots.clear();
+        freeSlots.clear();
+        changed();
+    }
+
+    size_t Count() const { return instances.size(); }
+
+    // Bumped by every change to the instances
+    uint64_t Version() const { return version; }
+
+    // Dense instance array in draw order
+    const vector<InstanceData>& Instances() const { return instances; }
+
+    // Handle of the instance at a dense index
+    Handle HandleAt(size_t index) const { return owners[index]; }
+
+    // Streams the instances if anything changed since the last upload. The store is orphaned first
+    // so the driver hands out fresh memory instead of waiting for last frame's draws
+    void Upload() {
+        if (!dirty && !streamedVisible)
+            return;
+        staged.clear();
+        for (const InstanceData& instance : instances)
+            staged.push_back({ instance.layer, instance.pose });
+        Stream();
+        dirty = false;
+        streamedVisible = false;
+    }
+
+    // Streams only the instances flagged in visible (one flag per instance, e.g. from frustum culling),
+    // packed to the front so they draw as instances 0..n-1. Skipped when neither the instances nor the flags changed
+    void UploadVisible(const vector<uint8_t>& visible) {
+        if (!dirty && streamedVisible && visible == uploadedVisible)
+            return;
+        staged.clear();
+        for (size_t i = 0; i < instances.size(); i++)
+            if (visible[i])
+                staged.push_back({ instances[i].layer, instances[i].pose });
+        Stream();
+        uploadedVisible = visible;
+        dirty = false;
+        streamedVisible = true;
+    }
+
+    // Points the instance attributes of the bound VAO at this buffer, one element per instance starting
+    // with the first streamed one
+    void Attach(size_t first = 0) const {
+        size_t offset = first * sizeof(InstanceAttributes);
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        glVertexAttribPointer(LayerLocation, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes),
+            (void*)(offset + offsetof(InstanceAttributes, layer)));
+        glVertexAttribDivisor(LayerLocation, 1);
+        glEnableVertexAttribArray(LayerLocation);
+        glVertexAttribPointer(PoseLocation, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes),
+            (void*)(offset + offsetof(InstanceAttributes, pose)));
+        glVertexAttribDivisor(PoseLocation, 1);
+        glEnableVertexAttribArray(PoseLocation);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Turns the instance attributes of the bound VAO off again so plain draws of the mesh are unaffected
+    static void Detach() {
+        glDisableVertexAttribArray(LayerLocation);
+        glDisableVertexAttribArray(PoseLocation);
+    }
+
+    void Delete() {
+        if (id && glfwGetCurrentContext())
+            glDeleteBuffers(1, &id);
+        id = 0;
+        capacity = 0;
+        dirty = true;
+    }
+
+private:
+    // Streams staged
+    void Stream() {
+        if (!id)
+            glGenBuffers(1, &id);
+        size_t bytes = staged.size() * sizeof(InstanceAttributes);
+        if (bytes > capacity)
+            capacity = bytes + bytes / 2;
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staged.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void changed() {
+        dirty = true;
+        version++;
+    }
+
+    GLuint id = 0;
+    size_t capacity = 0;
+    bool dirty = true;              // the GL buffer is behind the instances
+    bool streamedVisible = false;   // the GL buffer holds the visible subset of the last UploadVisible
+    uint64_t version = 0;
+
+    vector<InstanceData> instances;
+    vector<Handle> owners;      // dense index -> handle
+    vector<uint32_t> slots;     // handle -> dense index, InvalidHandle when free
+    vector<Handle> freeSlots;
+    vector<InstanceAttributes> staged;  // attributes of the last stream
+    vector<uint8_t> uploadedVisible;    // flags of the last UploadVisible
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include "Bvh.h"
+#include "Model.h"
+#include "InstanceBuffer.h"
+
+using namespace std;
+
+// Top level hierarchy over the instances of one Model for picking. Leaves hold instance handles,
+// a ray reaching a leaf is moved into instance space and tested against the model's mesh BVHs.
+// Build after instances are added or removed, Refit after they only moved
+class InstanceBvh {
+public:
+    void Build(const Model& model, const InstanceBuffer& instances) {
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        model.getBounds(modelMin, modelMax);
+
+        handles.resize(instances.Count());
+        for (size_t i = 0; i < instances.Count(); i++)
+            handles[i] = instances.HandleAt(i);
+        updateBoxes(instances);
+        Bvh::Build(boxMin, boxMax, nodes, order, 2);
+
+        std::cout << "[InstanceBvh] Built over " << handles.size() << " instances, " << nodes.size() << " nodes ("
+            << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count()
+            << " ms)" << std::endl;
+    }
+
+    // Moves the boxes of every instance to its current transform and refits bottom up, O(instances)
+    void Refit(const InstanceBuffer& instances) {
+        updateBoxes(instances);
+        Bvh::Refit(nodes, order, boxMin, boxMax);
+    }
+
+    // Closest instance triangle along a world space ray, hit.instance is the instance handle
+    bool Pick(const Ray& ray, const Model& model, const InstanceBuffer& instances, RayHit& hit) const {
+        bool found = false;
+        Bvh::Traverse(nodes, ray, hit.t, [&](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t primitive = order[i];
+                // Removed since the last Build
+                if (!instances.Contains(handles[primitive]))
+                    continue;
+                if (model.Raycast(ray.Transformed(inverses[primitive]), hit)) {
+                    hit.instance = handles[primitive];
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+    size_t Size() const { return handles.size(); }
+
+private:
+    vector<BvhNode> nodes;
+    vector<uint32_t> order;
+    vector<InstanceBuffer::Handle> handles;
+    vector<glm::mat4> inverses;         // world -> instance space
+    vector<glm::vec3> boxMin, boxMax;   // world space instance bounds
+    glm::vec3 modelMin = glm::vec3(0.0f), modelMax = glm::vec3(0.0f);
+
+    void updateBoxes(const InstanceBuffer& instances) {
+        inverses.resize(handles.size());
+        boxMin.resize(handles.size());
+        boxMax.resize(handles.size());
+        glm::vec3 center = (modelMin + modelMax) * 0.5f;
+        glm::vec3 half = (modelMax - modelMin) * 0.5f;
+        for (size_t i = 0; i < handles.size(); i++) {
+            // Removed instances keep their last box, Pick skips them
+            if (!instances.Contains(handles[i]))
+                continue;
+            const glm::mat4& transform = instances.Transform(handles[i]);
+            inverses[i] = glm::inverse(transform);
+            glm::vec3 c = glm::vec3(transform * glm::vec4(center, 1.0f));
+            glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * half.x + glm::abs(glm::vec3(transform[1])) * half.y + glm::abs(glm::vec3(transform[2])) * half.z;
+            boxMin[i] = c - extent;
+            boxMax[i] = c + extent;
+        }
+    }
+};
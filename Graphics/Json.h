@@ -0,0 +1,253 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// Minimal read-only JSON document, enough for glTF headers.
+// Missing keys and out of range indices return a shared null value so lookups can be chained.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    string text;
+    vector<JsonValue> items;
+    vector<pair<string, JsonValue>> members;
+
+    bool isNull() const { return type == Type::Null; }
+    bool isNumber() const { return type == Type::Number; }
+    bool isString() const { return type == Type::String; }
+    bool isArray() const { return type == Type::Array; }
+    bool isObject() const { return type == Type::Object; }
+
+    size_t size() const { return type == Type::Array ? items.size() : members.size(); }
+
+    const JsonValue& operator[](const char* key) const {
+        for (const auto& member : members)
+            if (member.first == key)
+                return member.second;
+        return Null();
+    }
+
+    const JsonValue& operator[](size_t index) const {
+        return index < items.size() ? items[index] : Null();
+    }
+
+    const JsonValue& operator[](int index) const {
+        return index >= 0 ? (*this)[(size_t)index] : Null();
+    }
+
+    bool has(const char* key) const { return !(*this)[key].isNull(); }
+
+    double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+    int asInt(int fallback = -1) const { return type == Type::Number ? (int)number : fallback; }
+    size_t asSize(size_t fallback = 0) const { return type == Type::Number && number >= 0.0 ? (size_t)number : fallback; }
+    bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+    const string& asString() const { return text; }
+
+    static const JsonValue& Null() {
+        static const JsonValue null;
+        return null;
+    }
+
+    // Parses text into out, returns false on malformed input
+    static bool Parse(const char* text, size_t length, JsonValue& out) {
+        const char* p = text;
+        const char* end = text + length;
+        if (!ParseValue(p, end, out, 0))
+            return false;
+        SkipWhitespace(p, end);
+        return p == end || *p == '\0';
+    }
+
+private:
+    static const int MaxDepth = 128;
+
+    static void SkipWhitespace(const char*& p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    static bool ParseValue(const char*& p, const char* end, JsonValue& out, int depth) {
+        if (depth > MaxDepth)
+            return false;
+        SkipWhitespace(p, end);
+        if (p >= end)
+            return false;
+
+        switch (*p) {
+        case '{': return ParseObject(p, end, out, depth);
+        case '[': return ParseArray(p, end, out, depth);
+        case '"': out.type = Type::String; return ParseString(p, end, out.text);
+        case 't': out.type = Type::Bool; out.boolean = true; return Literal(p, end, "true");
+        case 'f': out.type = Type::Bool; out.boolean = false; return Literal(p, end, "false");
+        case 'n': out.type = Type::Null; return Literal(p, end, "null");
+        default: return ParseNumber(p, end, out);
+        }
+    }
+
+    static bool Literal(const char*& p, const char* end, const char* word) {
+        size_t length = strlen(word);
+        if ((size_t)(end - p) < length || strncmp(p, word, length) != 0)
+            return false;
+        p += length;
+        return true;
+    }
+
+    static bool ParseNumber(const char*& p, const char* end, JsonValue& out) {
+        // strtod needs a terminated buffer, numbers are short so copy the token
+        char buffer[64];
+        size_t length = 0;
+        while (p + length < end && length < sizeof(buffer) - 1 && p[length] != '\0' && strchr("+-0123456789.eE", p[length]))
+            length++;
+        if (length == 0)
+            return false;
+        memcpy(buffer, p, length);
+        buffer[length] = '\0';
+
+        // Only '.' is valid in JSON numbers, so the C locale decimal point is assumed here
+        char* parsedEnd = nullptr;
+        out.type = Type::Number;
+        out.number = strtod(buffer, &parsedEnd);
+        if (parsedEnd != buffer + length)
+            return false;
+        p += length;
+        return true;
+    }
+
+    static void AppendUtf8(string& s, unsigned int codepoint) {
+        if (codepoint < 0x80) {
+            s += (char)codepoint;
+        }
+        else if (codepoint < 0x800) {
+            s += (char)(0xC0 | (codepoint >> 6));
+            s += (char)(0x80 | (codepoint & 0x3F));
+        }
+        else if (codepoint < 0x10000) {
+            s += (char)(0xE0 | (codepoint >> 12));
+            s += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+            s += (char)(0x80 | (codepoint & 0x3F));
+        }
+        else {
+            s += (char)(0xF0 | (codepoint >> 18));
+            s += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+            s += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+            s += (char)(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    static bool ParseHex4(const char*& p, const char* end, unsigned int& value) {
+        if (end - p < 4)
+            return false;
+        value = 0;
+        for (int i = 0; i < 4; i++, p++) {
+            char c = *p;
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= (unsigned int)(c - '0');
+            else if (c >= 'a' && c <= 'f') value |= (unsigned int)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') value |= (unsigned int)(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    static bool ParseString(const char*& p, const char* end, string& out) {
+        p++; // opening quote
+        out.clear();
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            if (++p >= end)
+                return false;
+            char escape = *p++;
+            switch (escape) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned int codepoint;
+                if (!ParseHex4(p, end, codepoint))
+                    return false;
+                // Surrogate pair
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    p += 2;
+                    unsigned int low;
+                    if (!ParseHex4(p, end, low))
+                        return false;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, codepoint);
+                break;
+            }
+            default: return false;
+            }
+        }
+        if (p >= end)
+            return false;
+        p++; // closing quote
+        return true;
+    }
+
+    static bool ParseArray(const char*& p, const char* end, JsonValue& out, int depth) {
+        out.type = Type::Array;
+        p++;
+        SkipWhitespace(p, end);
+        if (p < end && *p == ']') {
+            p++;
+            return true;
+        }
+        for (;;) {
+            out.items.emplace_back();
+            if (!ParseValue(p, end, out.items.back(), depth + 1))
+                return false;
+            SkipWhitespace(p, end);
+            if (p >= end)
+                return false;
+            if (*p == ',') { p++; continue; }
+            if (*p == ']') { p++; return true; }
+            return false;
+        }
+    }
+
+    static bool ParseObject(const char*& p, const char* end, JsonValue& out, int depth) {
+        out.type = Type::Object;
+        p++;
+        SkipWhitespace(p, end);
+        if (p < end && *p == '}') {
+            p++;
+            return true;
+        }
+        for (;;) {
+            SkipWhitespace(p, end);
+            if (p >= end || *p != '"')
+                return false;
+            out.members.emplace_back();
+            if (!ParseString(p, end, out.members.back().first))
+                return false;
+            SkipWhitespace(p, end);
+            if (p >= end || *p != ':')
+                return false;
+            p++;
+            if (!ParseValue(p, end, out.members.back().second, depth + 1))
+                return false;
+            SkipWhitespace(p, end);
+            if (p >= end)
+                return false;
+            if (*p == ',') { p++; continue; }
+            if (*p == '}') { p++; return true; }
+            return false;
+        }
+    }
+};
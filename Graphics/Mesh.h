@@ -2,7 +2,13 @@
 #define GLEW_STATIC
 
 #include<glm.hpp>
+#include<gtc/packing.hpp>
 #include<vector>
+#include<cstdint>
+#include<cstddef>
+#include<cmath>
+#include<cstdio>
+#include<utility>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "ShaderProgram.h"
@@ -23,6 +29,53 @@ struct Vertex {
     }
 };
 
+// GPU vertex layouts a Model mesh can be uploaded with
+enum class VertexFormat {
+    Standard,   // Vertex as is, 32 bytes
+    Compact     // CompactVertex, 16 bytes
+};
+
+// Quantized vertex, dequantized in ModelVertex.glsl
+struct CompactVertex {
+    uint16_t Position[4];   // xyz as 16 bit unorm relative to the mesh AABB, w is padding
+    uint32_t Normal;        // octahedral encoded normal in x/y of a 10-10-10-2 snorm
+    uint32_t TexCoords;     // two half floats
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay 16 bytes");
+
+// Second vertex stream of skinned meshes, read by ModelVertex.glsl at locations 9 (joints) and 10 (weights)
+struct SkinVertex {
+    uint16_t Joints[4] = { 0, 0, 0, 0 };    // Skeleton joint indices
+    uint8_t Weights[4] = { 0, 0, 0, 0 };    // unorm8, sum to 255
+};
+static_assert(sizeof(SkinVertex) == 12, "SkinVertex is the skin attribute stride");
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+inline glm::vec2 OctEncode(glm::vec3 n) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum <= 0.0f)
+        return glm::vec2(0.0f);
+    n /= sum;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e = glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+// Packs one Vertex, boundsExtent must not have zero components
+inline CompactVertex CompressVertex(const Vertex& v, const glm::vec3& boundsMin, const glm::vec3& boundsExtent) {
+    CompactVertex c;
+    glm::vec3 unit = glm::clamp((v.Position - boundsMin) / boundsExtent, 0.0f, 1.0f);
+    for (int k = 0; k < 3; k++)
+        c.Position[k] = (uint16_t)std::lround(unit[k] * 65535.0f);
+    c.Position[3] = 0;
+    c.Normal = glm::packSnorm3x10_1x2(glm::vec4(OctEncode(v.Normal), 0.0f, 0.0f));
+    c.TexCoords = glm::packHalf2x16(v.TexCoords);
+    return c;
+}
+
 // Texture structure
 struct Texture {
     unsigned int id;
@@ -30,6 +83,77 @@ struct Texture {
     string path;
 };
 
+// One level of detail, a range of the mesh index buffer. All levels share the vertex buffer
+struct MeshLod {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;     // object space simplification error
+};
+
+// CPU side result of importing one mesh, textures only carry type and path until the GL pass resolves their ids
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;   // every LOD back to back, LOD0 first
+    vector<Texture> textures;
+    vector<MeshLod> lods;           // empty means indices is a single level
+    vector<SkinVertex> skin;        // one per vertex for meshes bound to the model's skeleton, empty otherwise
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;      // bounding sphere around the AABB center
+    unsigned int node = 0;          // scene node whose world matrix places the mesh
+};
+
+// Owns one GL buffer or vertex array name. Move only, the destructor deletes the object while a context is current,
+// so meshes can live in vectors without leaking or double deleting. Reads as the plain GLuint name
+class GLObject {
+public:
+    enum Kind { Buffer, VertexArray };
+
+    explicit GLObject(Kind kind = Buffer) : kind(kind) {}
+    ~GLObject() { Reset(); }
+
+    GLObject(const GLObject&) = delete;
+    GLObject& operator=(const GLObject&) = delete;
+
+    GLObject(GLObject&& other) noexcept : kind(other.kind), id(other.id) { other.id = 0; }
+    GLObject& operator=(GLObject&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            kind = other.kind;
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    // Creates the object unless there already is one
+    GLuint Generate() {
+        if (!id) {
+            if (kind == VertexArray)
+                glGenVertexArrays(1, &id);
+            else
+                glGenBuffers(1, &id);
+        }
+        return id;
+    }
+
+    void Reset() {
+        if (id && glfwGetCurrentContext()) {
+            if (kind == VertexArray)
+                glDeleteVertexArrays(1, &id);
+            else
+                glDeleteBuffers(1, &id);
+        }
+        id = 0;
+    }
+
+    operator GLuint() const { return id; }
+
+private:
+    Kind kind;
+    GLuint id = 0;
+};
+
 struct VertexAttribute {
     GLsizei stride;
     GLint amountOf;
@@ -41,80 +165,123 @@ struct VertexAttribute {
     }
 };
 
+// One vertex attribute read from an existing GL buffer with an arbitrary layout (e.g. a glTF accessor)
+struct BufferAttribute {
+    GLuint buffer = 0;
+    GLuint location = 0;
+    GLint size = 0;                 // components
+    GLenum type = GL_FLOAT;
+    GLboolean normalized = GL_FALSE;
+    GLsizei stride = 0;             // 0 = tightly packed
+    size_t offset = 0;              // bytes
+};
+
+// Move only: the GL objects have exactly one owner and go away with it. Model meshes keep no CPU geometry,
+// their data is uploaded from the caller's memory (or one staging buffer for the compact format)
 class Mesh {
 public:
-    float* vertices;
-    int vertexCount;
-    int floatsPerVertex;
-    float* textures;
+    // Simple meshes only, arrays owned by the caller and read when the buffers are generated
+    float* vertices = nullptr;
+    int vertexCount = 0;
+    int floatsPerVertex = 0;
     int indexCount = 0;
 
-    GLuint VAO, VBO = 0;
-    unsigned int* indices;
+    GLObject VAO{ GLObject::VertexArray };
+    GLObject VBO;
+    unsigned int* indices = nullptr;
     vector<VertexAttribute> attributes;
     vector<Texture> meshTextures;
-    GLuint EBO = 0;
+    GLObject EBO;
 
-    // Constructor for Model loading (struct-based)
-    Mesh(vector<Vertex> Vertices, vector<unsigned int> Indices, vector<Texture> Textures) {
-        vertexCount = Vertices.size();
-        floatsPerVertex = 8;
+    // Object space bounds, only filled for Model meshes. The sphere is centered on the AABB
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
 
-        // Convert vector to array
-        vector<float> _vertices;
-        meshTextures = Textures;
-        for (Vertex vertex : Vertices) {
-            _vertices.push_back(vertex.Position.x);
-            _vertices.push_back(vertex.Position.y);
-            _vertices.push_back(vertex.Position.z);
-            _vertices.push_back(vertex.Normal.x);
-            _vertices.push_back(vertex.Normal.y);
-            _vertices.push_back(vertex.Normal.z);
-            _vertices.push_back(vertex.TexCoords.x);
-            _vertices.push_back(vertex.TexCoords.y);
-        }
+    // Layout of the model vertex buffer and its size in bytes
+    VertexFormat vertexFormat = VertexFormat::Standard;
+    size_t vertexBufferBytes = 0;
 
-        // Allocate memory and copy data
-        vertices = new float[_vertices.size()];
-        for (size_t i = 0; i < _vertices.size(); i++) {
-            vertices[i] = _vertices[i];
-        }
+    // Levels of detail inside the index buffer, currentLod is picked by Model::Draw
+    vector<MeshLod> lods;
+    int currentLod = 0;
 
-        // Copy indices
-        indices = new unsigned int[Indices.size()];
-        for (size_t i = 0; i < Indices.size(); i++) {
-            indices[i] = Indices[i];
-        }
-        indexCount = Indices.size();
+    // Model meshes: node of the model's TransformHierarchy the mesh is drawn with
+    unsigned int node = 0;
 
-        // Setup OpenGL buffers
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+    // Skinned meshes carry joints/weights in their own buffer next to the vertex data
+    GLObject skinVBO;
+    static constexpr GLuint JointLocation = 9;
+    static constexpr GLuint WeightLocation = 10;
 
-        glBindVertexArray(VAO);
+    // Index layout for DrawMesh, meshes on shared buffers start indexOffset bytes into their EBO
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexOffset = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertexCount * floatsPerVertex * sizeof(float),
-            vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int),
-            indices, GL_STATIC_DRAW);
-
-        // Position attribute (location = 0)
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        // Normal attribute (location = 1)
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+    // Constructor for vectors of Vertex (e.g. Sphere), uploads straight from them and keeps no CPU copy
+    Mesh(const vector<Vertex>& Vertices, const vector<unsigned int>& Indices, vector<Texture> Textures)
+        : Mesh(Vertices.data(), Vertices.size(), Indices.data(), Indices.size(), std::move(Textures), glm::vec3(0.0f), glm::vec3(0.0f)) {
+    }
 
-        // TexCoord attribute (location = 2)
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
+    // Constructor for Model loading straight from packed Vertex/index memory (e.g. a mapped model cache)
+    // Standard format copies nothing on the CPU, data only has to stay valid for the duration of the call
+    Mesh(const Vertex* Vertices, size_t VertexCount, const unsigned int* Indices, size_t IndexCount, vector<Texture> Textures,
+        glm::vec3 BoundsMin, glm::vec3 BoundsMax, VertexFormat Format = VertexFormat::Standard, vector<MeshLod> Lods = vector<MeshLod>()) {
+        vertexCount = (int)VertexCount;
+        floatsPerVertex = 8;
+        indexCount = (int)IndexCount;
+        meshTextures = std::move(Textures);
+        boundsMin = BoundsMin;
+        boundsMax = BoundsMax;
+        vertexFormat = Format;
+        lods = std::move(Lods);
+
+        if (vertexFormat == VertexFormat::Compact) {
+            glm::vec3 extent = QuantizationExtent();
+            vector<CompactVertex> compact(VertexCount);
+            for (size_t i = 0; i < VertexCount; i++)
+                compact[i] = CompressVertex(Vertices[i], boundsMin, extent);
+            SetupCompactBuffers(compact.data(), Indices);
+        }
+        else {
+            SetupModelBuffers(Vertices, Indices);
+        }
+    }
 
+    // Constructor for Model meshes reading buffers that are already uploaded and owned elsewhere (e.g. glTF buffer views)
+    // Only the VAO is created here, VBO/EBO stay 0 so the mesh never deletes the shared buffers
+    Mesh(const vector<BufferAttribute>& Attributes, GLuint IndexBuffer, GLenum IndexType, size_t IndexOffset, size_t IndexCount,
+        size_t VertexCount, vector<Texture> Textures, glm::vec3 BoundsMin, glm::vec3 BoundsMax) {
+        vertexCount = (int)VertexCount;
+        floatsPerVertex = 8;
+        indexCount = (int)IndexCount;
+        meshTextures = std::move(Textures);
+        boundsMin = BoundsMin;
+        boundsMax = BoundsMax;
+        indexType = IndexType;
+        indexOffset = IndexOffset;
+
+        VAO.Generate();
+        glBindVertexArray(VAO);
+        for (const BufferAttribute& attribute : Attributes) {
+            glBindBuffer(GL_ARRAY_BUFFER, attribute.buffer);
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+                attribute.stride, (void*)attribute.offset);
+            glEnableVertexAttribArray(attribute.location);
+            vertexBufferBytes += VertexCount * attribute.size * TypeBytes(attribute.type);
+        }
+        if (IndexBuffer)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static size_t TypeBytes(GLenum type) {
+        switch (type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return 2;
+        default: return 4;
+        }
     }
 
     // Constructor for simple meshes (array-based)
@@ -139,8 +306,8 @@ public:
 
     void GenerateMesh() {
         glBindVertexArray(0);
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
+        VAO.Generate();
+        VBO.Generate();
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -154,9 +321,9 @@ public:
     }
 
     void GenerateEbos(ShaderProgram& shader) {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO.Generate();
+        VBO.Generate();
+        EBO.Generate();
 
         glBindVertexArray(VAO);
 
@@ -178,9 +345,9 @@ public:
     }
 
     void GenerateEboQuads(ShaderProgram& shader) {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO.Generate();
+        VBO.Generate();
+        EBO.Generate();
 
         glBindVertexArray(VAO);
 
@@ -197,6 +364,97 @@ public:
         glBindVertexArray(0);
     }
 
+    // AABB size used to (de)quantize compact positions, flat axes get 1 to avoid dividing by zero
+    glm::vec3 QuantizationExtent() const {
+        glm::vec3 extent = boundsMax - boundsMin;
+        for (int k = 0; k < 3; k++)
+            if (extent[k] <= 0.0f) extent[k] = 1.0f;
+        return extent;
+    }
+
+    // Uploads CompactVertex data and indices, attribute locations match SetupModelBuffers
+    void SetupCompactBuffers(const CompactVertex* vertexData, const unsigned int* indexData) {
+        vertexBufferBytes = vertexCount * sizeof(CompactVertex);
+
+        VAO.Generate();
+        VBO.Generate();
+        EBO.Generate();
+
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, vertexData, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int),
+            indexData, GL_STATIC_DRAW);
+
+        // Position attribute (location = 0), unorm16 in the mesh AABB
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+        glEnableVertexAttribArray(0);
+
+        // Normal attribute (location = 1), octahedral in x/y
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+        glEnableVertexAttribArray(1);
+
+        // TexCoord attribute (location = 2), half floats
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+        glEnableVertexAttribArray(2);
+
+        glBindVertexArray(0);
+    }
+
+    // Uploads the skin stream and adds it to the VAO, works with either vertex format
+    void AttachSkin(const SkinVertex* skinData) {
+        skinVBO.Generate();
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(SkinVertex), skinData, GL_STATIC_DRAW);
+
+        // Joints are integers, weights normalized bytes
+        glVertexAttribIPointer(JointLocation, 4, GL_UNSIGNED_SHORT, sizeof(SkinVertex), (void*)offsetof(SkinVertex, Joints));
+        glEnableVertexAttribArray(JointLocation);
+        glVertexAttribPointer(WeightLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, Weights));
+        glEnableVertexAttribArray(WeightLocation);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vertexBufferBytes += vertexCount * sizeof(SkinVertex);
+    }
+
+    // Uploads interleaved Vertex data and indices, sets the model attribute layout
+    void SetupModelBuffers(const void* vertexData, const unsigned int* indexData) {
+        vertexBufferBytes = vertexCount * floatsPerVertex * sizeof(float);
+
+        VAO.Generate();
+        VBO.Generate();
+        EBO.Generate();
+
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * floatsPerVertex * sizeof(float),
+            vertexData, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int),
+            indexData, GL_STATIC_DRAW);
+
+        // Position attribute (location = 0)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        // Normal attribute (location = 1)
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+
+        // TexCoord attribute (location = 2)
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+
+        glBindVertexArray(0);
+    }
+
     // Draw method for models
     void DrawMesh(ShaderProgram& shader, Texture currTexture) {
         shader.use();
@@ -212,36 +470,88 @@ public:
         }
         glBindVertexArray(0);
     }
-    void DrawMesh(ShaderProgram& shader)
+    // Uniforms of ModelVertex.glsl and the post processing shader, hashed at compile time
+    static constexpr UniformName CompactVerticesUniform = "compactVertices";
+    static constexpr UniformName BoundsMinUniform = "boundsMin";
+    static constexpr UniformName BoundsExtentUniform = "boundsExtent";
+    static constexpr UniformName SelectorUniform = "selector";
+    static constexpr UniformName ScreenTextureUniform = "screenTexture";
+
+    // Binds textures to units in order and points texture_diffuseN / texture_specularN at them
+    static void BindTextures(ShaderProgram& shader, const vector<Texture>& textures)
     {
-        shader.use();
-
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
 
-        for (unsigned int i = 0; i < meshTextures.size(); i++)
+        for (unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i);
 
-            string number;
-            string name = meshTextures[i].type;
-
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++);
-
-            shader.setInt((name + number).c_str(), i);
-
-            glBindTexture(GL_TEXTURE_2D, meshTextures[i].id);
+            // The type and its number are hashed one after the other, no name string is built per draw
+            const string& type = textures[i].type;
+            unsigned int number = 0;
+            if (type == "texture_diffuse")
+                number = diffuseNr++;
+            else if (type == "texture_specular")
+                number = specularNr++;
+
+            uint32_t hash = UniformName::Hash(type.c_str());
+            if (number) {
+                char digits[12];
+                snprintf(digits, sizeof(digits), "%u", number);
+                hash = UniformName::Hash(digits, hash);
+            }
+            shader.setInt(UniformName(hash), i);
+
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
+    }
 
+    void DrawMesh(ShaderProgram& shader)
+    {
+        PrepareDraw(shader);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        Submit(currentLod);
         glBindVertexArray(0);
 
         glActiveTexture(GL_TEXTURE0);
     }
+    // Textures and dequantization inputs for ModelVertex.glsl
+    void PrepareDraw(ShaderProgram& shader)
+    {
+        shader.use();
+        BindTextures(shader, meshTextures);
+
+        bool compact = vertexFormat == VertexFormat::Compact;
+        shader.setBool(CompactVerticesUniform, compact);
+        if (compact) {
+            shader.setVec3(BoundsMinUniform, boundsMin);
+            shader.setVec3(BoundsExtentUniform, QuantizationExtent());
+        }
+    }
+    // Issues the draw for one LOD with the VAO already bound, instanceCount > 0 draws instanced
+    void Submit(int lod, GLsizei instanceCount = 0)
+    {
+        GLsizei count = indexCount;
+        size_t offset = indexOffset;
+        if (!lods.empty()) {
+            count = lods[lod].indexCount;
+            offset += lods[lod].firstIndex * TypeBytes(indexType);
+        }
+
+        if (count > 0) {
+            if (instanceCount > 0)
+                glDrawElementsInstanced(GL_TRIANGLES, count, indexType, (void*)offset, instanceCount);
+            else
+                glDrawElements(GL_TRIANGLES, count, indexType, (void*)offset);
+        }
+        else if (instanceCount > 0) {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+        }
+        else {
+            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        }
+    }
     // Draw method for simple meshes
     void DrawSimple(ShaderProgram& shader) {
         shader.use();
@@ -255,8 +565,8 @@ public:
         glDisable(GL_DEPTH_TEST);
 
         shader.use();
-        shader.setInt("selector", ppSelector);
-        shader.setInt("screenTexture", 0);
+        shader.setInt(SelectorUniform, ppSelector);
+        shader.setInt(ScreenTextureUniform, 0);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texColorBuffer);
@@ -279,19 +589,19 @@ public:
         glBindVertexArray(0);
     }
 
+    Mesh(Mesh&&) noexcept = default;
+    Mesh& operator=(Mesh&&) noexcept = default;
+
+    // Frees the GL objects early, the destructor does the same for meshes still holding any
     void Deletion() {
-        glDeleteBuffers(1, &VBO);
-        glDeleteVertexArrays(1, &VAO);
+        VBO.Reset();
+        VAO.Reset();
     }
 
     void EBODeletion() {
-        if (EBO) glDeleteBuffers(1, &EBO);
-        if (VBO) glDeleteBuffers(1, &VBO);
-        if (VAO) glDeleteVertexArrays(1, &VAO);
-    }
-
-    ~Mesh() {
-        // Note: Be careful with cleanup if using pointer assignment
-        // Only delete if we allocated memory in constructor
+        skinVBO.Reset();
+        EBO.Reset();
+        VBO.Reset();
+        VAO.Reset();
     }
 };
\ No newline at end of file
@@ -0,0 +1,277 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include "Mesh.h"
+
+using namespace std;
+
+// Post-transform vertex cache statistics of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+    float acmr = 0.0f;  // average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+    float atvr = 0.0f;  // average transform to vertex ratio, transformed vertices per unique vertex (1 is ideal)
+};
+
+// Which passes to run and their tuning
+struct MeshOptimizerSettings {
+    bool vertexCache = true;
+    bool overdraw = true;
+    bool vertexFetch = true;
+    unsigned int cacheSize = 16;
+    // How much ACMR the overdraw pass may give up to reorder clusters (1.05 = 5%)
+    float overdrawThreshold = 1.05f;
+};
+
+struct MeshOptimizationReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Index buffer reordering for triangle lists:
+// Tipsify vertex cache ordering (Sander, Nehab, Barczak 2007), overdraw aware cluster sorting
+// and vertex fetch reordering so vertex memory is read in the order the indices use it.
+class MeshOptimizer {
+public:
+    static VertexCacheStats AnalyzeVertexCache(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16) {
+        VertexCacheStats stats;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || vertexCount == 0)
+            return stats;
+
+        // A vertex is in the FIFO if it was pushed less than cacheSize misses ago
+        vector<size_t> pushedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (unsigned int index : indices) {
+            if (pushedAt[index] == 0 || misses - pushedAt[index] >= cacheSize) {
+                misses++;
+                pushedAt[index] = misses;
+            }
+        }
+
+        stats.acmr = (float)misses / triangleCount;
+        stats.atvr = (float)misses / vertexCount;
+        return stats;
+    }
+
+    // Runs the enabled passes in place, indices and vertices stay a valid triangle list
+    static MeshOptimizationReport Optimize(MeshData& data, const MeshOptimizerSettings& settings = MeshOptimizerSettings()) {
+        MeshOptimizationReport report;
+        report.before = AnalyzeVertexCache(data.indices, data.vertices.size(), settings.cacheSize);
+
+        if (data.indices.size() >= 3 && !data.vertices.empty()) {
+            vector<size_t> clusters;
+            if (settings.vertexCache)
+                data.indices = Tipsify(data.indices, data.vertices.size(), settings.cacheSize, clusters);
+            if (settings.vertexCache && settings.overdraw)
+                data.indices = OptimizeOverdraw(data.indices, data.vertices, clusters, settings.cacheSize, settings.overdrawThreshold);
+            if (settings.vertexFetch)
+                OptimizeVertexFetch(data.vertices, data.indices, data.skin.empty() ? nullptr : &data.skin);
+        }
+
+        report.after = AnalyzeVertexCache(data.indices, data.vertices.size(), settings.cacheSize);
+        return report;
+    }
+
+    // Tipsify, clusters receives the triangle index every hard cluster starts at
+    static vector<unsigned int> Tipsify(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize, vector<size_t>& clusters) {
+        size_t triangleCount = indices.size() / 3;
+        vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        clusters.clear();
+
+        // Vertex -> triangle adjacency in CSR form
+        vector<unsigned int> liveCount(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            liveCount[indices[i]]++;
+        vector<size_t> adjacencyStart(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] = adjacencyStart[v] + liveCount[v];
+        vector<unsigned int> adjacency(adjacencyStart[vertexCount]);
+        vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+        vector<size_t> cacheTime(vertexCount, 0);
+        vector<bool> emitted(triangleCount, false);
+        vector<unsigned int> deadEnd;
+        vector<unsigned int> candidates;
+        size_t timeStamp = cacheSize + 1;
+        size_t cursor = 0;
+
+        long long fanning = 0;
+        while (fanning < (long long)vertexCount && liveCount[fanning] == 0)
+            fanning++;
+        if (fanning == (long long)vertexCount)
+            return result;
+        clusters.push_back(0);
+
+        while (fanning >= 0) {
+            candidates.clear();
+            for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+                unsigned int t = adjacency[a];
+                if (emitted[t])
+                    continue;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[t * 3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveCount[v]--;
+                    if (timeStamp - cacheTime[v] > cacheSize)
+                        cacheTime[v] = timeStamp++;
+                }
+                emitted[t] = true;
+            }
+
+            // Next fanning vertex: the candidate still in cache that stays there longest
+            long long next = -1;
+            size_t bestPriority = 0;
+            for (unsigned int v : candidates) {
+                if (liveCount[v] == 0)
+                    continue;
+                size_t priority = 0;
+                if (timeStamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+                    priority = timeStamp - cacheTime[v];
+                if (next < 0 || priority > bestPriority) {
+                    bestPriority = priority;
+                    next = v;
+                }
+            }
+
+            if (next < 0) {
+                // Dead end, restart from recently used vertices, then from the input order
+                while (!deadEnd.empty() && next < 0) {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveCount[v] > 0)
+                        next = v;
+                }
+                while (next < 0 && cursor < vertexCount) {
+                    if (liveCount[cursor] > 0)
+                        next = (long long)cursor;
+                    cursor++;
+                }
+                if (next >= 0)
+                    clusters.push_back(result.size() / 3);
+            }
+            fanning = next;
+        }
+        return result;
+    }
+
+    // Splits the cache ordered triangles into clusters that cost at most threshold x the ACMR,
+    // then draws clusters facing outwards from the mesh center first so they occlude the rest
+    static vector<unsigned int> OptimizeOverdraw(const vector<unsigned int>& indices, const vector<Vertex>& vertices,
+        const vector<size_t>& hardClusters, unsigned int cacheSize, float threshold) {
+        size_t triangleCount = indices.size() / 3;
+        if (hardClusters.size() == 0 || triangleCount == 0)
+            return indices;
+
+        float targetAcmr = AnalyzeVertexCache(indices, vertices.size(), cacheSize).acmr * threshold;
+
+        // Soft cluster boundaries inside each hard cluster.
+        // Miss stamps are never reset, a cluster start just forgets everything pushed before it
+        vector<size_t> clusters;
+        vector<size_t> pushedAt(vertices.size(), 0);
+        size_t misses = 0;
+        for (size_t c = 0; c < hardClusters.size(); c++) {
+            size_t begin = hardClusters[c];
+            size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+            clusters.push_back(begin);
+
+            size_t start = begin;
+            size_t startMisses = misses;
+            for (size_t t = begin; t < end; t++) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[t * 3 + k];
+                    if (pushedAt[v] <= startMisses || misses - pushedAt[v] >= cacheSize) {
+                        misses++;
+                        pushedAt[v] = misses;
+                    }
+                }
+                size_t triangles = t + 1 - start;
+                if (t + 1 < end && triangles >= 8 && (float)(misses - startMisses) / triangles <= targetAcmr) {
+                    clusters.push_back(t + 1);
+                    start = t + 1;
+                    startMisses = misses;
+                }
+            }
+        }
+
+        // Area weighted mesh centroid
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        for (size_t t = 0; t < triangleCount; t++) {
+            glm::vec3 a = vertices[indices[t * 3]].Position;
+            glm::vec3 b = vertices[indices[t * 3 + 1]].Position;
+            glm::vec3 c = vertices[indices[t * 3 + 2]].Position;
+            float area = glm::length(glm::cross(b - a, c - a));
+            meshCenter += (a + b + c) * (area / 3.0f);
+            meshArea += area;
+        }
+        if (meshArea > 0.0f)
+            meshCenter /= meshArea;
+
+        // Sort key: how far the cluster faces away from the center
+        vector<float> sortKey(clusters.size());
+        for (size_t c = 0; c < clusters.size(); c++) {
+            size_t begin = clusters[c];
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            glm::vec3 center(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = begin; t < end; t++) {
+                glm::vec3 a = vertices[indices[t * 3]].Position;
+                glm::vec3 b = vertices[indices[t * 3 + 1]].Position;
+                glm::vec3 p = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, p - a);
+                float triangleArea = glm::length(n);
+                center += (a + b + p) * (triangleArea / 3.0f);
+                normal += n;
+                area += triangleArea;
+            }
+            if (area > 0.0f)
+                center /= area;
+            float normalLength = glm::length(normal);
+            sortKey[c] = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+        }
+
+        vector<size_t> order(clusters.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (size_t c : order) {
+            size_t begin = clusters[c];
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+        }
+        return result;
+    }
+
+    // Renumbers vertices in first use order and drops unreferenced ones, the skin stream follows if given
+    static void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices, vector<SkinVertex>* skin = nullptr) {
+        const unsigned int unused = ~0u;
+        vector<unsigned int> remap(vertices.size(), unused);
+        vector<Vertex> reordered;
+        vector<SkinVertex> reorderedSkin;
+        reordered.reserve(vertices.size());
+
+        for (unsigned int& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = (unsigned int)reordered.size();
+                reordered.push_back(vertices[index]);
+                if (skin)
+                    reorderedSkin.push_back((*skin)[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+        if (skin)
+            skin->swap(reorderedSkin);
+    }
+};
@@ -0,0 +1,329 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+using namespace std;
+
+// Quadric error metric simplification (Garland & Heckbert) that only collapses edges onto
+// existing vertices, so every level of detail indexes the same vertex buffer.
+// UV seams and open borders are locked, interior vertices collapse onto their cheapest neighbour.
+class MeshSimplifier {
+public:
+    static const int MaxLods = 4;
+
+    // Appends up to MaxLods - 1 coarser index lists after LOD0 and fills data.lods.
+    // Each level targets half the triangles of the previous one and is vertex cache optimized.
+    static void GenerateLods(MeshData& data, unsigned int cacheSize = 16) {
+        data.lods.clear();
+        if (data.indices.size() < 3)
+            return;
+
+        MeshLod base;
+        base.firstIndex = 0;
+        base.indexCount = (unsigned int)data.indices.size();
+        base.error = 0.0f;
+        data.lods.push_back(base);
+
+        // Collapses that move the surface more than this are never worth it
+        float maxError = glm::length(data.boundsMax - data.boundsMin) * 0.1f;
+
+        vector<unsigned int> all = data.indices;
+        vector<unsigned int> current = data.indices;
+        float error = 0.0f;
+        for (int level = 1; level < MaxLods; level++) {
+            size_t target = (current.size() / 2) / 3 * 3;
+            if (target < 3)
+                break;
+
+            float levelError = 0.0f;
+            vector<unsigned int> simplified = Simplify(data.vertices, current, target, maxError, levelError);
+            // Not enough left to simplify (locked seams/borders), further levels would be copies
+            if (simplified.empty() || simplified.size() > current.size() * 9 / 10)
+                break;
+
+            vector<size_t> clusters;
+            simplified = MeshOptimizer::Tipsify(simplified, data.vertices.size(), cacheSize, clusters);
+
+            error += levelError;
+            MeshLod lod;
+            lod.firstIndex = (unsigned int)all.size();
+            lod.indexCount = (unsigned int)simplified.size();
+            lod.error = error;
+            data.lods.push_back(lod);
+
+            all.insert(all.end(), simplified.begin(), simplified.end());
+            current.swap(simplified);
+        }
+        data.indices.swap(all);
+    }
+
+    // Returns a triangle list with at most targetIndexCount indices when reachable without
+    // exceeding maxError (object space distance), resultError receives the largest error applied
+    static vector<unsigned int> Simplify(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, float& resultError) {
+        resultError = 0.0f;
+        size_t vertexCount = vertices.size();
+        vector<unsigned int> result = indices;
+        if (indices.size() <= targetIndexCount)
+            return result;
+
+        // Weld vertices that only differ in normal/uv so topology is found across seams
+        vector<unsigned int> weld(vertexCount);
+        vector<unsigned int> wedgeCount(vertexCount, 0);
+        {
+            unordered_map<PositionKey, unsigned int, PositionKeyHash> firstByPosition;
+            firstByPosition.reserve(vertexCount);
+            for (size_t v = 0; v < vertexCount; v++) {
+                PositionKey key = MakeKey(vertices[v].Position);
+                auto inserted = firstByPosition.emplace(key, (unsigned int)v);
+                weld[v] = inserted.first->second;
+                wedgeCount[weld[v]]++;
+            }
+        }
+
+        // Border and non-manifold edges lock both of their vertices
+        vector<bool> locked(vertexCount, false);
+        {
+            unordered_map<uint64_t, unsigned int> edgeUse;
+            edgeUse.reserve(indices.size());
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = weld[indices[t + k]];
+                    unsigned int b = weld[indices[t + (k + 1) % 3]];
+                    if (a == b) continue;
+                    edgeUse[EdgeKey(a, b)]++;
+                }
+            }
+            for (const auto& edge : edgeUse) {
+                if (edge.second != 2) {
+                    locked[(unsigned int)(edge.first >> 32)] = true;
+                    locked[(unsigned int)(edge.first & 0xffffffffu)] = true;
+                }
+            }
+            for (size_t v = 0; v < vertexCount; v++)
+                if (wedgeCount[v] > 1)
+                    locked[v] = true;
+        }
+
+        // Plane quadrics per welded vertex
+        vector<Quadric> quadrics(vertexCount);
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            glm::dvec3 p0 = vertices[indices[t]].Position;
+            glm::dvec3 p1 = vertices[indices[t + 1]].Position;
+            glm::dvec3 p2 = vertices[indices[t + 2]].Position;
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double length = glm::length(n);
+            if (length <= 0.0)
+                continue;
+            n /= length;
+            Quadric q = Quadric::FromPlane(n, -glm::dot(n, p0));
+            for (int k = 0; k < 3; k++)
+                quadrics[weld[indices[t + k]]].Add(q);
+        }
+
+        double maxErrorSquared = (double)maxError * maxError;
+        double appliedError = 0.0;
+        vector<unsigned int> collapseTo(vertexCount);
+        vector<bool> touched(vertexCount);
+        vector<Collapse> candidates;
+        vector<size_t> adjacencyStart(vertexCount + 1);
+        vector<unsigned int> adjacency;
+
+        while (result.size() > targetIndexCount) {
+            size_t triangleCount = result.size() / 3;
+
+            // Directed edges whose start vertex may move onto the end vertex
+            candidates.clear();
+            for (size_t t = 0; t < triangleCount; t++) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int from = result[t * 3 + k];
+                    unsigned int to = result[t * 3 + (k + 1) % 3];
+                    unsigned int weldedFrom = weld[from];
+                    unsigned int weldedTo = weld[to];
+                    if (weldedFrom == weldedTo || locked[weldedFrom] || wedgeCount[weldedTo] > 1)
+                        continue;
+                    Collapse c;
+                    c.from = weldedFrom;
+                    c.to = to;
+                    c.cost = quadrics[weldedFrom].Evaluate(vertices[to].Position);
+                    candidates.push_back(c);
+                }
+            }
+            if (candidates.empty())
+                break;
+            std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+            // Welded vertex -> triangle adjacency of the current result
+            std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+            for (unsigned int index : result)
+                adjacencyStart[weld[index] + 1]++;
+            for (size_t v = 0; v < vertexCount; v++)
+                adjacencyStart[v + 1] += adjacencyStart[v];
+            adjacency.resize(result.size());
+            {
+                vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+                for (size_t i = 0; i < result.size(); i++)
+                    adjacency[fill[weld[result[i]]]++] = (unsigned int)(i / 3);
+            }
+
+            for (size_t v = 0; v < vertexCount; v++)
+                collapseTo[v] = (unsigned int)v;
+            std::fill(touched.begin(), touched.end(), false);
+
+            // Independent collapses, cheapest first: a collapse freezes the one-ring it changes
+            size_t remaining = result.size();
+            bool collapsed = false;
+            for (const Collapse& c : candidates) {
+                if (remaining <= targetIndexCount || c.cost > maxErrorSquared)
+                    break;
+                unsigned int weldedTo = weld[c.to];
+                if (touched[c.from] || touched[weldedTo])
+                    continue;
+                if (Flips(vertices, result, weld, adjacency, adjacencyStart, c.from, weldedTo, vertices[c.to].Position))
+                    continue;
+
+                // Triangles sharing the edge disappear
+                for (size_t a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1]; a++) {
+                    size_t t = adjacency[a];
+                    for (int k = 0; k < 3; k++)
+                        if (weld[result[t * 3 + k]] == weldedTo)
+                            remaining -= 3;
+                }
+                for (size_t a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1]; a++) {
+                    size_t t = adjacency[a];
+                    for (int k = 0; k < 3; k++)
+                        touched[weld[result[t * 3 + k]]] = true;
+                }
+
+                collapseTo[c.from] = c.to;
+                quadrics[weldedTo].Add(quadrics[c.from]);
+                appliedError = std::max(appliedError, c.cost);
+                collapsed = true;
+            }
+            if (!collapsed)
+                break;
+
+            // Apply collapses and drop triangles that became degenerate
+            size_t write = 0;
+            for (size_t t = 0; t < triangleCount; t++) {
+                unsigned int tri[3];
+                for (int k = 0; k < 3; k++) {
+                    unsigned int index = result[t * 3 + k];
+                    unsigned int welded = weld[index];
+                    tri[k] = collapseTo[welded] != welded ? collapseTo[welded] : index;
+                }
+                if (weld[tri[0]] == weld[tri[1]] || weld[tri[1]] == weld[tri[2]] || weld[tri[0]] == weld[tri[2]])
+                    continue;
+                result[write++] = tri[0];
+                result[write++] = tri[1];
+                result[write++] = tri[2];
+            }
+            result.resize(write);
+        }
+
+        resultError = (float)std::sqrt(appliedError);
+        return result;
+    }
+
+private:
+    struct Quadric {
+        // Symmetric 4x4 matrix, upper triangle
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+
+        static Quadric FromPlane(const glm::dvec3& n, double d) {
+            Quadric q;
+            q.a00 = n.x * n.x; q.a01 = n.x * n.y; q.a02 = n.x * n.z; q.a03 = n.x * d;
+            q.a11 = n.y * n.y; q.a12 = n.y * n.z; q.a13 = n.y * d;
+            q.a22 = n.z * n.z; q.a23 = n.z * d;
+            q.a33 = d * d;
+            return q;
+        }
+
+        void Add(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+        }
+
+        // Sum of squared distances from p to the accumulated planes
+        double Evaluate(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                + a22 * z * z + 2 * a23 * z
+                + a33;
+            return r > 0.0 ? r : 0.0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;  // welded vertex that moves
+        unsigned int to;    // vertex it ends up as
+        double cost;
+    };
+
+    struct PositionKey {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& other) const {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionKeyHash {
+        size_t operator()(const PositionKey& key) const {
+            uint64_t h = key.bits[0] * 73856093ull ^ key.bits[1] * 19349663ull ^ key.bits[2] * 83492791ull;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+
+    static PositionKey MakeKey(const glm::vec3& p) {
+        PositionKey key;
+        // -0 and +0 must weld together
+        glm::vec3 q = p + glm::vec3(0.0f);
+        memcpy(key.bits, &q[0], sizeof(key.bits));
+        return key;
+    }
+
+    static uint64_t EdgeKey(unsigned int a, unsigned int b) {
+        if (a > b) std::swap(a, b);
+        return ((uint64_t)a << 32) | b;
+    }
+
+    // True if moving welded vertex 'from' to position p turns any of its remaining triangles over
+    static bool Flips(const vector<Vertex>& vertices, const vector<unsigned int>& result, const vector<unsigned int>& weld,
+        const vector<unsigned int>& adjacency, const vector<size_t>& adjacencyStart,
+        unsigned int from, unsigned int weldedTo, const glm::vec3& p) {
+        for (size_t a = adjacencyStart[from]; a < adjacencyStart[from + 1]; a++) {
+            size_t t = adjacency[a];
+            glm::vec3 before[3];
+            glm::vec3 after[3];
+            bool sharesEdge = false;
+            for (int k = 0; k < 3; k++) {
+                unsigned int index = result[t * 3 + k];
+                before[k] = vertices[index].Position;
+                after[k] = weld[index] == from ? p : before[k];
+                if (weld[index] == weldedTo)
+                    sharesEdge = true;
+            }
+            if (sharesEdge)
+                continue;
+
+            glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+                return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "ThreadPool.h"
+#include <image_helper.h>
+
+using namespace std;
+
+// Full mip chains built on the CPU so the loaders never leave glGenerateMipmap to the GL thread.
+// Each level is filtered down from the one above by mipmap_image_rows (SSE2/AVX2 box or Kaiser filter, color in
+// linear light for sRGB textures), bands of RowsPerTask destination rows run on the worker pool
+class MipGenerator {
+public:
+    enum Filter {
+        Box = MIP_FILTER_BOX,
+        Kaiser = MIP_FILTER_KAISER
+    };
+
+    // Levels down to 1x1 including level 0, like glGenerateMipmap
+    static int LevelCount(int width, int height) {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size /= 2)
+            levels++;
+        return levels;
+    }
+
+    static int LevelSize(int size, int level) { return std::max(1, size >> level); }
+
+    static size_t LevelBytes(int width, int height, int channels, int level) {
+        return (size_t)LevelSize(width, level) * LevelSize(height, level) * channels;
+    }
+
+    // Where level (1 or more) starts in a chain from Build
+    static size_t LevelOffset(int width, int height, int channels, int level) {
+        size_t offset = 0;
+        for (int l = 1; l < level; l++)
+            offset += LevelBytes(width, height, channels, l);
+        return offset;
+    }
+
+    // Levels 1 to LevelCount - 1 back to back in chain, level 0 stays with the caller. srgb filters the color
+    // channels in linear light, alpha (the last of 2 or 4 channels) is always linear
+    static bool Build(const unsigned char* pixels, int width, int height, int channels, Filter filter, bool srgb,
+        vector<unsigned char>& chain, bool parallel = true) {
+        chain.clear();
+        if (!pixels || width < 1 || height < 1 || channels < 1 || channels > 4)
+            return false;
+
+        int levels = LevelCount(width, height);
+        chain.resize(LevelOffset(width, height, channels, levels));
+        const unsigned char* source = pixels;
+        for (int l = 1; l < levels; l++) {
+            unsigned char* level = chain.data() + LevelOffset(width, height, channels, l);
+            if (!BuildLevel(source, LevelSize(width, l - 1), LevelSize(height, l - 1), channels, filter, srgb, level, parallel)) {
+                chain.clear();
+                return false;
+            }
+            source = level;
+        }
+        return true;
+    }
+
+    // The level below a width x height image into level, which holds LevelBytes(width, height, channels, 1)
+    static bool BuildLevel(const unsigned char* pixels, int width, int height, int channels, Filter filter, bool srgb,
+        unsigned char* level, bool parallel = true) {
+        int rows = LevelSize(height, 1);
+        size_t tasks = (size_t)(rows + RowsPerTask - 1) / RowsPerTask;
+        std::atomic<bool> ok{ true };
+        auto filterRows = [&](size_t task) {
+            if (!mipmap_image_rows(pixels, width, height, channels, level, filter, srgb ? 1 : 0, (int)task * RowsPerTask, RowsPerTask))
+                ok = false;
+        };
+        if (parallel && tasks > 1) {
+            ThreadPool::Instance().ParallelFor(tasks, filterRows);
+        }
+        else {
+            for (size_t task = 0; task < tasks; task++)
+                filterRows(task);
+        }
+        return ok;
+    }
+
+private:
+    // 32 destination rows per task, the level below a 4096 square image is 64 tasks
+    static constexpr int RowsPerTask = 32;
+};
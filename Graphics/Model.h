@@ -1,63 +1,478 @@
 ﻿#pragma once
 #include "ShaderProgram.h"
 #include "Mesh.h"  // This includes Vertex and Texture structs
+#include "ModelCache.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+#include "TextureArray.h"
+#include "TransformHierarchy.h"
+#include "InstanceBuffer.h"
+#include "FrustumCulling.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "Animation.h"
+#include "SkinPalette.h"
+#include "ObjectBuffer.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include <stb_image.h>
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cstring>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <cstddef>
 
 using namespace std;
 
+// CPU side data a Model keeps once its meshes are on the GPU, combine with |. Anything not asked for is released after upload
+enum ModelKeep : unsigned int {
+    KeepNothing = 0,
+    KeepPicking = 1 << 0,       // per mesh triangle BVHs for Raycast/Pick
+    KeepOccluders = 1 << 1,     // coarsest LOD triangles for GetOccluderTriangles
+    KeepGeometry = 1 << 2       // processed MeshData for export, see getGeometry
+};
+
 class Model {
 public:
-    // Constructor - takes only path
-    Model(const std::string& path) {
+    // Constructor - takes the path, the vertex layout to upload with and the ModelKeep flags
+    Model(const std::string& path, VertexFormat format = VertexFormat::Standard, unsigned int keep = KeepNothing)
+        : vertexFormat(format), keep(keep) {
         loadModel(path);
     }
 
-    Model(const char* path) {
+    Model(const char* path, VertexFormat format = VertexFormat::Standard, unsigned int keep = KeepNothing)
+        : vertexFormat(format), keep(keep) {
         loadModel(std::string(path));
     }
 
-    // Draw all meshes
-    void Draw(ShaderProgram& shader) {
+    // Textures are shared through TextureCache, give back our references
+    ~Model() {
+        for (const auto& loaded : textures_loaded)
+            TextureCache::Instance().Release(loaded.second);
+        if (!sharedBuffers.empty() && glfwGetCurrentContext())
+            glDeleteBuffers((GLsizei)sharedBuffers.size(), sharedBuffers.data());
+        deleteMergedBuffers();
+    }
+
+    // Owns texture references, copying would release them twice
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Draw all meshes, each at its node's world matrix under the camera's viewProj (projection * view)
+    void Draw(ShaderProgram& shader, const glm::mat4& viewProj) {
+        if (meshes.empty()) {
+            cout << "[Model] Warning: no meshes to draw\n";
+            return;
+        }
+        viewProjection = viewProj;
+        prepareNodeMatrices(glm::mat4(1.0f));
+        cullStats = CullStats();
+        meshVisible.assign(meshes.size(), 1);
+        drawMeshes(shader);
+    }
+
+    // Draw all meshes inside the view frustum, each one at the coarsest LOD whose simplification error projects
+    // to less than maxPixelError pixels. Levels only change once the error leaves a hysteresis band
+    void Draw(ShaderProgram& shader, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+        float viewportHeight, float maxPixelError = 1.0f) {
         if (meshes.empty()) {
             cout << "[Model] Warning: no meshes to draw\n";
             return;
         }
+        viewProjection = projection * view;
+
+        const float hysteresis = 0.25f;
+        float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+        prepareNodeMatrices(model);
+        cullMeshes(Frustum::FromMatrix(projection * view));
+
         for (unsigned int i = 0; i < meshes.size(); i++) {
-            meshes[i].DrawMesh(shader);
+            Mesh& mesh = meshes[i];
+            if (mesh.lods.size() > 1 && meshVisible[i]) {
+                const glm::mat4& meshModel = nodeMatrices[mesh.node];
+                glm::mat4 modelView = view * meshModel;
+                float scale = maxScale(meshModel);
+                glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+                float radius = mesh.boundsRadius * scale;
+                float distance = glm::max(glm::length(glm::vec3(modelView * glm::vec4(center, 1.0f))) - radius, 0.001f);
+                float errorToPixels = scale * pixelsPerUnit / distance;
+
+                int lod = mesh.currentLod;
+                if (mesh.lods[lod].error * errorToPixels > maxPixelError * (1.0f + hysteresis)) {
+                    while (lod > 0 && mesh.lods[lod].error * errorToPixels > maxPixelError)
+                        lod--;
+                }
+                else {
+                    while (lod + 1 < (int)mesh.lods.size() && mesh.lods[lod + 1].error * errorToPixels <= maxPixelError * (1.0f - hysteresis))
+                        lod++;
+                }
+                mesh.currentLod = lod;
+            }
         }
+        drawMeshes(shader);
+    }
+
+    // Draws every copy in instances with one glDrawElementsInstanced per mesh under the camera's viewProj, each
+    // instance transform is applied on top of the node matrices. lod picks the level for all copies (clamped per mesh), merged draw
+    // doesn't apply. With a frustum only instances whose model bounding sphere touches it are streamed and drawn,
+    // an occlusion culler also drops instances hidden behind its occluders. Otherwise changed instances are streamed as they are
+    void DrawInstanced(ShaderProgram& shader, const glm::mat4& viewProj, InstanceBuffer& instances, int lod = 0,
+        const Frustum* frustum = nullptr) {
+        drawCalls = 0;
+        if (meshes.empty()) {
+            cout << "[Model] Warning: no meshes to draw\n";
+            return;
+        }
+        viewProjection = viewProj;
+        cullStats = CullStats();
+        if (instances.Count() == 0)
+            return;
+
+        prepareNodeMatrices(glm::mat4(1.0f));
+        size_t drawCount = instances.Count();
+        bool filtered = false;
+        // Posed characters reach outside the bind pose bounds, they are never culled
+        bool posed = skinPalette && IsSkinned();
+        if (frustum && frustumCulling && !posed) {
+            drawCount = cullInstances(*frustum, instances);
+            filtered = true;
+        }
+        if (occlusionCuller && !posed) {
+            if (!filtered)
+                instanceVisible.assign(instances.Count(), 1);
+            drawCount -= occludeInstances(instances);
+            filtered = true;
+        }
+        if (filtered)
+            instances.UploadVisible(instanceVisible);
+        else
+            instances.Upload();
+        if (drawCount == 0)
+            return;
+
+        // One object per streamed copy, in the order the instances went up. Every mesh shares them with its
+        // node matrix applied on top in the shader, so nothing is rebuilt while the copies and the camera stay put
+        if (!instanceObjectsCurrent(instances, filtered)) {
+            instanceTransforms.clear();
+            const vector<InstanceData>& instanceData = instances.Instances();
+            for (size_t i = 0; i < instanceData.size(); i++)
+                if (!filtered || instanceVisible[i])
+                    instanceTransforms.push_back(instanceData[i].transform);
+            instanceObjects.Clear();
+            instanceObjects.AddBatch(viewProjection, instanceTransforms.data(), instanceTransforms.size());
+
+            instanceObjectsSource = &instances;
+            instanceObjectsVersion = instances.Version();
+            instanceObjectsViewProjection = viewProjection;
+            instanceObjectsFiltered = filtered;
+            if (filtered)
+                instanceObjectsVisible = instanceVisible;
+            instanceObjectsUploaded = false;
+        }
+
+        shader.use();
+        shader.setInt(ObjectDataUniform, ObjectUnit);
+        shader.setInt(ObjectBaseUniform, 0);
+        shader.setInt(TextureArrayUniform, TextureArrayUnit);
+        if (textureArray)
+            textureArray->Bind(TextureArrayUnit);
+        shader.setBool(InstancedUniform, true);
+        bindPalette(shader);
+
+        // More copies than one texture buffer view can address go up and draw a range at a time,
+        // the GL buffer then only ever holds the last range
+        size_t chunkSize = ObjectBuffer::MaxObjects();
+        size_t chunks = (drawCount + chunkSize - 1) / chunkSize;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            size_t first = chunk * chunkSize;
+            size_t count = std::min(chunkSize, drawCount - first);
+            if (!instanceObjectsUploaded || chunks > 1)
+                instanceObjects.Upload(first, count);
+            instanceObjectsUploaded = chunks == 1;
+            instanceObjects.Bind(ObjectUnit);
+
+            for (unsigned int i = 0; i < meshes.size(); i++) {
+                Mesh& mesh = meshes[i];
+                applyLayer(shader, i);
+                shader.setBool(SkinnedUniform, skinning(i));
+                const glm::mat4& node = meshWorld(i);
+                shader.setMat4(NodeMatrixUniform, node);
+                shader.setMat3(NodeNormalMatrixUniform, glm::transpose(glm::inverse(glm::mat3(node))));
+                mesh.PrepareDraw(shader);
+
+                glBindVertexArray(mesh.VAO);
+                instances.Attach(first);
+                mesh.Submit(mesh.lods.empty() ? 0 : std::min(std::max(lod, 0), (int)mesh.lods.size() - 1), (GLsizei)count);
+                InstanceBuffer::Detach();
+                glBindVertexArray(0);
+                drawCalls++;
+            }
+        }
+
+        shader.setBool(InstancedUniform, false);
+        shader.setBool(SkinnedUniform, false);
+        shader.setBool(UseTextureArrayUniform, false);
+        glActiveTexture(GL_TEXTURE0);
     }
 
+    // Needs KeepPicking, without it nothing is ever hit.
+    // Closest hit of a model space ray (before any model matrix) against every mesh at its node's world matrix
+    // as of the last Draw, skinned meshes in their bind pose. hit.t limits the search, so several models can be tested with the same hit
+    bool Raycast(const Ray& ray, RayHit& hit) const {
+        bool found = false;
+        for (size_t i = 0; i < meshBvhs.size(); i++) {
+            if (meshBvhs[i].Empty())
+                continue;
+            Ray local = ray.Transformed(glm::inverse(hierarchy.World((int)meshes[i].node)));
+            if (meshBvhs[i].Intersect(local, hit)) {
+                hit.mesh = (uint32_t)i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // World space ray against the model drawn with this model matrix
+    bool Pick(const Ray& ray, const glm::mat4& model, RayHit& hit) const {
+        return Raycast(ray.Transformed(glm::inverse(model)), hit);
+    }
+
+    // Model space AABB of every mesh at its node's world matrix
+    void getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+        boundsMin = glm::vec3(FLT_MAX);
+        boundsMax = glm::vec3(-FLT_MAX);
+        for (const Mesh& mesh : meshes) {
+            const glm::mat4& world = hierarchy.World((int)mesh.node);
+            glm::vec3 center = glm::vec3(world * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            glm::vec3 half = (mesh.boundsMax - mesh.boundsMin) * 0.5f;
+            glm::vec3 extent = glm::abs(glm::vec3(world[0])) * half.x + glm::abs(glm::vec3(world[1])) * half.y + glm::abs(glm::vec3(world[2])) * half.z;
+            boundsMin = glm::min(boundsMin, center - extent);
+            boundsMax = glm::max(boundsMax, center + extent);
+        }
+    }
+
+    // Scene nodes, change local matrices here to move parts of the model, world matrices follow on the next Draw
+    TransformHierarchy& getHierarchy() { return hierarchy; }
+
+    const TransformHierarchy& getHierarchy() const { return hierarchy; }
+
+    // Skeleton and resampled clips of a rigged model, play them with an Animator over getHierarchy()
+    bool IsSkinned() const { return !skeleton.Empty(); }
+
+    const Skeleton& getSkeleton() const { return skeleton; }
+
+    const vector<AnimationClip>& getClips() const { return clips; }
+
+    // Joint matrices for skinned meshes, pose picks the Animator character for Draw (DrawInstanced reads it per instance).
+    // nullptr draws the bind pose with the node matrices
+    void SetSkinPalette(const SkinPalette* palette, int pose = 0) {
+        skinPalette = palette;
+        skinPose = pose;
+    }
+
+    // Consolidation mode: every Standard layout mesh is packed into one VBO/EBO with base vertex and
+    // first index offsets, and meshes sharing a material go out as one glMultiDrawElementsBaseVertex.
+    // Compact meshes (per mesh dequantization uniforms), skinned meshes and glTF meshes (file layouts) keep drawing on their own
+    void SetMergedDraw(bool enabled) {
+        if (enabled && !mergedVAO)
+            buildMergedBuffers();
+        mergedDraw = enabled && mergedVAO != 0;
+    }
+
+    bool IsMergedDraw() const { return mergedDraw; }
+
+    // Skins: meshes whose diffuse map is a layer of array sample the array instead.
+    // layer picks the skin for the whole model, -1 keeps every mesh on its own image. nullptr turns it off
+    void SetTextureArray(const TextureArray* array, int layer = -1) {
+        textureArray = array;
+        meshLayers.assign(meshes.size(), -1);
+        if (array) {
+            for (size_t i = 0; i < meshes.size(); i++)
+                for (const Texture& texture : meshes[i].meshTextures)
+                    if (texture.type == "texture_diffuse" && meshLayers[i] < 0)
+                        meshLayers[i] = array->LayerOf(texture.path);
+        }
+        SetLayer(layer);
+    }
+
+    // Switching skins only changes the layer attribute, no texture rebinding
+    void SetLayer(int layer) {
+        this->layer = textureArray && layer < textureArray->LayerCount() ? layer : -1;
+    }
+
+    int GetLayer() const { return layer; }
+
+    // Frustum culling in the LOD Draw and in DrawInstanced, culled meshes/instances are never submitted
+    void SetFrustumCulling(bool enabled) { frustumCulling = enabled; }
+
+    bool IsFrustumCulling() const { return frustumCulling; }
+
+    // Boxes that survive the frustum are tested against the culler's last Render, nullptr turns it off.
+    // The culler has to be rendered with this frame's view/projection before Draw
+    void SetOcclusionCuller(const OcclusionCuller* culler) { occlusionCuller = culler; }
+
+    const OcclusionCuller* GetOcclusionCuller() const { return occlusionCuller; }
+
+    // Coarsest LOD of every mesh at its node's world matrix, as a model space triangle list for OcclusionCuller. Needs KeepOccluders
+    void GetOccluderTriangles(vector<glm::vec3>& corners) const {
+        for (size_t i = 0; i < occluderCorners.size(); i++) {
+            const glm::mat4& world = hierarchy.World((int)meshes[i].node);
+            for (const glm::vec3& corner : occluderCorners[i])
+                corners.push_back(glm::vec3(world * glm::vec4(corner, 1.0f)));
+        }
+    }
+
+    // What the last Draw or DrawInstanced tested and culled
+    const CullStats& getCullStats() const { return cullStats; }
+
+    // Draw calls issued by the last Draw or DrawInstanced
+    size_t getDrawCallCount() const { return drawCalls; }
+
+    size_t getMaterialBatchCount() const { return batches.size(); }
+
+    // Processed meshes as imported (LODs, optimized order, skin) when loaded with KeepGeometry, empty otherwise
+    const vector<MeshData>& getGeometry() const { return geometry; }
+
     // Get mesh count for debugging
     size_t getMeshCount() const { return meshes.size(); }
 
+    // Reads a file through Assimp and converts it to MeshData and the flattened node tree, CPU only (no GL, no optimization).
+    // Bones become the skeleton and the meshes' skin streams, animations are resampled into clips
+    static bool ImportAssimp(const string& path, vector<MeshData>& meshData, vector<NodeData>& nodes,
+        Skeleton* skeleton = nullptr, vector<AnimationClip>* clips = nullptr) {
+        Assimp::Importer import;
+        const aiScene* scene = import.ReadFile(path, ImportFlags);
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            cout << "ERROR::ASSIMP::" << import.GetErrorString() << " -- path: " << path << endl;
+            return false;
+        }
+
+        Skeleton joints;
+        processNode(scene->mRootNode, scene, meshData, nodes, joints);
+        if (skeleton)
+            *skeleton = joints;
+        if (clips)
+            importClips(scene, nodes, *clips);
+        return true;
+    }
+
 private:
     // Model data
     vector<Mesh> meshes;
-    vector<Texture> textures_loaded;
+    // Full texture path -> GL id, each entry holds one TextureCache reference
+    unordered_map<string, unsigned int> textures_loaded;
     string directory;
+    VertexFormat vertexFormat;
+    // ModelKeep flags, geometry holds the MeshData kept for KeepGeometry
+    unsigned int keep;
+    vector<MeshData> geometry;
+    // GL buffers several meshes read from (glTF buffer views), owned by the model
+    vector<GLuint> sharedBuffers;
 
-    // Load model using Assimp
-    void loadModel(const string& path) {
-        Assimp::Importer import;
-        const aiScene* scene = import.ReadFile(path,
-            aiProcess_Triangulate |
-            aiProcess_FlipUVs |
-            aiProcess_CalcTangentSpace);
+    // Meshes with the same textures and node drawn by one multi-draw, the draw arrays are refilled every frame
+    // so each mesh can sit at its own LOD and culled meshes drop out
+    struct MaterialBatch {
+        vector<Texture> textures;
+        vector<unsigned int> meshes;
+        vector<GLsizei> counts;
+        vector<void*> offsets;
+        vector<GLint> baseVertices;
+        int object = 0;                 // ObjectBuffer index of the batch's node matrix this draw
+    };
+    GLuint mergedVAO = 0, mergedVBO = 0, mergedEBO = 0;
+    vector<bool> mergedMesh;            // per mesh, true if it lives in the merged buffers
+    vector<size_t> mergedFirstVertex;
+    vector<size_t> mergedFirstIndex;
+    vector<MaterialBatch> batches;
+    bool mergedDraw = false;
+    size_t drawCalls = 0;
 
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            cout << "ERROR::ASSIMP::" << import.GetErrorString() << " -- path: " << path << endl;
-            return;
-        }
+    // Skin texture array, meshLayers holds each mesh's own layer (-1 = not in the array)
+    const TextureArray* textureArray = nullptr;
+    vector<int> meshLayers;
+    int layer = -1;
+
+    // Kept clear of the units Mesh::BindTextures hands out, samplers of different types can't share a unit
+    static const unsigned int TextureArrayUnit = 7;
+
+    // Node transforms, nodeMatrices holds model * world per node for the current Draw
+    TransformHierarchy hierarchy;
+    vector<glm::mat4> nodeMatrices;
+
+    // Frustum culling, the bounds sets are scratch space refilled every Draw
+    bool frustumCulling = true;
+    CullStats cullStats;
+    CullBoxes cullBoxes;
+    CullSpheres cullSpheres;
+    vector<uint8_t> meshVisible;        // per mesh, 0 = culled this Draw
+    vector<uint8_t> instanceVisible;    // per instance, in InstanceBuffer order
+
+    // Triangle hierarchies for picking, one per mesh in object space
+    vector<MeshBvh> meshBvhs;
+
+    // Software occlusion, occluderCorners holds each mesh's coarsest LOD as an object space triangle list
+    const OcclusionCuller* occlusionCuller = nullptr;
+    vector<vector<glm::vec3>> occluderCorners;
+
+    // Skeletal animation, skinned meshes draw with the model matrix and their joints from skinPalette
+    Skeleton skeleton;
+    vector<AnimationClip> clips;
+    const SkinPalette* skinPalette = nullptr;
+    int skinPose = 0;
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    static constexpr unsigned int PaletteUnit = 6;
+
+    // World, MVP and normal matrices of every mesh and merged batch Draw submits, rebuilt every draw.
+    // meshObjects holds each mesh's object
+    ObjectBuffer objects;
+    vector<int> meshObjects;
+    glm::mat4 viewProjection = glm::mat4(1.0f);   // camera of the current draw, passed in by every Draw
 
-        cout << "Model loaded successfully: " << path << endl;
+    // DrawInstanced's objects, one per streamed copy, and what they were built from. Rebuilt and uploaded
+    // only when the instances, the visible copies or the camera change
+    ObjectBuffer instanceObjects;
+    vector<glm::mat4> instanceTransforms;
+    const InstanceBuffer* instanceObjectsSource = nullptr;
+    uint64_t instanceObjectsVersion = 0;
+    glm::mat4 instanceObjectsViewProjection = glm::mat4(1.0f);
+    bool instanceObjectsFiltered = false;
+    vector<uint8_t> instanceObjectsVisible;
+    bool instanceObjectsUploaded = false;   // the GL buffer holds all of them
+    static constexpr unsigned int ObjectUnit = 5;
+
+    // ModelVertex.glsl / ModelFragment.glsl uniforms set per draw, hashed at compile time
+    static constexpr UniformName ObjectDataUniform = "objectData";
+    static constexpr UniformName ObjectBaseUniform = "objectBase";
+    static constexpr UniformName NodeMatrixUniform = "nodeMatrix";
+    static constexpr UniformName NodeNormalMatrixUniform = "nodeNormalMatrix";
+    static constexpr UniformName InstancedUniform = "instanced";
+    static constexpr UniformName SkinnedUniform = "skinned";
+    static constexpr UniformName UseTextureArrayUniform = "useTextureArray";
+    static constexpr UniformName TextureArrayUniform = "textureArray";
+    static constexpr UniformName BonePaletteUniform = "bonePalette";
+    static constexpr UniformName PoseUniform = "pose";
+    static constexpr UniformName PaletteStrideUniform = "paletteStride";
+
+    // Assimp post processing used for every import, part of the model cache key. Without JoinIdenticalVertices every
+    // triangle comes back with 3 vertices of its own, which leaves nothing for the cache reorder or the simplifier
+    static constexpr unsigned int ImportFlags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices
+        | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // Meshes with at least this many faces should always simplify, processMeshes warns when one gets no coarser LOD
+    static constexpr size_t LodCheckFaces = 1024;
+
+    // Load model from the processed cache if it is current, otherwise through Assimp
+    void loadModel(const string& path) {
+        auto loadStart = std::chrono::high_resolution_clock::now();
 
         // Handle both '/' and '\' directory separators (Windows)
         size_t pos = path.find_last_of("/\\");
@@ -66,38 +481,865 @@ private:
         else
             directory = ".";
 
-        processNode(scene->mRootNode, scene);
+        // glTF needs no processing or cache, its buffers are uploaded as stored
+        if (GltfLoader::IsGltfPath(path)) {
+            if (loadGltf(path)) {
+                cout << "Model loaded successfully: " << path << " (native glTF, "
+                    << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count()
+                    << " ms)" << endl;
+                cout << "Total meshes loaded: " << meshes.size() << endl;
+                printVertexMemory();
+                TextureCache::Instance().PrintStats();
+                return;
+            }
+            cout << "[Model] Native glTF path can't read this file, falling back to Assimp" << endl;
+        }
+
+        // OBJ files go through the native reader, everything else through Assimp.
+        // The importer is part of the cache key since the two produce different mesh splits
+        bool nativeObj = ObjLoader::IsObjPath(path);
+        unsigned int importKey = nativeObj ? ObjLoader::ImportKey : ImportFlags;
+
+        uint64_t sourceHash = 0;
+        bool hashed = ModelCache::HashFile(path, sourceHash);
+        string cachePath = ModelCache::CachePath(path);
+
+        if (hashed && loadFromCache(cachePath, sourceHash, importKey)) {
+            cout << "Model loaded from cache: " << cachePath << " ("
+                << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count()
+                << " ms)" << endl;
+            cout << "Total meshes loaded: " << meshes.size() << endl;
+            printVertexMemory();
+            TextureCache::Instance().PrintStats();
+            return;
+        }
+
+        vector<MeshData> meshData;
+        vector<NodeData> nodes;
+        if (nativeObj) {
+            if (!ObjLoader::Load(path, meshData)) {
+                cout << "ERROR::OBJLOADER:: could not read -- path: " << path << endl;
+                return;
+            }
+            // OBJ has no hierarchy, everything hangs off one identity node
+            nodes.push_back(NodeData());
+            nodes.back().name = "root";
+        }
+        else if (!ImportAssimp(path, meshData, nodes, &skeleton, &clips)) {
+            return;
+        }
+
+        cout << "Model loaded successfully: " << path << (nativeObj ? " (native OBJ)" : "") << endl;
+
+        processMeshes(meshData);
 
-        cout << "Total meshes loaded: " << meshes.size() << endl;
+        // The cache has no skeleton, clips or skin streams, so rigged models are imported every time
+        if (IsSkinned())
+            cout << "[Model] Skeleton with " << skeleton.JointCount() << " joints and " << clips.size() << " clips, not cached" << endl;
+        else if (hashed && ModelCache::Write(cachePath, sourceHash, importKey, meshData, nodes))
+            cout << "Model cache written: " << cachePath << endl;
+
+        // Without a CPU consumer each mesh gives its arrays back as soon as they are uploaded, so the
+        // imported copy and the driver's staging copy of every mesh never pile up
+        meshes.reserve(meshData.size());
+        for (MeshData& data : meshData) {
+            uploadMesh(data);
+            if (keep == KeepNothing) {
+                vector<Vertex>().swap(data.vertices);
+                vector<unsigned int>().swap(data.indices);
+                vector<SkinVertex>().swap(data.skin);
+            }
+        }
+        buildHierarchy(nodes);
+
+        if (keep & (KeepPicking | KeepOccluders)) {
+            vector<BvhTriangleSource> sources, coarseSources;
+            for (const MeshData& data : meshData) {
+                sources.push_back(triangleSource(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), data.lods, 0));
+                coarseSources.push_back(triangleSource(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), data.lods, (int)data.lods.size() - 1));
+            }
+            buildBvhs(sources, coarseSources);
+        }
+        if (keep & KeepGeometry)
+            geometry = std::move(meshData);
+
+        cout << "Total meshes loaded: " << meshes.size() << " ("
+            << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count()
+            << " ms)" << endl;
+        printVertexMemory();
+        TextureCache::Instance().PrintStats();
+    }
+
+    void drawMeshes(ShaderProgram& shader) {
+        drawCalls = 0;
+        // Matrices of every mesh and merged batch that draws go up together before the first draw
+        objects.Clear();
+        meshObjects.assign(meshes.size(), 0);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (meshVisible[i] && !(mergedDraw && mergedMesh[i]))
+                meshObjects[i] = objects.Add(viewProjection, meshWorld(i));
+        if (mergedDraw)
+            for (MaterialBatch& batch : batches)
+                batch.object = objects.Add(viewProjection, nodeMatrices[meshes[batch.meshes[0]].node]);
+
+        shader.use();
+        uploadObjects(shader);
+        shader.setInt(TextureArrayUniform, TextureArrayUnit);
+        if (textureArray)
+            textureArray->Bind(TextureArrayUnit);
+        bindPalette(shader);
+
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            if (!meshVisible[i] || (mergedDraw && mergedMesh[i]))
+                continue;
+            applyLayer(shader, i);
+            applyTransform(shader, i);
+            meshes[i].DrawMesh(shader);
+            drawCalls++;
+        }
+        shader.setBool(SkinnedUniform, false);
+        if (mergedDraw)
+            drawMerged(shader);
+        shader.setBool(UseTextureArrayUniform, false);
+    }
+
+    // Skinned meshes with a palette get only the model matrix, the joints already place them. Everything else its node's matrix
+    const glm::mat4& meshWorld(unsigned int mesh) const {
+        return skinning(mesh) ? modelMatrix : nodeMatrices[meshes[mesh].node];
+    }
+
+    void applyTransform(ShaderProgram& shader, unsigned int mesh) {
+        shader.setBool(SkinnedUniform, skinning(mesh));
+        shader.setInt(ObjectBaseUniform, meshObjects[mesh]);
+    }
+
+    // Whether instanceObjects still match what DrawInstanced would build for these instances
+    bool instanceObjectsCurrent(const InstanceBuffer& instances, bool filtered) const {
+        return instanceObjects.Count() > 0 && instanceObjectsSource == &instances && instanceObjectsVersion == instances.Version()
+            && instanceObjectsViewProjection == viewProjection && instanceObjectsFiltered == filtered
+            && (!filtered || instanceObjectsVisible == instanceVisible);
+    }
+
+    void uploadObjects(ShaderProgram& shader) {
+        objects.Upload();
+        objects.Bind(ObjectUnit);
+        shader.setInt(ObjectDataUniform, ObjectUnit);
+    }
+
+    bool skinning(unsigned int mesh) const { return skinPalette && meshes[mesh].skinVBO; }
+
+    void bindPalette(ShaderProgram& shader) {
+        // Always on its own unit, like the texture array, even when nothing is skinned
+        shader.setInt(BonePaletteUniform, PaletteUnit);
+        if (!skinPalette)
+            return;
+        skinPalette->Bind(PaletteUnit);
+        shader.setInt(PoseUniform, skinPose);
+        shader.setInt(PaletteStrideUniform, (int)skeleton.JointCount());
     }
 
-    // Traverse scene nodes
-    void processNode(aiNode* node, const aiScene* scene) {
+    // Layer is a constant vertex attribute (location 3) so it costs no uniform or texture change
+    void applyLayer(ShaderProgram& shader, unsigned int mesh) {
+        int meshLayer = textureArray ? meshLayers[mesh] : -1;
+        shader.setBool(UseTextureArrayUniform, meshLayer >= 0);
+        if (meshLayer >= 0)
+            glVertexAttrib1f(3, (float)(layer >= 0 ? layer : meshLayer));
+    }
+
+    void drawMerged(ShaderProgram& shader) {
+        shader.use();
+        shader.setBool(Mesh::CompactVerticesUniform, false);
+        shader.setBool(SkinnedUniform, false);
+        glBindVertexArray(mergedVAO);
+        for (MaterialBatch& batch : batches) {
+            GLsizei drawn = 0;
+            for (size_t j = 0; j < batch.meshes.size(); j++) {
+                unsigned int index = batch.meshes[j];
+                if (!meshVisible[index])
+                    continue;
+                const Mesh& mesh = meshes[index];
+                size_t first = mergedFirstIndex[index];
+                size_t count = mesh.indexCount;
+                if (!mesh.lods.empty()) {
+                    first += mesh.lods[mesh.currentLod].firstIndex;
+                    count = mesh.lods[mesh.currentLod].indexCount;
+                }
+                batch.counts[drawn] = (GLsizei)count;
+                batch.offsets[drawn] = (void*)(first * sizeof(unsigned int));
+                batch.baseVertices[drawn] = (GLint)mergedFirstVertex[index];
+                drawn++;
+            }
+            if (drawn == 0)
+                continue;
+
+            Mesh::BindTextures(shader, batch.textures);
+            applyLayer(shader, batch.meshes[0]);
+            shader.setInt(ObjectBaseUniform, batch.object);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), GL_UNSIGNED_INT,
+                batch.offsets.data(), drawn, batch.baseVertices.data());
+            drawCalls++;
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Copies the per mesh buffers into the merged ones on the GPU, no CPU copy of the vertex data is needed
+    void buildMergedBuffers() {
+        mergedMesh.assign(meshes.size(), false);
+        mergedFirstVertex.assign(meshes.size(), 0);
+        mergedFirstIndex.assign(meshes.size(), 0);
+        batches.clear();
+
+        size_t vertexTotal = 0, indexTotal = 0;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Mesh& mesh = meshes[i];
+            if (!mesh.VBO || !mesh.EBO || mesh.skinVBO || mesh.vertexFormat != VertexFormat::Standard || mesh.indexType != GL_UNSIGNED_INT)
+                continue;
+            mergedMesh[i] = true;
+            mergedFirstVertex[i] = vertexTotal;
+            mergedFirstIndex[i] = indexTotal;
+            vertexTotal += mesh.vertexCount;
+            indexTotal += mesh.indexCount;
+        }
+        if (vertexTotal == 0)
+            return;
+
+        glGenVertexArrays(1, &mergedVAO);
+        glGenBuffers(1, &mergedVBO);
+        glGenBuffers(1, &mergedEBO);
+        glBindVertexArray(mergedVAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, mergedVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexTotal * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mergedEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexTotal * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            if (!mergedMesh[i])
+                continue;
+            const Mesh& mesh = meshes[i];
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh.VBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0,
+                mergedFirstVertex[i] * sizeof(Vertex), mesh.vertexCount * sizeof(Vertex));
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh.EBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0,
+                mergedFirstIndex[i] * sizeof(unsigned int), mesh.indexCount * sizeof(unsigned int));
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        // Same layout as Mesh::SetupModelBuffers
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(2);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Group by the exact texture bindings, in first use order
+        unordered_map<string, size_t> batchOf;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            if (!mergedMesh[i])
+                continue;
+            // A multi-draw shares one model matrix, so batches are per material and node
+            string key = std::to_string(meshes[i].node) + "|";
+            for (const Texture& texture : meshes[i].meshTextures)
+                key += texture.type + ":" + std::to_string(texture.id) + ";";
+
+            auto found = batchOf.find(key);
+            if (found == batchOf.end()) {
+                found = batchOf.emplace(key, batches.size()).first;
+                batches.push_back(MaterialBatch());
+                batches.back().textures = meshes[i].meshTextures;
+            }
+            batches[found->second].meshes.push_back((unsigned int)i);
+        }
+        for (MaterialBatch& batch : batches) {
+            batch.counts.resize(batch.meshes.size());
+            batch.offsets.resize(batch.meshes.size());
+            batch.baseVertices.resize(batch.meshes.size());
+        }
+
+        cout << "[Model] Merged " << std::count(mergedMesh.begin(), mergedMesh.end(), true) << " of " << meshes.size()
+            << " meshes into " << batches.size() << " material/node batches (" << (vertexTotal * sizeof(Vertex)) / 1024 << " KB vertices, "
+            << (indexTotal * sizeof(unsigned int)) / 1024 << " KB indices)" << endl;
+    }
+
+    void deleteMergedBuffers() {
+        if (!glfwGetCurrentContext())
+            return;
+        if (mergedEBO) glDeleteBuffers(1, &mergedEBO);
+        if (mergedVBO) glDeleteBuffers(1, &mergedVBO);
+        if (mergedVAO) glDeleteVertexArrays(1, &mergedVAO);
+        mergedVAO = mergedVBO = mergedEBO = 0;
+    }
+
+    // Uploads every geometry buffer view once straight from the mapped file, meshes point their
+    // attributes at the views with the file's own strides and component types
+    bool loadGltf(const string& path) {
+        GltfLoader gltf;
+        if (!gltf.Load(path))
+            return false;
+
+        if (vertexFormat == VertexFormat::Compact)
+            cout << "[Model] glTF meshes keep the vertex layout stored in the file" << endl;
+
+        vector<GLuint> viewBuffers(gltf.views.size(), 0);
+        for (size_t i = 0; i < gltf.views.size(); i++) {
+            if (!gltf.views[i].geometry)
+                continue;
+            glGenBuffers(1, &viewBuffers[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, viewBuffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, gltf.views[i].size, gltf.views[i].data, GL_STATIC_DRAW);
+            sharedBuffers.push_back(viewBuffers[i]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        vector<BvhTriangleSource> sources;
+        meshes.reserve(gltf.primitives.size());
+        for (const GltfPrimitive& primitive : gltf.primitives) {
+            // Positions are always float VEC3 in glTF, read them straight from the mapped view
+            BvhTriangleSource source;
+            for (const BufferAttribute& attribute : primitive.attributes) {
+                if (attribute.location != 0)
+                    continue;
+                source.positions = gltf.views[attribute.buffer].data + attribute.offset;
+                source.positionStride = attribute.stride ? attribute.stride : 3 * sizeof(float);
+            }
+            source.vertexCount = primitive.vertexCount;
+            if (primitive.indexView >= 0) {
+                source.indices = gltf.views[primitive.indexView].data + primitive.indexOffset;
+                source.indexSize = Mesh::TypeBytes(primitive.indexType);
+                source.indexCount = primitive.indexCount;
+            }
+            if (!source.positions)
+                source.vertexCount = 0;
+            sources.push_back(source);
+
+            vector<BufferAttribute> attributes = primitive.attributes;
+            for (BufferAttribute& attribute : attributes)
+                attribute.buffer = viewBuffers[attribute.buffer];
+
+            vector<Texture> textures;
+            if (primitive.baseColorImage >= 0)
+                textures.push_back(gltfTexture(gltf, primitive.baseColorImage, path));
+
+            meshes.emplace_back(attributes, primitive.indexView >= 0 ? viewBuffers[primitive.indexView] : 0,
+                primitive.indexType, primitive.indexOffset, primitive.indexCount, primitive.vertexCount,
+                std::move(textures), primitive.boundsMin, primitive.boundsMax);
+            meshes.back().node = primitive.node;
+            // Only the accessor min/max is known without reading the positions
+            meshes.back().boundsRadius = glm::length(primitive.boundsMax - primitive.boundsMin) * 0.5f;
+        }
+        buildHierarchy(gltf.nodes);
+        // No LODs for glTF, the full mesh doubles as its occluder
+        if (keep & (KeepPicking | KeepOccluders))
+            buildBvhs(sources, sources);
+        if (keep & KeepGeometry)
+            cout << "[Model] glTF meshes stay in the file layout, no MeshData is kept" << endl;
+        return true;
+    }
+
+    // External images resolve like any other texture, embedded ones are decoded from the GLB bytes on the worker pool
+    Texture gltfTexture(const GltfLoader& gltf, int imageIndex, const string& path) {
+        const GltfImage& image = gltf.images[imageIndex];
+        Texture texture;
+        texture.id = 0;
+        texture.type = "texture_diffuse";
+
+        if (!image.uri.empty()) {
+            texture.path = image.uri;
+            vector<Texture> single(1, texture);
+            resolveTextures(single);
+            return single[0];
+        }
+
+        texture.path = path + "#image" + std::to_string(imageIndex);
+        auto loaded = textures_loaded.find(texture.path);
+        if (loaded != textures_loaded.end()) {
+            texture.id = loaded->second;
+        }
+        else if (image.bufferView >= 0) {
+            const GltfView& view = gltf.views[image.bufferView];
+            texture.id = TextureCache::Instance().AcquireEncoded(texture.path, view.data, view.size, false);
+            textures_loaded[texture.path] = texture.id;
+        }
+        return texture;
+    }
+
+    // Builds meshes straight from a mapped cache entry, never touches Assimp
+    bool loadFromCache(const string& cachePath, uint64_t sourceHash, unsigned int importKey) {
+        ModelCache cache;
+        if (!cache.Open(cachePath, sourceHash, importKey))
+            return false;
+
+        vector<BvhTriangleSource> sources, coarseSources;
+        meshes.reserve(cache.meshCount());
+        for (uint32_t i = 0; i < cache.meshCount(); i++) {
+            const ModelCacheMesh& entry = cache.mesh(i);
+            vector<Texture> textures = cache.textures(entry);
+            resolveTextures(textures);
+
+            meshes.emplace_back(cache.vertices(entry), entry.vertexCount,
+                cache.indices(entry), entry.indexCount, std::move(textures),
+                glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+                glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]), vertexFormat, cache.lods(entry));
+            meshes.back().node = entry.node;
+            meshes.back().boundsRadius = entry.boundsRadius;
+            const vector<MeshLod>& lods = meshes.back().lods;
+            sources.push_back(triangleSource(cache.vertices(entry), entry.vertexCount, cache.indices(entry), entry.indexCount, lods, 0));
+            coarseSources.push_back(triangleSource(cache.vertices(entry), entry.vertexCount, cache.indices(entry), entry.indexCount, lods, (int)lods.size() - 1));
+        }
+        buildHierarchy(cache.nodes());
+        // The cache stays mapped until the hierarchies are built
+        if (keep & (KeepPicking | KeepOccluders))
+            buildBvhs(sources, coarseSources);
+
+        // Export copies come straight out of the mapping, nothing else reads the cache afterwards
+        if (keep & KeepGeometry) {
+            geometry.resize(cache.meshCount());
+            for (uint32_t i = 0; i < cache.meshCount(); i++) {
+                const ModelCacheMesh& entry = cache.mesh(i);
+                MeshData& data = geometry[i];
+                data.vertices.assign(cache.vertices(entry), cache.vertices(entry) + entry.vertexCount);
+                data.indices.assign(cache.indices(entry), cache.indices(entry) + entry.indexCount);
+                data.textures = cache.textures(entry);
+                data.lods = meshes[i].lods;
+                data.boundsMin = meshes[i].boundsMin;
+                data.boundsMax = meshes[i].boundsMax;
+                data.boundsRadius = entry.boundsRadius;
+                data.node = entry.node;
+            }
+        }
+        return true;
+    }
+
+    // Creates the GL side of a processed mesh
+    void uploadMesh(const MeshData& data) {
+        vector<Texture> textures = data.textures;
+        resolveTextures(textures);
+
+        meshes.emplace_back(data.vertices.data(), data.vertices.size(),
+            data.indices.data(), data.indices.size(), std::move(textures),
+            data.boundsMin, data.boundsMax, vertexFormat, data.lods);
+        meshes.back().node = data.node;
+        meshes.back().boundsRadius = data.boundsRadius;
+        if (!data.skin.empty())
+            meshes.back().AttachSkin(data.skin.data());
+    }
+
+    // Meshes must already carry their node index, ones pointing past the tree fall back to the root
+    void buildHierarchy(const vector<NodeData>& nodes) {
+        if (nodes.empty()) {
+            vector<NodeData> root(1);
+            root[0].name = "root";
+            hierarchy.Build(root);
+        }
+        else {
+            hierarchy.Build(nodes);
+        }
+        for (Mesh& mesh : meshes)
+            if (mesh.node >= hierarchy.Size())
+                mesh.node = 0;
+        nodeMatrices.assign(hierarchy.Size(), glm::mat4(1.0f));
+    }
+
+    // Brings dirty world matrices up to date and places every node under the model matrix
+    void prepareNodeMatrices(const glm::mat4& model) {
+        modelMatrix = model;
+        hierarchy.Update();
+        for (size_t i = 0; i < hierarchy.Size(); i++)
+            TransformHierarchy::Multiply(model, hierarchy.World((int)i), nodeMatrices[i]);
+    }
+
+    // Largest axis scale of a matrix, keeps radii conservative under non uniform scaling
+    static float maxScale(const glm::mat4& m) {
+        return glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+    }
+
+    // Tests every mesh's AABB under its node matrix, fills meshVisible
+    void cullMeshes(const Frustum& frustum) {
+        cullStats = CullStats();
+        meshVisible.assign(meshes.size(), 1);
+        if (frustumCulling) {
+            cullBoxes.Clear();
+            for (const Mesh& mesh : meshes)
+                cullBoxes.Add(mesh.boundsMin, mesh.boundsMax, nodeMatrices[mesh.node]);
+            size_t visible = FrustumCuller::TestBoxes(frustum, cullBoxes, meshVisible);
+            // Bind pose boxes say nothing about a posed skin
+            for (unsigned int i = 0; i < meshes.size(); i++) {
+                if (skinning(i) && !meshVisible[i]) {
+                    meshVisible[i] = 1;
+                    visible++;
+                }
+            }
+            cullStats.meshesTested = meshes.size();
+            cullStats.meshesCulled = meshes.size() - visible;
+        }
+
+        if (occlusionCuller) {
+            auto occlusionStart = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < meshes.size(); i++) {
+                if (meshVisible[i] && !skinning((unsigned int)i) && !occlusionCuller->IsVisible(meshes[i].boundsMin, meshes[i].boundsMax, nodeMatrices[meshes[i].node])) {
+                    meshVisible[i] = 0;
+                    cullStats.meshesOccluded++;
+                }
+            }
+            cullStats.occlusionMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - occlusionStart).count();
+        }
+    }
+
+    // Tests the model bounding sphere under every instance transform, fills instanceVisible and returns the visible count
+    size_t cullInstances(const Frustum& frustum, const InstanceBuffer& instances) {
+        glm::vec4 sphere = boundingSphere();
+        glm::vec3 center(sphere);
+
+        cullSpheres.Clear();
+        for (const InstanceData& instance : instances.Instances())
+            cullSpheres.Add(glm::vec3(instance.transform * glm::vec4(center, 1.0f)), sphere.w * maxScale(instance.transform));
+        size_t visible = FrustumCuller::TestSpheres(frustum, cullSpheres, instanceVisible);
+        cullStats.instancesTested = instances.Count();
+        cullStats.instancesCulled = instances.Count() - visible;
+        return visible;
+    }
+
+    // Tests the model AABB under every still visible instance against the occlusion culler, returns how many it hid
+    size_t occludeInstances(const InstanceBuffer& instances) {
+        auto occlusionStart = std::chrono::high_resolution_clock::now();
+        glm::vec3 boundsMin, boundsMax;
+        getBounds(boundsMin, boundsMax);
+        size_t occluded = 0;
+        const vector<InstanceData>& data = instances.Instances();
+        for (size_t i = 0; i < data.size(); i++) {
+            if (instanceVisible[i] && !occlusionCuller->IsVisible(boundsMin, boundsMax, data[i].transform)) {
+                instanceVisible[i] = 0;
+                occluded++;
+            }
+        }
+        cullStats.instancesOccluded = occluded;
+        cullStats.occlusionMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - occlusionStart).count();
+        return occluded;
+    }
+
+    // Sphere (xyz center, w radius) holding every mesh sphere under the current node matrices
+    glm::vec4 boundingSphere() const {
+        vector<glm::vec4> spheres(meshes.size());
+        glm::vec3 low(0.0f), high(0.0f);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Mesh& mesh = meshes[i];
+            const glm::mat4& matrix = nodeMatrices[mesh.node];
+            glm::vec3 center = glm::vec3(matrix * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            spheres[i] = glm::vec4(center, mesh.boundsRadius * maxScale(matrix));
+            low = i == 0 ? center - spheres[i].w : glm::min(low, center - spheres[i].w);
+            high = i == 0 ? center + spheres[i].w : glm::max(high, center + spheres[i].w);
+        }
+        glm::vec3 center = (low + high) * 0.5f;
+        float radius = 0.0f;
+        for (const glm::vec4& s : spheres)
+            radius = glm::max(radius, glm::length(glm::vec3(s) - center) + s.w);
+        return glm::vec4(center, radius);
+    }
+
+    // Triangles of one LOD of a mesh held as Vertex/unsigned int arrays, the whole index range if it has no LODs
+    static BvhTriangleSource triangleSource(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+        const vector<MeshLod>& lods, int lod) {
+        BvhTriangleSource source;
+        source.positions = reinterpret_cast<const unsigned char*>(vertices) + offsetof(Vertex, Position);
+        source.positionStride = sizeof(Vertex);
+        source.vertexCount = vertexCount;
+        source.indices = lods.empty() ? indices : indices + lods[lod].firstIndex;
+        source.indexSize = sizeof(unsigned int);
+        source.indexCount = lods.empty() ? indexCount : lods[lod].indexCount;
+        return source;
+    }
+
+    // One triangle BVH per mesh (LOD0, KeepPicking) and the occluder triangles (coarsest LOD, KeepOccluders) while the
+    // source data is still around. Meshes are spread over the worker pool and big ones split their top levels further
+    void buildBvhs(const vector<BvhTriangleSource>& sources, const vector<BvhTriangleSource>& coarseSources) {
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        bool picking = (keep & KeepPicking) != 0;
+        bool occluders = (keep & KeepOccluders) != 0;
+        meshBvhs.assign(picking ? sources.size() : 0, MeshBvh());
+        occluderCorners.assign(occluders ? coarseSources.size() : 0, vector<glm::vec3>());
+        ThreadPool::Instance().ParallelFor(sources.size(), [&](size_t i) {
+            if (picking)
+                meshBvhs[i].Build(sources[i]);
+            if (occluders) {
+                const BvhTriangleSource& coarse = coarseSources[i];
+                occluderCorners[i].resize(coarse.TriangleCount() * 3);
+                for (size_t k = 0; k < occluderCorners[i].size(); k++)
+                    occluderCorners[i][k] = coarse.Corner(k);
+            }
+        });
+
+        size_t triangles = 0, nodes = 0;
+        for (const MeshBvh& bvh : meshBvhs) {
+            triangles += bvh.TriangleCount();
+            nodes += bvh.NodeCount();
+        }
+        cout << "[Model] Built " << meshBvhs.size() << " BVHs over " << triangles << " triangles, " << nodes << " nodes ("
+            << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count()
+            << " ms)" << endl;
+    }
+
+    // Reports the model vertex buffer footprint and what the compact format saved
+    void printVertexMemory() const {
+        size_t uploaded = 0;
+        size_t standard = 0;
+        for (const Mesh& mesh : meshes) {
+            uploaded += mesh.vertexBufferBytes;
+            standard += (size_t)mesh.vertexCount * sizeof(Vertex);
+        }
+        cout << "Vertex buffers: " << uploaded / 1024 << " KB";
+        if (vertexFormat == VertexFormat::Compact)
+            cout << " (compact, saved " << (standard - uploaded) / 1024 << " KB of " << standard / 1024 << " KB)";
+        cout << endl;
+
+        // Whatever stays resident on the CPU is there because a ModelKeep flag asked for it
+        size_t pickingBytes = 0, occluderBytes = 0, geometryBytes = 0;
+        for (const MeshBvh& bvh : meshBvhs)
+            pickingBytes += bvh.MemoryBytes();
+        for (const vector<glm::vec3>& corners : occluderCorners)
+            occluderBytes += corners.capacity() * sizeof(glm::vec3);
+        for (const MeshData& data : geometry)
+            geometryBytes += data.vertices.capacity() * sizeof(Vertex) + data.indices.capacity() * sizeof(unsigned int)
+                + data.skin.capacity() * sizeof(SkinVertex);
+        cout << "CPU geometry kept: " << (pickingBytes + occluderBytes + geometryBytes) / 1024 << " KB (picking "
+            << pickingBytes / 1024 << " KB, occluders " << occluderBytes / 1024 << " KB, export " << geometryBytes / 1024 << " KB)" << endl;
+    }
+
+    // Index optimization and LOD generation for every mesh on the worker pool
+    void processMeshes(vector<MeshData>& meshData) {
+        auto processStart = std::chrono::high_resolution_clock::now();
+        vector<MeshOptimizationReport> reports(meshData.size());
+        vector<size_t> vertexCounts(meshData.size());
+        ThreadPool::Instance().ParallelFor(meshData.size(), [&](size_t i) {
+            vertexCounts[i] = meshData[i].vertices.size();
+            reports[i] = MeshOptimizer::Optimize(meshData[i]);
+            MeshSimplifier::GenerateLods(meshData[i]);
+            meshData[i].boundsRadius = boundingRadius(meshData[i]);
+        });
+
+        for (size_t i = 0; i < meshData.size(); i++) {
+            const MeshData& data = meshData[i];
+            size_t faces = data.lods.empty() ? data.indices.size() / 3 : data.lods[0].indexCount / 3;
+            cout << "  Mesh - Verts: " << vertexCounts[i]
+                << " Faces: " << faces
+                << " Textures: " << data.textures.size()
+                << " ACMR: " << reports[i].before.acmr << " -> " << reports[i].after.acmr
+                << " ATVR: " << reports[i].before.atvr << " -> " << reports[i].after.atvr
+                << " LOD tris:";
+            for (const MeshLod& lod : data.lods)
+                cout << " " << lod.indexCount / 3;
+            cout << endl;
+            // Every position having several wedges (an unwelded import) locks all vertices in the simplifier
+            if (faces >= LodCheckFaces && data.lods.size() < 2)
+                cerr << "[Model] Warning: mesh of " << faces << " faces and " << vertexCounts[i]
+                    << " vertices got no coarser LOD, are its vertices welded?" << endl;
+        }
+        cout << "Processed " << meshData.size() << " meshes on " << ThreadPool::Instance().WorkerCount() + 1 << " threads ("
+            << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - processStart).count()
+            << " ms)" << endl;
+    }
+
+    // Radius of the sphere around the AABB center that holds every vertex, tighter than half the diagonal
+    static float boundingRadius(const MeshData& data) {
+        glm::vec3 center = (data.boundsMin + data.boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (const Vertex& vertex : data.vertices) {
+            glm::vec3 d = vertex.Position - center;
+            radiusSquared = glm::max(radiusSquared, glm::dot(d, d));
+        }
+        return std::sqrt(radiusSquared);
+    }
+
+    // Traverse scene nodes and convert every mesh on the worker pool
+    // Output order is the depth first node order, same as a serial walk
+    // Joints are numbered serially first so every mesh agrees on them, the weights are then read in parallel
+    static void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshData, vector<NodeData>& nodes, Skeleton& skeleton) {
+        vector<const aiMesh*> order;
+        vector<unsigned int> orderNodes;
+        nodes.clear();
+        collectMeshes(node, scene, -1, order, orderNodes, nodes);
+
+        skeleton = Skeleton();
+        unordered_map<string, int> nodeIndex = nodeIndices(nodes);
+        vector<MeshJoints> joints(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            const aiMesh* mesh = order[i];
+            if (!mesh->HasBones())
+                continue;
+            joints[i].bones.assign(mesh->mNumBones, -1);
+            for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+                auto found = nodeIndex.find(mesh->mBones[b]->mName.C_Str());
+                if (found != nodeIndex.end())
+                    joints[i].bones[b] = skeleton.Joint(found->second, toGlm(mesh->mBones[b]->mOffsetMatrix));
+            }
+            // Vertices no bone weighs stay rigid on the mesh's own node
+            joints[i].fallback = skeleton.Joint((int)orderNodes[i], glm::mat4(1.0f));
+        }
+
+        meshData.resize(order.size());
+        ThreadPool::Instance().ParallelFor(order.size(), [&](size_t i) {
+            meshData[i] = processMesh(order[i], scene, joints[i]);
+            meshData[i].node = orderNodes[i];
+        });
+    }
+
+    // Skeleton joint of every aiBone of one mesh (-1 = bone names no node)
+    struct MeshJoints {
+        vector<int> bones;
+        int fallback = 0;
+    };
+
+    // Node name -> flattened index, the first node wins if names repeat
+    static unordered_map<string, int> nodeIndices(const vector<NodeData>& nodes) {
+        unordered_map<string, int> nodeIndex;
+        for (size_t i = 0; i < nodes.size(); i++)
+            nodeIndex.emplace(nodes[i].name, (int)i);
+        return nodeIndex;
+    }
+
+    // Assimp matrices are row major
+    static glm::mat4 toGlm(const aiMatrix4x4& m) {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+            m.a2, m.b2, m.c2, m.d2,
+            m.a3, m.b3, m.c3, m.d3,
+            m.a4, m.b4, m.c4, m.d4);
+    }
+
+    // Resamples every animation at AnimationClip::DefaultFrameRate, channels on nodes outside the tree are dropped.
+    // Components a channel has no keys for keep the node's bind value
+    static void importClips(const aiScene* scene, const vector<NodeData>& nodes, vector<AnimationClip>& clips) {
+        clips.clear();
+        unordered_map<string, int> nodeIndex = nodeIndices(nodes);
+        for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+            const aiAnimation* animation = scene->mAnimations[a];
+            double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+
+            AnimationClip clip;
+            clip.name = animation->mName.C_Str();
+            clip.duration = (float)(animation->mDuration / ticksPerSecond);
+            vector<const aiNodeAnim*> channels;
+            for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+                auto found = nodeIndex.find(animation->mChannels[c]->mNodeName.C_Str());
+                if (found == nodeIndex.end())
+                    continue;
+                clip.channelNodes.push_back(found->second);
+                channels.push_back(animation->mChannels[c]);
+            }
+            if (channels.empty())
+                continue;
+
+            size_t frameCount = (size_t)std::ceil(clip.duration * clip.frameRate) + 1;
+            size_t channelCount = channels.size();
+            clip.frames.resize(frameCount * channelCount);
+            ThreadPool::Instance().ParallelFor(channelCount, [&](size_t c) {
+                const aiNodeAnim* channel = channels[c];
+                ChannelPose bind = Animator::Decompose(nodes[clip.channelNodes[c]].local);
+                unsigned int positionKey = 0, rotationKey = 0, scaleKey = 0;
+                for (size_t f = 0; f < frameCount; f++) {
+                    double ticks = std::min((double)f / clip.frameRate, (double)clip.duration) * ticksPerSecond;
+                    ChannelPose& pose = clip.frames[f * channelCount + c];
+                    pose = bind;
+                    if (channel->mNumPositionKeys)
+                        pose.translation = glm::vec4(sampleKeys(channel->mPositionKeys, channel->mNumPositionKeys, ticks, positionKey), 0.0f);
+                    if (channel->mNumScalingKeys)
+                        pose.scale = glm::vec4(sampleKeys(channel->mScalingKeys, channel->mNumScalingKeys, ticks, scaleKey), 1.0f);
+                    if (channel->mNumRotationKeys) {
+                        glm::quat q = sampleKeys(channel->mRotationKeys, channel->mNumRotationKeys, ticks, rotationKey);
+                        pose.rotation = glm::vec4(q.x, q.y, q.z, q.w);
+                    }
+                    // Same hemisphere as the previous frame so blending two rows never takes the long way round
+                    if (f > 0 && glm::dot(pose.rotation, clip.frames[(f - 1) * channelCount + c].rotation) < 0.0f)
+                        pose.rotation = -pose.rotation;
+                }
+            });
+
+            cout << "[Model] Clip '" << clip.name << "': " << clip.duration << " s, " << channelCount << " channels, "
+                << frameCount << " frames" << endl;
+            clips.push_back(std::move(clip));
+        }
+    }
+
+    // Interpolated key value at time, cursor only moves forward since frames are sampled in order
+    static glm::vec3 sampleKeys(const aiVectorKey* keys, unsigned int count, double time, unsigned int& cursor) {
+        while (cursor + 1 < count && keys[cursor + 1].mTime <= time)
+            cursor++;
+        const aiVector3D& a = keys[cursor].mValue;
+        if (cursor + 1 >= count || time <= keys[cursor].mTime)
+            return glm::vec3(a.x, a.y, a.z);
+        const aiVector3D& b = keys[cursor + 1].mValue;
+        float t = (float)((time - keys[cursor].mTime) / (keys[cursor + 1].mTime - keys[cursor].mTime));
+        return glm::mix(glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z), t);
+    }
+
+    static glm::quat sampleKeys(const aiQuatKey* keys, unsigned int count, double time, unsigned int& cursor) {
+        while (cursor + 1 < count && keys[cursor + 1].mTime <= time)
+            cursor++;
+        const aiQuaternion& a = keys[cursor].mValue;
+        if (cursor + 1 >= count || time <= keys[cursor].mTime)
+            return glm::quat(a.w, a.x, a.y, a.z);
+        const aiQuaternion& b = keys[cursor + 1].mValue;
+        float t = (float)((time - keys[cursor].mTime) / (keys[cursor + 1].mTime - keys[cursor].mTime));
+        return glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+    }
+
+    // Keeps the 4 strongest influences, renormalized to unorm8 weights that sum to 255
+    static void packWeights(const glm::vec4& weights, int fallback, SkinVertex& skin) {
+        float sum = weights.x + weights.y + weights.z + weights.w;
+        if (sum <= 0.0f) {
+            skin = SkinVertex();
+            skin.Joints[0] = (uint16_t)fallback;
+            skin.Weights[0] = 255;
+            return;
+        }
+        int total = 0, largest = 0;
+        for (int k = 0; k < 4; k++) {
+            skin.Weights[k] = (uint8_t)std::lround(weights[k] / sum * 255.0f);
+            total += skin.Weights[k];
+            if (weights[k] > weights[largest])
+                largest = k;
+        }
+        // Rounding can miss 255 by a little, the largest weight absorbs it
+        skin.Weights[largest] = (uint8_t)(skin.Weights[largest] + 255 - total);
+    }
+
+    // Flattens the node tree parents first into nodes, and its meshes into the order they get drawn in
+    static void collectMeshes(aiNode* node, const aiScene* scene, int parent, vector<const aiMesh*>& order,
+        vector<unsigned int>& orderNodes, vector<NodeData>& nodes) {
         cout << "Processing node: " << node->mName.C_Str() << endl;
 
+        unsigned int flat = (unsigned int)nodes.size();
+        NodeData data;
+        data.name = node->mName.C_Str();
+        data.parent = parent;
+        data.local = toGlm(node->mTransformation);
+        nodes.push_back(data);
+
         // Process all the node's meshes
         for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            order.push_back(scene->mMeshes[node->mMeshes[i]]);
+            orderNodes.push_back(flat);
         }
 
         // Then process children
         for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene);
+            collectMeshes(node->mChildren[i], scene, (int)flat, order, orderNodes, nodes);
         }
     }
 
-    // Convert aiMesh to our Mesh
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene) {
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+    // Convert aiMesh to our MeshData, CPU only so it can run on any thread
+    static MeshData processMesh(const aiMesh* mesh, const aiScene* scene, const MeshJoints& joints) {
+        MeshData data;
+        vector<Vertex>& vertices = data.vertices;
+        vector<unsigned int>& indices = data.indices;
+        vector<Texture>& textures = data.textures;
 
-        cout << "  Mesh - Verts: " << mesh->mNumVertices
-            << " Faces: " << mesh->mNumFaces
-            << " UVs: " << (mesh->HasTextureCoords(0) ? "Yes" : "No")
-            << " Normals: " << (mesh->HasNormals() ? "Yes" : "No")
-            << endl;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // Process vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -112,6 +1354,16 @@ private:
             }
             vertex.Position = vectorPos;
 
+            // Bounds
+            if (i == 0) {
+                data.boundsMin = vectorPos;
+                data.boundsMax = vectorPos;
+            }
+            else {
+                data.boundsMin = glm::min(data.boundsMin, vectorPos);
+                data.boundsMax = glm::max(data.boundsMax, vectorPos);
+            }
+
             // Normals (check existence)
             glm::vec3 normal(0.0f);
             if (mesh->HasNormals() && mesh->mNormals) {
@@ -137,15 +1389,43 @@ private:
 
         // Process indices (faces)
         for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             for (unsigned int j = 0; j < face.mNumIndices; j++) {
                 indices.push_back(face.mIndices[j]);
             }
         }
 
+        // Bone weights, every influence competes for the vertex's 4 slots
+        if (!joints.bones.empty()) {
+            vector<glm::vec4> weights(mesh->mNumVertices, glm::vec4(0.0f));
+            data.skin.assign(mesh->mNumVertices, SkinVertex());
+            for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+                int joint = joints.bones[b];
+                if (joint < 0)
+                    continue;
+                const aiBone* bone = mesh->mBones[b];
+                for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+                    unsigned int v = bone->mWeights[w].mVertexId;
+                    float weight = bone->mWeights[w].mWeight;
+                    if (v >= mesh->mNumVertices)
+                        continue;
+                    int slot = 0;
+                    for (int k = 1; k < 4; k++)
+                        if (weights[v][k] < weights[v][slot])
+                            slot = k;
+                    if (weight > weights[v][slot]) {
+                        weights[v][slot] = weight;
+                        data.skin[v].Joints[slot] = (uint16_t)joint;
+                    }
+                }
+            }
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+                packWeights(weights[v], joints.fallback, data.skin[v]);
+        }
+
         // Process material
         if (mesh->mMaterialIndex < scene->mNumMaterials) {
-            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+            const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
             // Diffuse maps
             vector<Texture> diffuseMaps = loadMaterialTextures(material,
@@ -158,12 +1438,11 @@ private:
             textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         }
 
-        // Return Mesh with only 3 arguments
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    // Load textures for a material with path sanitization
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
+    // Collect texture bindings for a material with path sanitization, ids are resolved later by resolveTextures
+    static vector<Texture> loadMaterialTextures(const aiMaterial* mat, aiTextureType type, string typeName) {
         vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
             aiString str;
@@ -181,77 +1460,41 @@ private:
                 texPath = texPath.substr(pos + 1); // e.g. "Characters.png"
             }
 
-            // Build final path relative to your model directory
-            std::string fullPath = directory + '/' + texPath;
-
-            // Check if already loaded
-            bool skip = false;
-            for (const auto& loaded : textures_loaded) {
-                if (loaded.path == texPath) {
-                    textures.push_back(loaded);
-                    skip = true;
-                    break;
-                }
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = texPath; // store just the filename for comparison
+            textures.push_back(texture);
+        }
+        return textures;
+    }
 
-            if (!skip) {
-                Texture texture;
-                texture.id = TextureFromFile(fullPath.c_str(), directory, false);
-                texture.type = typeName;
-                texture.path = texPath; // store just the filename for comparison
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
+    // Load (or reuse) the GL texture for every binding
+    void resolveTextures(vector<Texture>& textures) {
+        for (Texture& texture : textures) {
+            // Build final path relative to your model directory
+            std::string fullPath = directory + '/' + texture.path;
 
-                std::cout << "[loadMaterialTextures] Loaded: " << fullPath << std::endl;
+            // Check if this model already holds it
+            auto loaded = textures_loaded.find(fullPath);
+            if (loaded != textures_loaded.end()) {
+                texture.id = loaded->second;
+                continue;
             }
+
+            texture.id = TextureFromFile(fullPath.c_str(), directory, false);
+            textures_loaded.emplace(fullPath, texture.id);
         }
-        return textures;
     }
+
+    // Returns a shared texture name right away, the image itself streams in through TextureStreamer
     unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma) {
         std::string filename(path);
 
         // Normalize Windows backslashes to forward slashes
         std::replace(filename.begin(), filename.end(), '\\', '/');
 
-        // Check if path is absolute (Windows drive letter or Unix-style root)
-        bool isAbsolute = (filename.find(':') != std::string::npos) ||
-            (!filename.empty() && filename[0] == '/');
-
-
-        std::cout << "[TextureFromFile] Loading: " << filename << std::endl;
-
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-
-        if (data) {
-            GLenum format = GL_RGB;
-            if (nrComponents == 1) format = GL_RED;
-            else if (nrComponents == 3) format = GL_RGB;
-            else if (nrComponents == 4) format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-
-            std::cout << "[TextureFromFile] OK: " << width << "x" << height
-                << " channels=" << nrComponents << std::endl;
-        }
-        else {
-            std::cerr << "[TextureFromFile] Failed to load: " << filename << std::endl;
-        }
-
-        return textureID;
+        return TextureCache::Instance().Acquire(filename, gamma);
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,380 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "TransformHierarchy.h"
+
+using namespace std;
+
+// On-disk layout of a processed model.
+// Everything after the header is addressed by byte offsets from the start of the file,
+// vertex and index blobs are 64 byte aligned so mapped views can go straight into glBufferData.
+struct ModelCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t nodeCount;
+    uint64_t meshTableOffset;
+    uint64_t textureTableOffset;
+    uint64_t nodeTableOffset;
+    uint64_t stringsOffset;
+    uint64_t vertexDataOffset;
+    uint64_t indexDataOffset;
+    uint64_t fileSize;
+};
+
+// One entry per mesh, offsets are in elements (Vertex / unsigned int) from the blob start
+struct ModelCacheMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t lodCount;
+    uint32_t lodFirstIndex[4];  // relative to the mesh's indexOffset
+    uint32_t lodIndexCount[4];
+    float lodError[4];
+    uint32_t node;
+    float boundsRadius;         // bounding sphere around the AABB center
+};
+
+// Texture binding, both strings live in the string blob
+struct ModelCacheTexture {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// Scene node, parents come before children. The name lives in the string blob
+struct ModelCacheNode {
+    int32_t parent;
+    float local[16];            // column major
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+static_assert(sizeof(ModelCacheHeader) == 88, "ModelCacheHeader layout changed, bump ModelCache::Version");
+static_assert(sizeof(ModelCacheMesh) == 120, "ModelCacheMesh layout changed, bump ModelCache::Version");
+static_assert(sizeof(ModelCacheNode) == 76, "ModelCacheNode layout changed, bump ModelCache::Version");
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed to be cached");
+
+class ModelCache {
+public:
+    // Bump whenever the layout or the processing that produces MeshData changes
+    static const uint32_t Version = 6;
+
+    // Where the cache entry for a source file lives, entries are overwritten when the source changes
+    static string CachePath(const string& sourcePath) {
+        string name = sourcePath;
+        size_t pos = name.find_last_of("/\\");
+        if (pos != string::npos)
+            name = name.substr(pos + 1);
+
+        char pathKey[17];
+        snprintf(pathKey, sizeof(pathKey), "%016llx", (unsigned long long)HashBytes(sourcePath.data(), sourcePath.size()));
+        return "Cache/Models/" + name + "." + pathKey + ".mvcache";
+    }
+
+    // FNV-1a, good enough to detect a changed source file
+    static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Hashes the whole content of a file, returns false if it can't be read
+    static bool HashFile(const string& path, uint64_t& hash) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        hash = HashBytes(file.data(), file.size());
+        return true;
+    }
+
+    // Serializes processed meshes, written to a temp file first so a crash never leaves a torn entry
+    static bool Write(const string& cachePath, uint64_t sourceHash, uint32_t importFlags, const vector<MeshData>& meshes,
+        const vector<NodeData>& nodes) {
+        std::error_code ec;
+        std::filesystem::path target(cachePath);
+        if (target.has_parent_path())
+            std::filesystem::create_directories(target.parent_path(), ec);
+
+        ModelCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "MVMC", 4);
+        header.version = Version;
+        header.sourceHash = sourceHash;
+        header.importFlags = importFlags;
+        header.meshCount = (uint32_t)meshes.size();
+
+        vector<ModelCacheMesh> meshTable;
+        vector<ModelCacheTexture> textureTable;
+        string strings;
+        uint64_t vertexTotal = 0;
+        uint64_t indexTotal = 0;
+
+        for (const MeshData& data : meshes) {
+            ModelCacheMesh entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.vertexOffset = vertexTotal;
+            entry.indexOffset = indexTotal;
+            entry.vertexCount = (uint32_t)data.vertices.size();
+            entry.indexCount = (uint32_t)data.indices.size();
+            entry.firstTexture = (uint32_t)textureTable.size();
+            entry.textureCount = (uint32_t)data.textures.size();
+            for (int k = 0; k < 3; k++) {
+                entry.boundsMin[k] = data.boundsMin[k];
+                entry.boundsMax[k] = data.boundsMax[k];
+            }
+            entry.lodCount = (uint32_t)std::min<size_t>(data.lods.size(), 4);
+            for (uint32_t l = 0; l < entry.lodCount; l++) {
+                entry.lodFirstIndex[l] = data.lods[l].firstIndex;
+                entry.lodIndexCount[l] = data.lods[l].indexCount;
+                entry.lodError[l] = data.lods[l].error;
+            }
+            entry.node = data.node;
+            entry.boundsRadius = data.boundsRadius;
+            meshTable.push_back(entry);
+
+            for (const Texture& texture : data.textures) {
+                ModelCacheTexture t;
+                t.typeOffset = (uint32_t)strings.size();
+                t.typeLength = (uint32_t)texture.type.size();
+                strings += texture.type;
+                t.pathOffset = (uint32_t)strings.size();
+                t.pathLength = (uint32_t)texture.path.size();
+                strings += texture.path;
+                textureTable.push_back(t);
+            }
+
+            vertexTotal += data.vertices.size();
+            indexTotal += data.indices.size();
+        }
+        header.textureCount = (uint32_t)textureTable.size();
+
+        vector<ModelCacheNode> nodeTable;
+        for (const NodeData& node : nodes) {
+            ModelCacheNode entry;
+            entry.parent = node.parent;
+            memcpy(entry.local, &node.local[0][0], sizeof(entry.local));
+            entry.nameOffset = (uint32_t)strings.size();
+            entry.nameLength = (uint32_t)node.name.size();
+            strings += node.name;
+            nodeTable.push_back(entry);
+        }
+        header.nodeCount = (uint32_t)nodeTable.size();
+
+        header.meshTableOffset = sizeof(ModelCacheHeader);
+        header.textureTableOffset = header.meshTableOffset + meshTable.size() * sizeof(ModelCacheMesh);
+        header.nodeTableOffset = header.textureTableOffset + textureTable.size() * sizeof(ModelCacheTexture);
+        header.stringsOffset = header.nodeTableOffset + nodeTable.size() * sizeof(ModelCacheNode);
+        header.vertexDataOffset = AlignUp(header.stringsOffset + strings.size());
+        header.indexDataOffset = AlignUp(header.vertexDataOffset + vertexTotal * sizeof(Vertex));
+        header.fileSize = header.indexDataOffset + indexTotal * sizeof(unsigned int);
+
+        string tempPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "[ModelCache] Cannot write: " << tempPath << std::endl;
+                return false;
+            }
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(meshTable.data()), meshTable.size() * sizeof(ModelCacheMesh));
+            out.write(reinterpret_cast<const char*>(textureTable.data()), textureTable.size() * sizeof(ModelCacheTexture));
+            out.write(reinterpret_cast<const char*>(nodeTable.data()), nodeTable.size() * sizeof(ModelCacheNode));
+            out.write(strings.data(), strings.size());
+            Pad(out, header.vertexDataOffset);
+            for (const MeshData& data : meshes)
+                out.write(reinterpret_cast<const char*>(data.vertices.data()), data.vertices.size() * sizeof(Vertex));
+            Pad(out, header.indexDataOffset);
+            for (const MeshData& data : meshes)
+                out.write(reinterpret_cast<const char*>(data.indices.data()), data.indices.size() * sizeof(unsigned int));
+
+            if (!out.good()) {
+                std::cerr << "[ModelCache] Failed writing: " << tempPath << std::endl;
+                out.close();
+                std::filesystem::remove(tempPath, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, cachePath, ec);
+        if (ec) {
+            std::cerr << "[ModelCache] Cannot replace " << cachePath << ": " << ec.message() << std::endl;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // Maps an entry and checks it matches the source hash, flags and layout version
+    bool Open(const string& cachePath, uint64_t sourceHash, uint32_t importFlags) {
+        header = nullptr;
+        if (!file.open(cachePath))
+            return false;
+
+        if (file.size() < sizeof(ModelCacheHeader)) {
+            file.close();
+            return false;
+        }
+
+        const ModelCacheHeader* h = reinterpret_cast<const ModelCacheHeader*>(file.data());
+        bool valid = memcmp(h->magic, "MVMC", 4) == 0
+            && h->version == Version
+            && h->sourceHash == sourceHash
+            && h->importFlags == importFlags
+            && h->fileSize == file.size()
+            && h->meshTableOffset + (uint64_t)h->meshCount * sizeof(ModelCacheMesh) <= h->textureTableOffset
+            && h->textureTableOffset + (uint64_t)h->textureCount * sizeof(ModelCacheTexture) <= h->nodeTableOffset
+            && h->nodeTableOffset + (uint64_t)h->nodeCount * sizeof(ModelCacheNode) <= h->stringsOffset
+            && h->stringsOffset <= h->vertexDataOffset
+            && h->vertexDataOffset <= h->indexDataOffset
+            && h->indexDataOffset <= h->fileSize;
+        if (!valid) {
+            file.close();
+            return false;
+        }
+        header = h;
+
+        // Make sure no entry points outside of the mapped file
+        uint64_t vertexCapacity = (header->indexDataOffset - header->vertexDataOffset) / sizeof(Vertex);
+        uint64_t indexCapacity = (header->fileSize - header->indexDataOffset) / sizeof(unsigned int);
+        for (uint32_t i = 0; i < header->meshCount; i++) {
+            const ModelCacheMesh& m = mesh(i);
+            if (m.vertexOffset + m.vertexCount > vertexCapacity
+                || m.indexOffset + m.indexCount > indexCapacity
+                || (uint64_t)m.firstTexture + m.textureCount > header->textureCount
+                || m.lodCount > 4
+                || (header->nodeCount > 0 && m.node >= header->nodeCount)) {
+                Close();
+                return false;
+            }
+            for (uint32_t l = 0; l < m.lodCount; l++) {
+                if ((uint64_t)m.lodFirstIndex[l] + m.lodIndexCount[l] > m.indexCount) {
+                    Close();
+                    return false;
+                }
+            }
+        }
+        uint64_t stringsSize = header->vertexDataOffset - header->stringsOffset;
+        for (uint32_t i = 0; i < header->textureCount; i++) {
+            const ModelCacheTexture& t = textureEntry(i);
+            if ((uint64_t)t.typeOffset + t.typeLength > stringsSize || (uint64_t)t.pathOffset + t.pathLength > stringsSize) {
+                Close();
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < header->nodeCount; i++) {
+            const ModelCacheNode& n = nodeEntry(i);
+            if ((uint64_t)n.nameOffset + n.nameLength > stringsSize || n.parent >= (int32_t)i) {
+                Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Close() {
+        header = nullptr;
+        file.close();
+    }
+
+    uint32_t meshCount() const { return header ? header->meshCount : 0; }
+
+    const ModelCacheMesh& mesh(uint32_t i) const {
+        return reinterpret_cast<const ModelCacheMesh*>(file.data() + header->meshTableOffset)[i];
+    }
+
+    const Vertex* vertices(const ModelCacheMesh& m) const {
+        return reinterpret_cast<const Vertex*>(file.data() + header->vertexDataOffset) + m.vertexOffset;
+    }
+
+    const unsigned int* indices(const ModelCacheMesh& m) const {
+        return reinterpret_cast<const unsigned int*>(file.data() + header->indexDataOffset) + m.indexOffset;
+    }
+
+    vector<MeshLod> lods(const ModelCacheMesh& m) const {
+        vector<MeshLod> result(m.lodCount);
+        for (uint32_t l = 0; l < m.lodCount; l++) {
+            result[l].firstIndex = m.lodFirstIndex[l];
+            result[l].indexCount = m.lodIndexCount[l];
+            result[l].error = m.lodError[l];
+        }
+        return result;
+    }
+
+    // Texture bindings of a mesh with unresolved GL ids
+    vector<Texture> textures(const ModelCacheMesh& m) const {
+        vector<Texture> result;
+        const char* strings = reinterpret_cast<const char*>(file.data() + header->stringsOffset);
+        for (uint32_t i = 0; i < m.textureCount; i++) {
+            const ModelCacheTexture& t = textureEntry(m.firstTexture + i);
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(strings + t.typeOffset, t.typeLength);
+            texture.path.assign(strings + t.pathOffset, t.pathLength);
+            result.push_back(texture);
+        }
+        return result;
+    }
+
+    vector<NodeData> nodes() const {
+        vector<NodeData> result;
+        if (!header)
+            return result;
+        result.resize(header->nodeCount);
+        const char* strings = reinterpret_cast<const char*>(file.data() + header->stringsOffset);
+        for (uint32_t i = 0; i < result.size(); i++) {
+            const ModelCacheNode& n = nodeEntry(i);
+            result[i].parent = n.parent;
+            memcpy(&result[i].local[0][0], n.local, sizeof(n.local));
+            result[i].name.assign(strings + n.nameOffset, n.nameLength);
+        }
+        return result;
+    }
+
+private:
+    MappedFile file;
+    const ModelCacheHeader* header = nullptr;
+
+    const ModelCacheTexture& textureEntry(uint32_t i) const {
+        return reinterpret_cast<const ModelCacheTexture*>(file.data() + header->textureTableOffset)[i];
+    }
+
+    // Node entries are 76 bytes and only 4 byte aligned, fine for the float/int members
+    const ModelCacheNode& nodeEntry(uint32_t i) const {
+        return reinterpret_cast<const ModelCacheNode*>(file.data() + header->nodeTableOffset)[i];
+    }
+
+    static uint64_t AlignUp(uint64_t offset) {
+        return (offset + 63) & ~uint64_t(63);
+    }
+
+    static void Pad(std::ofstream& out, uint64_t offset) {
+        static const char zeros[64] = {};
+        uint64_t current = (uint64_t)out.tellp();
+        if (offset > current)
+            out.write(zeros, offset - current);
+    }
+};
@@ -0,0 +1,486 @@
+#pragma once
+#include <glm.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Native Wavefront OBJ/MTL reader that skips Assimp.
+// The file is memory mapped, cut into line aligned chunks and parsed on the worker pool.
+// Output matches the Assimp import used by Model (triangulated, flipped V), one MeshData per
+// object/material pair with deduplicated vertices.
+class ObjLoader {
+public:
+    // Part of the model cache key so native and Assimp imports never share an entry
+    static constexpr unsigned int ImportKey = 0x4F424A31;
+
+    static bool IsObjPath(const string& path) {
+        if (path.size() < 4)
+            return false;
+        string extension = path.substr(path.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return extension == ".obj";
+    }
+
+    static bool Load(const string& path, vector<MeshData>& meshes) {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "[ObjLoader] Cannot open: " << path << std::endl;
+            return false;
+        }
+
+        string directory = ".";
+        size_t slash = path.find_last_of("/\\");
+        if (slash != string::npos)
+            directory = path.substr(0, slash);
+
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        const char* end = begin + file.size();
+        vector<Chunk> chunks = SplitChunks(begin, end);
+        ThreadPool& pool = ThreadPool::Instance();
+
+        // Pass 1: count attributes per chunk so every chunk knows where its data lands
+        pool.ParallelFor(chunks.size(), [&](size_t i) { CountChunk(chunks[i]); });
+
+        size_t positionCount = 0, uvCount = 0, normalCount = 0;
+        for (Chunk& chunk : chunks) {
+            chunk.positionBase = positionCount;
+            chunk.uvBase = uvCount;
+            chunk.normalBase = normalCount;
+            positionCount += chunk.positionCount;
+            uvCount += chunk.uvCount;
+            normalCount += chunk.normalCount;
+        }
+
+        // Pass 2: parse straight into the shared attribute arrays
+        Attributes attributes;
+        attributes.positions.resize(positionCount);
+        attributes.uvs.resize(uvCount);
+        attributes.normals.resize(normalCount);
+        pool.ParallelFor(chunks.size(), [&](size_t i) { ParseChunk(chunks[i], attributes); });
+
+        // Materials
+        unordered_map<string, MtlMaterial> materials;
+        for (const Chunk& chunk : chunks)
+            for (const string& library : chunk.materialLibraries)
+                LoadMtl(directory + "/" + library, materials);
+
+        // Assign triangles to object/material groups in file order
+        vector<Group> groups;
+        unordered_map<string, size_t> groupIndex;
+        string object, material;
+        for (const Chunk& chunk : chunks) {
+            size_t corner = 0;
+            for (const StateChange& change : chunk.changes) {
+                AppendCorners(chunk, corner, change.corner, object, material, groups, groupIndex);
+                corner = change.corner;
+                if (change.isMaterial) material = change.name;
+                else object = change.name;
+            }
+            AppendCorners(chunk, corner, chunk.corners.size(), object, material, groups, groupIndex);
+        }
+
+        // Deduplicate corners into vertices, one group per job
+        meshes.clear();
+        meshes.resize(groups.size());
+        pool.ParallelFor(groups.size(), [&](size_t i) {
+            BuildMesh(groups[i], attributes, materials, meshes[i]);
+        });
+
+        meshes.erase(std::remove_if(meshes.begin(), meshes.end(), [](const MeshData& m) { return m.indices.empty(); }), meshes.end());
+        return true;
+    }
+
+private:
+    // Attribute references of one face corner, resolved to 0 based indices, -1 if absent
+    struct Corner {
+        int position;
+        int uv;
+        int normal;
+    };
+
+    struct StateChange {
+        size_t corner;
+        bool isMaterial;
+        string name;
+    };
+
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        size_t positionCount = 0, uvCount = 0, normalCount = 0;
+        size_t positionBase = 0, uvBase = 0, normalBase = 0;
+        vector<Corner> corners;         // triangulated, 3 per triangle
+        vector<StateChange> changes;    // usemtl / o / g in the order they appear
+        vector<string> materialLibraries;
+    };
+
+    struct Attributes {
+        vector<glm::vec3> positions;
+        vector<glm::vec2> uvs;
+        vector<glm::vec3> normals;
+    };
+
+    // Triangles of one object/material pair, as (chunk, corner range) slices
+    struct Group {
+        string material;
+        vector<pair<const Chunk*, pair<size_t, size_t>>> ranges;
+        size_t cornerCount = 0;
+    };
+
+    struct MtlMaterial {
+        string diffuse;
+        string specular;
+    };
+
+    static vector<Chunk> SplitChunks(const char* begin, const char* end) {
+        const size_t minChunkSize = 256 * 1024;
+        size_t size = (size_t)(end - begin);
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>((ThreadPool::Instance().WorkerCount() + 1) * 4, size / minChunkSize));
+        size_t chunkSize = size / chunkCount + 1;
+
+        vector<Chunk> chunks;
+        const char* p = begin;
+        while (p < end) {
+            const char* chunkEnd = p + std::min(chunkSize, (size_t)(end - p));
+            while (chunkEnd < end && *(chunkEnd - 1) != '\n')
+                chunkEnd++;
+            Chunk chunk;
+            chunk.begin = p;
+            chunk.end = chunkEnd;
+            chunks.push_back(chunk);
+            p = chunkEnd;
+        }
+        return chunks;
+    }
+
+    static const char* SkipSpaces(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        return p;
+    }
+
+    static const char* LineEnd(const char* p, const char* end) {
+        const char* newline = static_cast<const char*>(memchr(p, '\n', (size_t)(end - p)));
+        return newline ? newline : end;
+    }
+
+    static void CountChunk(Chunk& chunk) {
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* lineEnd = LineEnd(p, chunk.end);
+            const char* q = SkipSpaces(p, lineEnd);
+            if (lineEnd - q >= 2 && q[0] == 'v') {
+                if (q[1] == ' ' || q[1] == '\t') chunk.positionCount++;
+                else if (q[1] == 't') chunk.uvCount++;
+                else if (q[1] == 'n') chunk.normalCount++;
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    // Locale independent float parsing, [sign] digits [. digits] [e [sign] digits]
+    static const char* ParseFloat(const char* p, const char* end, float& out) {
+        static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        p = SkipSpaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) { mantissa = mantissa * 10 + (uint64_t)(*p - '0'); digits++; }
+            else exponent++;
+            p++;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (digits < 19) { mantissa = mantissa * 10 + (uint64_t)(*p - '0'); digits++; exponent--; }
+                p++;
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negativeExponent = *p == '-';
+                p++;
+            }
+            int e = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (e < 10000) e = e * 10 + (*p - '0');
+                p++;
+            }
+            exponent += negativeExponent ? -e : e;
+        }
+
+        double value = (double)mantissa;
+        if (exponent != 0) {
+            if (exponent > 0 && exponent <= 22) value *= powers[exponent];
+            else if (exponent < 0 && exponent >= -22) value /= powers[-exponent];
+            else value *= std::pow(10.0, exponent);
+        }
+        out = (float)(negative ? -value : value);
+        return p;
+    }
+
+    static const char* ParseInt(const char* p, const char* end, int& out, bool& found) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+        found = false;
+        long long value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value < 0x7fffffff) value = value * 10 + (*p - '0');
+            found = true;
+            p++;
+        }
+        out = (int)(negative ? -value : value);
+        return p;
+    }
+
+    // OBJ indices are 1 based, negative ones count back from the last element defined so far
+    static int ResolveIndex(int index, size_t definedSoFar) {
+        if (index > 0) return index - 1;
+        if (index < 0) return (int)definedSoFar + index;
+        return -1;
+    }
+
+    static string RestOfLine(const char* p, const char* lineEnd) {
+        p = SkipSpaces(p, lineEnd);
+        const char* e = lineEnd;
+        while (e > p && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t'))
+            e--;
+        return string(p, e);
+    }
+
+    static void ParseChunk(Chunk& chunk, Attributes& attributes) {
+        size_t positions = 0, uvs = 0, normals = 0;
+        vector<Corner> polygon;
+
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* lineEnd = LineEnd(p, chunk.end);
+            const char* q = SkipSpaces(p, lineEnd);
+
+            if (lineEnd - q >= 2 && q[0] == 'v' && (q[1] == ' ' || q[1] == '\t')) {
+                glm::vec3& v = attributes.positions[chunk.positionBase + positions++];
+                q = ParseFloat(q + 1, lineEnd, v.x);
+                q = ParseFloat(q, lineEnd, v.y);
+                ParseFloat(q, lineEnd, v.z);
+            }
+            else if (lineEnd - q >= 2 && q[0] == 'v' && q[1] == 't') {
+                glm::vec2& t = attributes.uvs[chunk.uvBase + uvs++];
+                q = ParseFloat(q + 2, lineEnd, t.x);
+                ParseFloat(q, lineEnd, t.y);
+                // Same as aiProcess_FlipUVs
+                t.y = 1.0f - t.y;
+            }
+            else if (lineEnd - q >= 2 && q[0] == 'v' && q[1] == 'n') {
+                glm::vec3& n = attributes.normals[chunk.normalBase + normals++];
+                q = ParseFloat(q + 2, lineEnd, n.x);
+                q = ParseFloat(q, lineEnd, n.y);
+                ParseFloat(q, lineEnd, n.z);
+            }
+            else if (lineEnd - q >= 2 && q[0] == 'f' && (q[1] == ' ' || q[1] == '\t')) {
+                polygon.clear();
+                q += 1;
+                for (;;) {
+                    q = SkipSpaces(q, lineEnd);
+                    if (q >= lineEnd || *q == '\r' || *q == '#')
+                        break;
+
+                    Corner corner = { -1, -1, -1 };
+                    int value;
+                    bool found;
+                    q = ParseInt(q, lineEnd, value, found);
+                    if (!found)
+                        break;
+                    corner.position = ResolveIndex(value, chunk.positionBase + positions);
+                    if (q < lineEnd && *q == '/') {
+                        q = ParseInt(q + 1, lineEnd, value, found);
+                        if (found) corner.uv = ResolveIndex(value, chunk.uvBase + uvs);
+                        if (q < lineEnd && *q == '/') {
+                            q = ParseInt(q + 1, lineEnd, value, found);
+                            if (found) corner.normal = ResolveIndex(value, chunk.normalBase + normals);
+                        }
+                    }
+                    // Skip anything unexpected up to the next separator
+                    while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r')
+                        q++;
+                    polygon.push_back(corner);
+                }
+
+                // Fan triangulation, same as aiProcess_Triangulate for convex polygons
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+            else if (lineEnd - q > 6 && strncmp(q, "usemtl", 6) == 0 && (q[6] == ' ' || q[6] == '\t')) {
+                chunk.changes.push_back({ chunk.corners.size(), true, RestOfLine(q + 6, lineEnd) });
+            }
+            else if (lineEnd - q >= 2 && (q[0] == 'o' || q[0] == 'g') && (q[1] == ' ' || q[1] == '\t')) {
+                chunk.changes.push_back({ chunk.corners.size(), false, RestOfLine(q + 1, lineEnd) });
+            }
+            else if (lineEnd - q > 6 && strncmp(q, "mtllib", 6) == 0 && (q[6] == ' ' || q[6] == '\t')) {
+                chunk.materialLibraries.push_back(RestOfLine(q + 6, lineEnd));
+            }
+
+            p = lineEnd + 1;
+        }
+    }
+
+    static void AppendCorners(const Chunk& chunk, size_t first, size_t last, const string& object, const string& material,
+        vector<Group>& groups, unordered_map<string, size_t>& groupIndex) {
+        if (last <= first)
+            return;
+        string key = object + '\n' + material;
+        auto found = groupIndex.find(key);
+        if (found == groupIndex.end()) {
+            found = groupIndex.emplace(key, groups.size()).first;
+            groups.push_back(Group());
+            groups.back().material = material;
+        }
+        Group& group = groups[found->second];
+        group.ranges.push_back({ &chunk, { first, last } });
+        group.cornerCount += last - first;
+    }
+
+    struct CornerHash {
+        size_t operator()(const Corner& c) const {
+            uint64_t h = (uint64_t)(uint32_t)c.position * 0x9E3779B185EBCA87ull;
+            h ^= (uint64_t)(uint32_t)c.uv * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+            h ^= (uint64_t)(uint32_t)c.normal * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+
+    struct CornerEqual {
+        bool operator()(const Corner& a, const Corner& b) const {
+            return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+        }
+    };
+
+    static void BuildMesh(const Group& group, const Attributes& attributes, const unordered_map<string, MtlMaterial>& materials, MeshData& data) {
+        unordered_map<Corner, unsigned int, CornerHash, CornerEqual> vertexOf;
+        vertexOf.reserve(group.cornerCount);
+        data.indices.reserve(group.cornerCount);
+
+        bool firstPosition = true;
+        for (const auto& range : group.ranges) {
+            const vector<Corner>& corners = range.first->corners;
+            for (size_t c = range.second.first; c + 2 < range.second.second; c += 3) {
+                // Drop triangles that reference positions that don't exist
+                bool valid = true;
+                for (int k = 0; k < 3; k++) {
+                    int position = corners[c + k].position;
+                    if (position < 0 || position >= (int)attributes.positions.size())
+                        valid = false;
+                }
+                if (!valid)
+                    continue;
+
+                for (int k = 0; k < 3; k++) {
+                    Corner corner = corners[c + k];
+                    if (corner.uv >= (int)attributes.uvs.size()) corner.uv = -1;
+                    if (corner.normal >= (int)attributes.normals.size()) corner.normal = -1;
+
+                    auto inserted = vertexOf.emplace(corner, (unsigned int)data.vertices.size());
+                    if (inserted.second) {
+                        glm::vec3 position = attributes.positions[corner.position];
+                        glm::vec3 normal = corner.normal >= 0 ? attributes.normals[corner.normal] : glm::vec3(0.0f);
+                        glm::vec2 uv = corner.uv >= 0 ? attributes.uvs[corner.uv] : glm::vec2(0.0f);
+                        data.vertices.push_back(Vertex(position, normal, uv));
+
+                        if (firstPosition) {
+                            data.boundsMin = position;
+                            data.boundsMax = position;
+                            firstPosition = false;
+                        }
+                        else {
+                            data.boundsMin = glm::min(data.boundsMin, position);
+                            data.boundsMax = glm::max(data.boundsMax, position);
+                        }
+                    }
+                    data.indices.push_back(inserted.first->second);
+                }
+            }
+        }
+
+        auto material = materials.find(group.material);
+        if (material != materials.end()) {
+            if (!material->second.diffuse.empty())
+                data.textures.push_back(MakeTexture("texture_diffuse", material->second.diffuse));
+            if (!material->second.specular.empty())
+                data.textures.push_back(MakeTexture("texture_specular", material->second.specular));
+        }
+    }
+
+    // Same sanitizing as Model::loadMaterialTextures, only the file name is kept
+    static Texture MakeTexture(const string& type, string path) {
+        std::replace(path.begin(), path.end(), '\\', '/');
+        size_t pos = path.find_last_of('/');
+        if (pos != string::npos)
+            path = path.substr(pos + 1);
+        Texture texture;
+        texture.id = 0;
+        texture.type = type;
+        texture.path = path;
+        return texture;
+    }
+
+    // Texture map statements may carry options (-s 1 1 1 file.png), the file is the last token
+    static string LastToken(const string& value) {
+        size_t end = value.find_last_not_of(" \t\r");
+        if (end == string::npos)
+            return string();
+        size_t start = value.find_last_of(" \t", end);
+        return value.substr(start == string::npos ? 0 : start + 1, end - (start == string::npos ? 0 : start + 1) + 1);
+    }
+
+    static void LoadMtl(const string& path, unordered_map<string, MtlMaterial>& materials) {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "[ObjLoader] Cannot open material library: " << path << std::endl;
+            return;
+        }
+
+        const char* p = reinterpret_cast<const char*>(file.data());
+        const char* end = p + file.size();
+        MtlMaterial* current = nullptr;
+        while (p < end) {
+            const char* lineEnd = LineEnd(p, end);
+            const char* q = SkipSpaces(p, lineEnd);
+            if (lineEnd - q > 6 && strncmp(q, "newmtl", 6) == 0) {
+                current = &materials[RestOfLine(q + 6, lineEnd)];
+            }
+            else if (current && lineEnd - q > 6 && strncmp(q, "map_Kd", 6) == 0) {
+                current->diffuse = LastToken(RestOfLine(q + 6, lineEnd));
+            }
+            else if (current && lineEnd - q > 6 && strncmp(q, "map_Ks", 6) == 0) {
+                current->specular = LastToken(RestOfLine(q + 6, lineEnd));
+            }
+            p = lineEnd + 1;
+        }
+    }
+};
@@ -0,0 +1,184 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OBJECT_BUFFER_SSE 1
+#endif
+
+using namespace std;
+
+// Matrices of one drawn object, ModelVertex.glsl reads them as ObjectBuffer::Texels RGBA32F texels
+struct ObjectData {
+    glm::mat4 mvp;
+    glm::mat4 world;
+    glm::vec4 normal[3];    // columns of the inverse transpose of world's upper 3x3, w unused
+};
+static_assert(sizeof(ObjectData) == 176, "ObjectData is read as 11 texels");
+
+// Per draw and per instance object matrices in a texture buffer. Everything a vertex needs is
+// computed here once per object instead of per vertex: world, viewProj * world and the normal matrix.
+// Objects are collected first and uploaded before the draws, a draw passes the index of its first object
+// as objectBase and instanced draws read objectBase + gl_InstanceID. Streamed by orphaning like SkinPalette.
+// One texture buffer view addresses at most MaxObjects objects, larger sets are uploaded and drawn a range at a time
+class ObjectBuffer {
+public:
+    static constexpr int Texels = (int)(sizeof(ObjectData) / sizeof(glm::vec4));
+
+    ObjectBuffer() {}
+    ~ObjectBuffer() { Delete(); }
+
+    ObjectBuffer(const ObjectBuffer&) = delete;
+    ObjectBuffer& operator=(const ObjectBuffer&) = delete;
+
+    void Clear() { objects.clear(); }
+
+    size_t Count() const { return objects.size(); }
+
+    // Objects one upload can hold, GL_MAX_TEXTURE_BUFFER_SIZE texels (at least 65536, 5957 objects, in GL 3.3)
+    static size_t MaxObjects() {
+        static size_t maxObjects = 0;
+        if (!maxObjects) {
+            GLint texels = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+            maxObjects = (size_t)(texels > 0 ? texels : 65536) / Texels;
+        }
+        return maxObjects;
+    }
+
+    // One object, returns its index
+    int Add(const glm::mat4& viewProj, const glm::mat4& world) {
+        objects.emplace_back();
+        Compute(viewProj, &world, 1, &objects.back());
+        return (int)objects.size() - 1;
+    }
+
+    // count objects, one per world matrix, returns the index of the first. Large batches are spread over the worker pool
+    int AddBatch(const glm::mat4& viewProj, const glm::mat4* worlds, size_t count) {
+        size_t first = objects.size();
+        objects.resize(first + count);
+        ObjectData* out = objects.data() + first;
+        size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+        auto computeChunk = [&](size_t chunk) {
+            size_t begin = chunk * ChunkSize;
+            Compute(viewProj, worlds + begin, std::min(ChunkSize, count - begin), out + begin);
+        };
+        if (chunks > 1) {
+            ThreadPool::Instance().ParallelFor(chunks, computeChunk);
+        }
+        else {
+            for (size_t chunk = 0; chunk < chunks; chunk++)
+                computeChunk(chunk);
+        }
+        return (int)first;
+    }
+
+    void Upload() { Upload(0, objects.size()); }
+
+    // Objects first to first + count, which the shader then reads from index 0. Anything past MaxObjects is dropped
+    void Upload(size_t first, size_t count) {
+        if (count > MaxObjects()) {
+            if (!overflowReported)
+                std::cerr << "[ObjectBuffer] " << count << " objects exceed the texture buffer limit of " << MaxObjects()
+                    << ", the rest are not drawn" << std::endl;
+            overflowReported = true;
+            count = MaxObjects();
+        }
+        if (!buffer) {
+            glGenBuffers(1, &buffer);
+            glGenTextures(1, &texture);
+        }
+        size_t bytes = count * sizeof(ObjectData);
+        bool grown = bytes > capacity;
+        if (grown)
+            capacity = bytes + bytes / 2;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, objects.data() + first);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        if (grown) {
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+    }
+
+    void Bind(unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    void Delete() {
+        if (buffer && glfwGetCurrentContext()) {
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = texture = 0;
+        capacity = 0;
+    }
+
+    // out[i] for worlds[i]. The normal matrix comes from the cross products of the world columns
+    // (cofactors) over the determinant, 4 lanes per column with SSE
+    static void Compute(const glm::mat4& viewProj, const glm::mat4* worlds, size_t count, ObjectData* out) {
+        for (size_t i = 0; i < count; i++) {
+            ObjectData& object = out[i];
+            object.world = worlds[i];
+            TransformHierarchy::Multiply(viewProj, object.world, object.mvp);
+#ifdef OBJECT_BUFFER_SSE
+            __m128 c0 = _mm_loadu_ps(&object.world[0][0]);
+            __m128 c1 = _mm_loadu_ps(&object.world[1][0]);
+            __m128 c2 = _mm_loadu_ps(&object.world[2][0]);
+            __m128 n0 = Cross(c1, c2);
+            __m128 n1 = Cross(c2, c0);
+            __m128 n2 = Cross(c0, c1);
+            // n0.w is 0, so the 4 lane dot is the 3x3 determinant
+            __m128 d = _mm_mul_ps(c0, n0);
+            d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+            d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+            float det = _mm_cvtss_f32(d);
+            __m128 scale = _mm_set1_ps(std::fabs(det) > 1e-30f ? 1.0f / det : 1.0f);
+            _mm_storeu_ps(&object.normal[0][0], _mm_mul_ps(n0, scale));
+            _mm_storeu_ps(&object.normal[1][0], _mm_mul_ps(n1, scale));
+            _mm_storeu_ps(&object.normal[2][0], _mm_mul_ps(n2, scale));
+#else
+            glm::vec3 c0(object.world[0]), c1(object.world[1]), c2(object.world[2]);
+            glm::vec3 n0 = glm::cross(c1, c2), n1 = glm::cross(c2, c0), n2 = glm::cross(c0, c1);
+            float det = glm::dot(c0, n0);
+            float scale = std::fabs(det) > 1e-30f ? 1.0f / det : 1.0f;
+            object.normal[0] = glm::vec4(n0 * scale, 0.0f);
+            object.normal[1] = glm::vec4(n1 * scale, 0.0f);
+            object.normal[2] = glm::vec4(n2 * scale, 0.0f);
+#endif
+        }
+    }
+
+private:
+    // Objects per worker task for AddBatch
+    static constexpr size_t ChunkSize = 256;
+
+    vector<ObjectData> objects;
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    size_t capacity = 0;
+    bool overflowReported = false;
+
+#ifdef OBJECT_BUFFER_SSE
+    // a x b in xyz, w comes out 0
+    static __m128 Cross(__m128 a, __m128 b) {
+        __m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+#endif
+};
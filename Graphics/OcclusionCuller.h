@@ -0,0 +1,300 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "ThreadPool.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_CULLER_SSE 1
+#endif
+
+using namespace std;
+
+// Software hierarchical Z occlusion culling.
+// A few low poly occluders are rasterized into a small depth buffer every frame (horizontal bands on the
+// worker pool, 4 pixels per SSE step), a max depth mip chain is built on top, and bounding boxes are
+// rejected when every texel under their screen rect holds an occluder nearer than the box's nearest point
+class OcclusionCuller {
+public:
+    struct Stats {
+        size_t occluders = 0;           // occluder instances drawn
+        size_t triangles = 0;           // triangles rasterized after clipping
+        float renderMs = 0.0f;          // transform, raster and mip chain
+        size_t tested = 0;              // IsVisible calls since Render
+        size_t occluded = 0;
+    };
+
+    // width is rounded up to a multiple of 4 for the SIMD rows
+    OcclusionCuller(int Width = 256, int Height = 144) {
+        width = (Width + 3) & ~3;
+        height = Height;
+        int w = width, h = height;
+        for (;;) {
+            levelWidths.push_back(w);
+            levelHeights.push_back(h);
+            levels.push_back(vector<float>((size_t)w * h, 1.0f));
+            if (w == 1 && h == 1)
+                break;
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+    }
+
+    // Registers occluder geometry as an object space triangle list, returns its id for AddOccluder
+    int AddOccluderMesh(const vector<glm::vec3>& corners) {
+        occluderMeshes.push_back(corners);
+        return (int)occluderMeshes.size() - 1;
+    }
+
+    // Queues an occluder mesh for the next Render
+    void AddOccluder(int mesh, const glm::mat4& world) {
+        queued.push_back(std::make_pair(mesh, world));
+    }
+
+    void ClearOccluders() { queued.clear(); }
+
+    // Rasterizes the queued occluders seen through viewProjection and rebuilds the mip chain.
+    // Boxes tested afterwards are measured against this frame's buffer
+    void Render(const glm::mat4& ViewProjection) {
+        auto renderStart = std::chrono::high_resolution_clock::now();
+        viewProjection = ViewProjection;
+        stats = Stats();
+        stats.occluders = queued.size();
+
+        // Transform and clip per occluder on the pool
+        vector<vector<ScreenTriangle>> perOccluder(queued.size());
+        ThreadPool::Instance().ParallelFor(queued.size(), [&](size_t i) {
+            setupTriangles(occluderMeshes[queued[i].first], viewProjection * queued[i].second, perOccluder[i]);
+        });
+        triangles.clear();
+        for (const vector<ScreenTriangle>& list : perOccluder)
+            triangles.insert(triangles.end(), list.begin(), list.end());
+        stats.triangles = triangles.size();
+
+        // Each band owns its rows, so threads never write the same pixel
+        vector<float>& depth = levels[0];
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        int bands = std::min(height, (int)ThreadPool::Instance().WorkerCount() * 2 + 2);
+        int bandHeight = (height + bands - 1) / bands;
+        ThreadPool::Instance().ParallelFor((size_t)bands, [&](size_t band) {
+            int rowBegin = (int)band * bandHeight;
+            int rowEnd = std::min(height, rowBegin + bandHeight);
+            for (const ScreenTriangle& triangle : triangles)
+                rasterize(triangle, rowBegin, rowEnd);
+        });
+
+        buildMipChain();
+        stats.renderMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+    }
+
+    // False if the object space box under world is hidden behind this frame's occluders
+    bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& world) const {
+        stats.tested++;
+        glm::mat4 matrix = viewProjection * world;
+
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minDepth = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 p(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z, 1.0f);
+            glm::vec4 clip = matrix * p;
+            // Reaches behind the near plane, can't be proven hidden
+            if (clip.w <= NearW || clip.z < -clip.w)
+                return true;
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+            float y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            minDepth = std::min(minDepth, clip.z * inverseW * 0.5f + 0.5f);
+        }
+        // Off screen boxes are the frustum culler's business
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+            return true;
+
+        int x0 = std::max(0, (int)minX), x1 = std::min(width - 1, (int)maxX);
+        int y0 = std::max(0, (int)minY), y1 = std::min(height - 1, (int)maxY);
+
+        // Coarsest level where the rect still covers at most 2x2 texels
+        int level = 0;
+        while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+            level++;
+
+        const vector<float>& hiz = levels[level];
+        int levelWidth = levelWidths[level];
+        for (int y = y0 >> level; y <= (y1 >> level); y++)
+            for (int x = x0 >> level; x <= (x1 >> level); x++)
+                if (hiz[(size_t)y * levelWidth + x] >= minDepth)
+                    return true;
+
+        stats.occluded++;
+        return false;
+    }
+
+    const Stats& GetStats() const { return stats; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // Depth buffer or one of its max mips, [0, 1] with 1 = nothing drawn
+    const vector<float>& Level(int level) const { return levels[level]; }
+
+private:
+    struct ScreenTriangle {
+        glm::vec3 v[3];     // pixels x/y (origin bottom left) and [0, 1] depth
+    };
+
+    static constexpr float NearW = 1e-5f;
+
+    int width = 0, height = 0;
+    vector<vector<float>> levels;       // 0 = depth buffer, then max depth mips
+    vector<int> levelWidths, levelHeights;
+    vector<vector<glm::vec3>> occluderMeshes;
+    vector<pair<int, glm::mat4>> queued;
+    vector<ScreenTriangle> triangles;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    mutable Stats stats;
+
+    // Clip space to screen, clipping against the near plane (z >= -w) first so w stays positive
+    void setupTriangles(const vector<glm::vec3>& corners, const glm::mat4& matrix, vector<ScreenTriangle>& out) const {
+        for (size_t t = 0; t + 2 < corners.size(); t += 3) {
+            glm::vec4 clip[3];
+            int inside = 0;
+            for (int k = 0; k < 3; k++) {
+                clip[k] = matrix * glm::vec4(corners[t + k], 1.0f);
+                inside += clip[k].z >= -clip[k].w ? 1 : 0;
+            }
+            if (inside == 0)
+                continue;
+
+            glm::vec4 polygon[4];
+            int count = 0;
+            if (inside == 3) {
+                polygon[0] = clip[0]; polygon[1] = clip[1]; polygon[2] = clip[2];
+                count = 3;
+            }
+            else {
+                for (int k = 0; k < 3; k++) {
+                    const glm::vec4& a = clip[k];
+                    const glm::vec4& b = clip[(k + 1) % 3];
+                    float da = a.z + a.w, db = b.z + b.w;
+                    if (da >= 0.0f)
+                        polygon[count++] = a;
+                    if ((da >= 0.0f) != (db >= 0.0f))
+                        polygon[count++] = a + (b - a) * (da / (da - db));
+                }
+            }
+
+            glm::vec3 screen[4];
+            bool valid = true;
+            for (int k = 0; k < count; k++) {
+                if (polygon[k].w <= NearW) {
+                    valid = false;
+                    break;
+                }
+                float inverseW = 1.0f / polygon[k].w;
+                screen[k] = glm::vec3((polygon[k].x * inverseW * 0.5f + 0.5f) * width,
+                    (polygon[k].y * inverseW * 0.5f + 0.5f) * height, polygon[k].z * inverseW * 0.5f + 0.5f);
+            }
+            if (!valid)
+                continue;
+
+            for (int k = 1; k + 1 < count; k++) {
+                ScreenTriangle triangle;
+                triangle.v[0] = screen[0];
+                triangle.v[1] = screen[k];
+                triangle.v[2] = screen[k + 1];
+                glm::vec3 low = glm::min(triangle.v[0], glm::min(triangle.v[1], triangle.v[2]));
+                glm::vec3 high = glm::max(triangle.v[0], glm::max(triangle.v[1], triangle.v[2]));
+                if (high.x < 0.0f || high.y < 0.0f || low.x >= width || low.y >= height)
+                    continue;
+                out.push_back(triangle);
+            }
+        }
+    }
+
+    // Edge functions at pixel centers, keeps the nearest depth. Rows outside [rowBegin, rowEnd) are skipped
+    void rasterize(const ScreenTriangle& triangle, int rowBegin, int rowEnd) {
+        glm::vec3 a = triangle.v[0], b = triangle.v[1], c = triangle.v[2];
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-8f)
+            return;
+        // Occluders are double sided, make the winding counter clockwise
+        if (area < 0.0f) {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        int minY = std::max(rowBegin, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+        int maxY = std::min(rowEnd - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+        if (minY > maxY)
+            return;
+        int minX = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x)))) & ~3;
+        int maxX = std::min(width - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+
+        // E(x, y) = A x + B y + C, positive inside
+        float a0 = b.y - c.y, b0 = c.x - b.x, c0 = b.x * c.y - b.y * c.x;
+        float a1 = c.y - a.y, b1 = a.x - c.x, c1 = c.x * a.y - c.y * a.x;
+        float a2 = a.y - b.y, b2 = b.x - a.x, c2 = a.x * b.y - a.y * b.x;
+        // Depth is affine in screen space: z = z_a * w0 + z_b * w1 + z_c * w2 with w = E / area
+        float inverseArea = 1.0f / area;
+        float zx = (a0 * a.z + a1 * b.z + a2 * c.z) * inverseArea;
+        float zy = (b0 * a.z + b1 * b.z + b2 * c.z) * inverseArea;
+        float zc = (c0 * a.z + c1 * b.z + c2 * c.z) * inverseArea;
+
+        vector<float>& depth = levels[0];
+#ifdef OCCLUSION_CULLER_SSE
+        const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float* row = depth.data() + (size_t)y * width;
+            __m128 rowE0 = _mm_set1_ps(b0 * py + c0), rowE1 = _mm_set1_ps(b1 * py + c1), rowE2 = _mm_set1_ps(b2 * py + c2);
+            __m128 rowZ = _mm_set1_ps(zy * py + zc);
+            for (int x = minX; x <= maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), rowE0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), rowE1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), rowE2);
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), px), rowZ);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+        }
+#else
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float* row = depth.data() + (size_t)y * width;
+            for (int x = minX; x <= maxX && x < width; x++) {
+                float px = x + 0.5f;
+                if (a0 * px + b0 * py + c0 < 0.0f || a1 * px + b1 * py + c1 < 0.0f || a2 * px + b2 * py + c2 < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], zx * px + zy * py + zc);
+            }
+        }
+#endif
+    }
+
+    // Each texel keeps the farthest depth of the 2x2 block below it
+    void buildMipChain() {
+        for (size_t level = 1; level < levels.size(); level++) {
+            const vector<float>& source = levels[level - 1];
+            int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+            vector<float>& target = levels[level];
+            int targetWidth = levelWidths[level], targetHeight = levelHeights[level];
+            for (int y = 0; y < targetHeight; y++) {
+                int y0 = std::min(y * 2, sourceHeight - 1), y1 = std::min(y * 2 + 1, sourceHeight - 1);
+                for (int x = 0; x < targetWidth; x++) {
+                    int x0 = std::min(x * 2, sourceWidth - 1), x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                    target[(size_t)y * targetWidth + x] = std::max(
+                        std::max(source[(size_t)y0 * sourceWidth + x0], source[(size_t)y0 * sourceWidth + x1]),
+                        std::max(source[(size_t)y1 * sourceWidth + x0], source[(size_t)y1 * sourceWidth + x1]));
+                }
+            }
+        }
+    }
+};
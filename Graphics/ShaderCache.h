@@ -0,0 +1,197 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+#include <initializer_list>
+#include "MappedFile.h"
+
+using namespace std;
+
+// Linked program binaries under Cache/Shaders, read back with glProgramBinary so warm startups skip compiling and
+// linking. Entries are keyed by a hash of the shader sources, the link state and the driver (vendor, renderer and
+// version strings), a driver update changes the key and the entry is rebuilt. The driver may still reject a binary
+// it wrote, ShaderProgram then compiles from source and stores over the entry. Only used on the GL thread
+class ShaderCache {
+public:
+    // Bump whenever the file layout changes
+    static constexpr uint32_t Version = 1;
+
+    static ShaderCache& Instance() {
+        static ShaderCache cache;
+        return cache;
+    }
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Program binaries need GL 4.1 or ARB_get_program_binary and at least one binary format from the driver
+    bool Available() {
+        if (!checked) {
+            checked = true;
+            GLint formats = 0;
+            if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            available = formats > 0;
+            if (!available)
+                std::cout << "[ShaderCache] Program binaries not supported, shaders compile from source" << std::endl;
+        }
+        return available;
+    }
+
+    // Key of a program built from these sources. linkState covers whatever else goes into the link
+    // (bound attribute and fragment output locations)
+    uint64_t Key(std::initializer_list<const string*> sources, const string& linkState) const {
+        uint64_t key = HashBytes(&Version, sizeof(Version));
+        for (const string* source : sources) {
+            uint64_t size = source->size();
+            key = HashBytes(&size, sizeof(size), key);
+            key = HashBytes(source->data(), source->size(), key);
+        }
+        key = HashBytes(linkState.data(), linkState.size(), key);
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char* value = reinterpret_cast<const char*>(glGetString(name));
+            if (value)
+                key = HashBytes(value, strlen(value), key);
+        }
+        return key;
+    }
+
+    // Linked program from the entry for name if it was stored with this key, 0 when there is none or the driver
+    // rejects it
+    GLuint Load(const string& name, uint64_t key) {
+        if (!Available())
+            return 0;
+        MappedFile mapped;
+        if (!mapped.open(Directory + FileName(name)))
+            return 0;
+        if (mapped.size() < sizeof(Header))
+            return 0;
+        Header header;
+        memcpy(&header, mapped.data(), sizeof(Header));
+        if (memcmp(header.magic, Magic, sizeof(header.magic)) != 0 || header.version != Version || header.key != key
+            || header.size != mapped.size() - sizeof(Header))
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, (GLenum)header.format, mapped.data() + sizeof(Header), (GLsizei)header.size);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            std::cout << "[ShaderCache] Binary for " << name << " rejected by the driver, recompiling" << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // Writes the binary of a linked program, which should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+    // A failed write only costs the next startup a compile
+    bool Store(const string& name, uint64_t key, GLuint program) {
+        if (!Available())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        vector<unsigned char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        Header header;
+        memcpy(header.magic, Magic, sizeof(header.magic));
+        header.version = Version;
+        header.format = format;
+        header.key = key;
+        header.size = (uint64_t)written;
+
+        string file = FileName(name);
+        std::error_code ec;
+        std::filesystem::create_directories(Directory, ec);
+        string tempPath = Directory + file + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "[ShaderCache] Cannot write: " << tempPath << std::endl;
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(binary.data()), written);
+            if (!out.good()) {
+                std::cerr << "[ShaderCache] Failed writing: " << tempPath << std::endl;
+                out.close();
+                std::filesystem::remove(tempPath, ec);
+                return false;
+            }
+        }
+        std::filesystem::rename(tempPath, Directory + file, ec);
+        if (ec) {
+            std::cerr << "[ShaderCache] Cannot replace " << file << ": " << ec.message() << std::endl;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr const char* Directory = "Cache/Shaders/";
+    static constexpr char Magic[4] = { 'M', 'V', 'P', 'B' };
+
+    // Followed by size bytes of binary in the driver's format
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t pad;
+        uint64_t key;
+        uint64_t size;
+    };
+    static_assert(sizeof(Header) == 32, "Header is written as is");
+
+    bool checked = false;
+    bool available = false;
+
+    ShaderCache() {}
+
+    // FNV-1a like ModelCache::HashBytes, which can't be included from the shader headers
+    static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Last path component of each '+' separated shader made file name safe plus a hash of the whole name,
+    // like DdsCache::FileName
+    static string FileName(const string& name) {
+        string file;
+        size_t partStart = 0;
+        for (char c : name) {
+            if (c == '/' || c == '\\')
+                file.resize(partStart);
+            else if (c == '+') {
+                file += c;
+                partStart = file.size();
+            }
+            else
+                file += strchr(" :*?\"<>|#", c) ? '_' : c;
+        }
+
+        char nameKey[17];
+        snprintf(nameKey, sizeof(nameKey), "%016llx", (unsigned long long)HashBytes(name.data(), name.size()));
+        return file + "." + nameKey + ".bin";
+    }
+};
@@ -19,16 +19,27 @@ public:
 		type = _type;
 	}
 	GLuint compileShader() {
+		std::string codeStr;
+		if (!readSource(codeStr))
+			return 0;
+		return compileShader(codeStr);
+	}
+	//Reads the shader file into code
+	bool readSource(std::string& code) {
 		//Open File
 		std::ifstream file(filePath);
 		if (!file.is_open()) {
 			std::cerr << "ERROR: Cannot open shader file: " << filePath << std::endl;
-			return 0;
+			return false;
 		}
 		//Read file
 		std::stringstream ss;
 		ss << file.rdbuf();
-		std::string codeStr = ss.str();
+		code = ss.str();
+		return true;
+	}
+	//Compiles source already read with readSource
+	GLuint compileShader(const std::string& codeStr) {
 		const char* code = codeStr.c_str();
 		// Create and compile shader
 		GLuint shader = glCreateShader(type);
@@ -9,7 +9,12 @@
 #include <sstream>
 #include <glm.hpp>
 #include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
 #include "ShaderObj.h"
+#include "ShaderCache.h"
 // DO NOT include "Mesh.h" here - creates circular dependency!
 
 using namespace std;
@@ -34,12 +39,49 @@ struct AttributePointerData {
 	}
 };
 
+//Uniform name as its FNV-1a hash, which is all a lookup needs. Hashed at compile time when it's a constexpr,
+//e.g. static constexpr UniformName ModelUniform = "model";
+struct UniformName {
+	uint32_t hash;
+
+	constexpr UniformName(const char* name) : hash(Hash(name)) {}
+	UniformName(const std::string& name) : hash(Hash(name.c_str())) {}
+	explicit constexpr UniformName(uint32_t nameHash) : hash(nameHash) {}
+
+	//Continues from hash, so a name can be hashed in pieces without building the string
+	static constexpr uint32_t Hash(const char* name, uint32_t hash = 2166136261u) {
+		while (*name) {
+			hash ^= (unsigned char)*name++;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+};
+
+//Index of a uniform in a program's reflection table, only valid for the program that returned it
+struct UniformHandle {
+	int slot = -1;
+
+	bool Valid() const { return slot >= 0; }
+};
+
 class ShaderProgram
 {
 public:
 	unsigned int ID;
 	vector<AttributePointerData> attributePointerDatas;
 
+	//Active uniform found at link time, with the last value set through this program
+	struct UniformSlot {
+		string name;
+		uint32_t hash = 0;
+		GLint location = -1;
+		GLenum type = 0;
+		GLint size = 0;
+		bool shadowed = false;
+		unsigned char shadow[sizeof(glm::mat4)];
+	};
+
 	//Adds attribute pointer so buffer knows how to use our shader in memory
 	void AddAttributePointer(int size, GLenum type, GLboolean normalized, GLsizei stride, const std::string& name, const void* offset) {
 		attributePointerDatas.push_back(AttributePointerData(size, type, normalized, stride, name, offset));
@@ -58,17 +100,43 @@ public:
 		}
 	}
 
+	//Fragment output bound before linking, part of the cache key
+	static constexpr const char* FragmentOutput = "outColor";
+
 	ShaderProgram(VertexShader& vertexShader, FragmentShader& fragmentShader)
 	{
+		auto start = std::chrono::high_resolution_clock::now();
+		string vertexSource, fragmentSource;
+		bool read = vertexShader.readSource(vertexSource);
+		read = fragmentShader.readSource(fragmentSource) && read;
+
+		//Warm start: the linked binary from ShaderCache, no shader objects are made
+		ShaderCache& cache = ShaderCache::Instance();
+		string cacheName = vertexShader.filePath + "+" + fragmentShader.filePath;
+		uint64_t cacheKey = cache.Key({ &vertexSource, &fragmentSource }, string("frag 0 ") + FragmentOutput);
+		ID = read ? cache.Load(cacheName, cacheKey) : 0;
+		if (ID) {
+			vertexShader.id = 0;
+			fragmentShader.id = 0;
+			ReflectUniforms();
+			//Block bindings aren't part of the binary
+			BindUniformBlocks();
+			std::cout << "[ShaderProgram] Loaded " << cacheName << " from cache in "
+				<< std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+			return;
+		}
+
 		// Compiles both shaders and sets their GLuint ids
-		vertexShader.id = vertexShader.compileShader();
-		fragmentShader.id = fragmentShader.compileShader();
+		vertexShader.id = read ? vertexShader.compileShader(vertexSource) : 0;
+		fragmentShader.id = read ? fragmentShader.compileShader(fragmentSource) : 0;
 
 		// Create shader program
 		ID = glCreateProgram();
+		if (cache.Available())
+			glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glAttachShader(ID, vertexShader.id);
 		glAttachShader(ID, fragmentShader.id);
-		glBindFragDataLocation(ID, 0, "outColor");
+		glBindFragDataLocation(ID, 0, FragmentOutput);
 		glLinkProgram(ID);
 
 		//Check if linking worked
@@ -79,11 +147,102 @@ public:
 			glGetProgramInfoLog(ID, 512, NULL, infoLog);
 			std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		else {
+			ReflectUniforms();
+			BindUniformBlocks();
+			float compileMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			std::cout << "[ShaderProgram] Compiled and linked " << cacheName << " in " << compileMs << " ms" << std::endl;
+			cache.Store(cacheName, cacheKey, ID);
+		}
 	}
 
 	ShaderProgram() {
 	}
 
+	//Binding point of the FrameData block (FrameUniforms) shared by every program
+	static constexpr GLuint FrameBlockBinding = 0;
+
+	//GLSL 330 has no layout(binding), so the shared blocks are pointed at their binding points after every link.
+	//Programs that don't use a block skip it
+	void BindUniformBlocks() {
+		GLuint frameBlock = glGetUniformBlockIndex(ID, "FrameData");
+		if (frameBlock != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, frameBlock, FrameBlockBinding);
+	}
+
+	//Enumerates the active uniforms into the hashed table the setters look names up in.
+	//Called after every link, it also forgets the shadowed values
+	void ReflectUniforms() {
+		uniforms.clear();
+		uniformTable.clear();
+
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		vector<char> buffer(std::max(maxLength, 1));
+		for (GLint i = 0; i < count; i++) {
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), nullptr, &size, &type, buffer.data());
+			string name = buffer.data();
+			GLint location = glGetUniformLocation(ID, name.c_str());
+			//Members of uniform blocks have no location
+			if (location < 0)
+				continue;
+
+			//Arrays are reported as "name[0]", reachable as "name" and by every element
+			size_t bracket = name.rfind("[0]");
+			if (bracket != string::npos && bracket + 3 == name.size()) {
+				string base = name.substr(0, bracket);
+				addUniform(base, location, type, size);
+				for (GLint element = 1; element < size; element++) {
+					string elementName = base + "[" + std::to_string(element) + "]";
+					addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()), type, 1);
+				}
+			}
+			else {
+				addUniform(name, location, type, size);
+			}
+		}
+
+		size_t tableSize = 8;
+		while (tableSize < uniforms.size() * 2)
+			tableSize *= 2;
+		uniformTable.assign(tableSize, -1);
+		for (size_t slot = 0; slot < uniforms.size(); slot++) {
+			size_t mask = tableSize - 1;
+			size_t i = uniforms[slot].hash & mask;
+			bool collision = false;
+			while (uniformTable[i] >= 0) {
+				collision |= uniforms[uniformTable[i]].hash == uniforms[slot].hash;
+				i = (i + 1) & mask;
+			}
+			if (collision) {
+				std::cerr << "Warning: uniform '" << uniforms[slot].name << "' hashes like another uniform in program " << ID << std::endl;
+				continue;
+			}
+			uniformTable[i] = (int)slot;
+		}
+	}
+
+	//Handle for a uniform, invalid if the program has no active uniform by that name. Setting through an invalid
+	//handle does nothing, like location -1
+	UniformHandle Uniform(UniformName name) const {
+		UniformHandle handle;
+		if (uniformTable.empty())
+			return handle;
+		size_t mask = uniformTable.size() - 1;
+		for (size_t i = name.hash & mask; uniformTable[i] >= 0; i = (i + 1) & mask) {
+			if (uniforms[uniformTable[i]].hash == name.hash) {
+				handle.slot = uniformTable[i];
+				break;
+			}
+		}
+		return handle;
+	}
+
+	const vector<UniformSlot>& Uniforms() const { return uniforms; }
+
 	//Set ShaderProgram as current glfw shader
 	void use() {
 		glUseProgram(ID);
@@ -92,40 +251,106 @@ public:
 	//Disposes program
 	void Delete() {
 		glDeleteProgram(ID);
+		uniforms.clear();
+		uniformTable.clear();
 	}
 
+	//Setters work on the program in use and skip the GL call when the value is the one last set through it,
+	//so uniforms must only be written through these
+
 	//Sets bool uniform with name and value
-	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	void setBool(UniformHandle uniform, bool value) const {
+		setInt(uniform, (int)value);
+	}
+	void setBool(UniformName name, bool value) const {
+		setInt(Uniform(name), (int)value);
 	}
 
 	//Sets int uniform with name and value
-	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	void setInt(UniformHandle uniform, int value) const {
+		if (const UniformSlot* slot = changed(uniform, &value, sizeof(value)))
+			glUniform1i(slot->location, value);
+	}
+	void setInt(UniformName name, int value) const {
+		setInt(Uniform(name), value);
 	}
 
 	//Sets float uniform with name and value
-	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	void setFloat(UniformHandle uniform, float value) const {
+		if (const UniformSlot* slot = changed(uniform, &value, sizeof(value)))
+			glUniform1f(slot->location, value);
+	}
+	void setFloat(UniformName name, float value) const {
+		setFloat(Uniform(name), value);
+	}
+
+	//Sets Matrix 3 uniform with name and value
+	void setMat3(UniformHandle uniform, const glm::mat3& mat) const {
+		if (const UniformSlot* slot = changed(uniform, glm::value_ptr(mat), sizeof(mat)))
+			glUniformMatrix3fv(slot->location, 1, GL_FALSE, glm::value_ptr(mat));
+	}
+	void setMat3(UniformName name, const glm::mat3& mat) const {
+		setMat3(Uniform(name), mat);
 	}
 
 	//Sets Matrix 4 uniform with name and value
-	void setMat4(const std::string& name, const glm::mat4& mat) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+	void setMat4(UniformHandle uniform, const glm::mat4& mat) const {
+		if (const UniformSlot* slot = changed(uniform, glm::value_ptr(mat), sizeof(mat)))
+			glUniformMatrix4fv(slot->location, 1, GL_FALSE, glm::value_ptr(mat));
+	}
+	void setMat4(UniformName name, const glm::mat4& mat) const {
+		setMat4(Uniform(name), mat);
 	}
 
 	//Sets Vec3 uniform with name and values
-	void setVec3(const std::string& name, float x, float y, float z) const {
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	void setVec3(UniformName name, float x, float y, float z) const {
+		setVec3(Uniform(name), glm::vec3(x, y, z));
 	}
 
 	//Sets Vec3 uniform with name and vec3
-	void setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	void setVec3(UniformHandle uniform, const glm::vec3& value) const {
+		if (const UniformSlot* slot = changed(uniform, glm::value_ptr(value), sizeof(value)))
+			glUniform3fv(slot->location, 1, glm::value_ptr(value));
 	}
-	//Sets Vec3 uniform with name and vec3
-	void setVec4(const std::string& name, const glm::vec4& value) const {
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	void setVec3(UniformName name, const glm::vec3& value) const {
+		setVec3(Uniform(name), value);
+	}
+	//Sets Vec4 uniform with name and vec4
+	void setVec4(UniformHandle uniform, const glm::vec4& value) const {
+		if (const UniformSlot* slot = changed(uniform, glm::value_ptr(value), sizeof(value)))
+			glUniform4fv(slot->location, 1, glm::value_ptr(value));
+	}
+	void setVec4(UniformName name, const glm::vec4& value) const {
+		setVec4(Uniform(name), value);
+	}
+
+private:
+	//Shadows are mutable so the setters stay const like glUniform
+	mutable vector<UniformSlot> uniforms;
+	vector<int> uniformTable;	//open addressing by name hash, -1 is empty
+
+	void addUniform(const string& name, GLint location, GLenum type, GLint size) {
+		if (location < 0)
+			return;
+		UniformSlot slot;
+		slot.name = name;
+		slot.hash = UniformName::Hash(name.c_str());
+		slot.location = location;
+		slot.type = type;
+		slot.size = size;
+		uniforms.push_back(slot);
+	}
+
+	//The slot to upload to when value differs from its shadow, which is updated. Null when there is nothing to do
+	const UniformSlot* changed(UniformHandle uniform, const void* value, size_t bytes) const {
+		if (uniform.slot < 0 || uniform.slot >= (int)uniforms.size())
+			return nullptr;
+		UniformSlot& slot = uniforms[uniform.slot];
+		if (slot.shadowed && memcmp(slot.shadow, value, bytes) == 0)
+			return nullptr;
+		memcpy(slot.shadow, value, bytes);
+		slot.shadowed = true;
+		return &slot;
 	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Joint matrices of every animated character in a texture buffer, ModelVertex.glsl reads a matrix as 4 RGBA32F texels.
+// A texture buffer instead of a uniform block so thousands of instanced characters fit in one palette.
+// Streamed every frame by orphaning the buffer like InstanceBuffer
+class SkinPalette {
+public:
+    SkinPalette() {}
+    ~SkinPalette() { Delete(); }
+
+    SkinPalette(const SkinPalette&) = delete;
+    SkinPalette& operator=(const SkinPalette&) = delete;
+
+    void Upload(const vector<glm::mat4>& matrices) {
+        if (!buffer) {
+            glGenBuffers(1, &buffer);
+            glGenTextures(1, &texture);
+        }
+        size_t bytes = matrices.size() * sizeof(glm::mat4);
+        bool grown = bytes > capacity;
+        if (grown)
+            capacity = bytes + bytes / 2;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, matrices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        if (grown) {
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        matrixCount = matrices.size();
+    }
+
+    void Bind(unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    size_t MatrixCount() const { return matrixCount; }
+
+    void Delete() {
+        if (buffer && glfwGetCurrentContext()) {
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = texture = 0;
+        capacity = 0;
+        matrixCount = 0;
+    }
+
+private:
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    size_t capacity = 0;
+    size_t matrixCount = 0;
+};
@@ -33,9 +33,18 @@
 //Sean Made Headers
 #include "ShaderObj.h"
 #include "ShaderProgram.h"
+#include "FrameUniforms.h"
 #include "Camera.h"
 #include "Mesh.h"
 #include "Model.h"
+#include "TextureStreamer.h"
+#include "Benchmarks.h"
+#include "TextureArray.h"
+#include "InstanceBuffer.h"
+#include "InstanceBvh.h"
+#include "OcclusionCuller.h"
+#include "Animation.h"
+#include "SkinPalette.h"
 #include "Sphere.h"
 using namespace std;
 #pragma region Funcs
@@ -104,6 +113,17 @@ string modelPath() {
             return "Assets/Models/Player/Model.fbx";
         }
 }
+//Ask which vertex layout the model gets uploaded with
+VertexFormat vertexFormatChoice() {
+    char answer = 'n';
+    cout << "Use compact (quantized) vertices? y/n" << endl;
+    while (!(cin >> answer) || (answer != 'y' && answer != 'n')) {
+        cout << "Invalid input. Please enter y or n: ";
+        cin.clear();
+        cin.ignore(INT_MAX, '\n');
+    }
+    return answer == 'y' ? VertexFormat::Compact : VertexFormat::Standard;
+}
 void PrintHelp() {
     cout << "Sean's 3D Model Viewer Command List!" << endl;
     cout << "    Scaling: To scale model type 'scale' " << endl;
@@ -113,11 +133,22 @@ void PrintHelp() {
     cout << "    Ambient Lighting: To change the ambient lighting intenstity type 'alight' " << endl;
     cout << "    Move Light: To move point light: 'movel' " << endl;
     cout << "    Clearing: To clear screen type 'cls' " << endl;
+    cout << "    Benchmark: To time the native OBJ reader against Assimp type 'benchobj' " << endl;
+    cout << "    Merged Draw: To toggle one multi-draw per material type 'merge' " << endl;
+    cout << "    Skins: To switch the model texture to another skin type 'skin' " << endl;
+    cout << "    Instances: To draw a grid of copies of the model type 'instances' " << endl;
+    cout << "    Culling: To toggle frustum culling and show what was culled type 'cull' " << endl;
+    cout << "    Picking: To find the triangle in the middle of the screen type 'pick' " << endl;
+    cout << "    Occlusion: To toggle occlusion culling of instances and show what it hid type 'occlusion' " << endl;
+    cout << "    Animation: To play another clip of a rigged model type 'animate' " << endl;
+    cout << "    Benchmark: To time posing many animated characters type 'benchskin' " << endl;
+    cout << "    Benchmark: To time BC1/BC3 texture compression type 'benchdxt' " << endl;
 }
 #pragma endregion Vertices
 int main() {
     // --- Selecting Model ---
     string path = modelPath();
+    VertexFormat vertexFormat = vertexFormatChoice();
 
     // --- GLFW Initialization ---
     if (!glfwInit()) { cerr << "Failed to initialize GLFW\n"; return -1; }
@@ -160,6 +191,11 @@ int main() {
 
     VertexShader lightVert("Assets/GLSLs/LightVertex.glsl", GL_VERTEX_SHADER); FragmentShader lightFrag("Assets/GLSLs/LightFragment.glsl", GL_FRAGMENT_SHADER);
     ShaderProgram lightShader(lightVert, lightFrag);
+
+    // --- Per frame camera/light block every program reads ---
+    FrameUniforms frameUniforms;
+    FrameData frameData;
+
     // --- Quad Mesh for Post Processing ---
     Mesh quadMesh = Mesh(quadVertices, 4, 4, quadIndices, 6);
     screenShader.use();
@@ -182,7 +218,6 @@ int main() {
     gridShader.use();
     glm::mat4 proj = glm::perspective(glm::radians(45.0f), 1920.0f / 1080, 0.1f, 20000.0f);
     //Set up Grid Mesh shader values
-    gridShader.setMat4("projection", proj);
     gridShader.setFloat("cellSize", 1.0f);           // each grid cell 1 unit wide
     gridShader.setFloat("lineWidth", 0.01f);         // vary between 0.002 - 0.02 for sharpness
     gridShader.setFloat("fadeDistance", 500.0f);     // fade out after 500 units
@@ -193,7 +228,42 @@ int main() {
     // --- Loading Test Model ---
     cout << "Loading Model From: " << path;
     modelShader.use();
-    Model testModel(path);
+    // Picking and the occlusion demo read the model on the CPU, nothing else is kept after upload
+    Model testModel(path, vertexFormat, KeepPicking | KeepOccluders);
+
+    // --- Skins: same sized images next to the model packed into one texture array ---
+    TextureArray skins;
+    vector<string> skinPaths;
+    std::error_code skinError;
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(path).parent_path(), skinError)) {
+        if (entry.path().extension() == ".png")
+            skinPaths.push_back(entry.path().generic_string());
+    }
+    std::sort(skinPaths.begin(), skinPaths.end());
+    if (skinPaths.size() > 1 && skins.Build(skinPaths))
+        testModel.SetTextureArray(&skins);
+
+    // --- Instances: copies of the test model, drawn instead of the single model when not empty ---
+    InstanceBuffer copies;
+    InstanceBvh copyTree;
+
+    // --- Occlusion: the copies nearest the camera are rasterized as occluders for the rest ---
+    OcclusionCuller occlusion;
+    bool occlusionCulling = false;
+    vector<glm::vec3> occluderTriangles;
+    testModel.GetOccluderTriangles(occluderTriangles);
+    int occluderMesh = occlusion.AddOccluderMesh(occluderTriangles);
+    const size_t occluderCount = 8;
+    vector<size_t> nearestCopies;
+
+    // --- Animation: one character per copy (or just the model), joints are streamed to the palette every frame ---
+    Animator animator;
+    SkinPalette palette;
+    int clipChoice = 0;
+    if (testModel.IsSkinned()) {
+        animator.Reset(testModel.getSkeleton(), testModel.getHierarchy(), testModel.getClips());
+        animator.Add(clipChoice);
+    }
 
     // --- Light Sphere ---
     lightShader.use();
@@ -222,10 +292,6 @@ int main() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     screenShader.setInt("texFramebuffer;", texColorBuffer);
 
-    // --- Projection ---
-    sceneShader.use(); sceneShader.setMat4("proj", proj);
-    gridShader.use(); gridShader.setMat4("projection", proj);
-
     int curSelector = 0;
 
     auto startTime = std::chrono::high_resolution_clock::now();
@@ -319,6 +385,140 @@ int main() {
                 else if (input == "cls") {
                     system("cls");
                 }
+                else if (input == "benchobj") {
+                    Benchmarks::ObjImport(path);
+                }
+                else if (input == "skin") {
+                    if (skins.LayerCount() == 0) {
+                        cout << "No skins for this model" << endl;
+                    }
+                    else {
+                        for (int i = 0; i < skins.LayerCount(); i++)
+                            cout << "    " << i << ": " << skins.LayerPath(i) << endl;
+                        cout << "Enter Skin (-1 for the original textures): ";
+                        int skin;
+                        while (!(cin >> skin) || skin < -1 || skin >= skins.LayerCount()) {
+                            cout << "ENTER A LISTED SKIN: " << endl;
+                            cin.clear();
+                            cin.ignore(INT_MAX, '\n');
+                        }
+                        testModel.SetLayer(skin);
+                        cout << "Skin: " << (skin >= 0 ? skins.LayerPath(skin) : "original") << endl;
+                    }
+                }
+                else if (input == "merge") {
+                    testModel.SetMergedDraw(!testModel.IsMergedDraw());
+                    cout << "Merged draw " << (testModel.IsMergedDraw() ? "on" : "off") << ", draw calls last frame: "
+                        << testModel.getDrawCallCount() << endl;
+                }
+                else if (input == "instances") {
+                    cout << "Enter Instance Count (0 to draw the single model): ";
+                    int count;
+                    while (!(cin >> count) || count < 0) {
+                        cout << "ENTER A POSITIVE WHOLE NUMBER: " << endl;
+                        cin.clear();
+                        cin.ignore(INT_MAX, '\n');
+                    }
+                    cout << "Enter Spacing: ";
+                    float spacing;
+                    while (!(cin >> spacing)) {
+                        cout << "ENTER FLOAT VALUE: " << endl;
+                        cin.clear();
+                        cin.ignore(INT_MAX, '\n');
+                    }
+
+                    // Square grid around the origin, every copy gets the current scale/rotation and cycles through the skins
+                    copies.Clear();
+                    int side = (int)std::ceil(std::sqrt((float)count));
+                    glm::mat4 copyModel = glm::rotate(glm::scale(glm::mat4(1.0f), glm::vec3(scalingValue)), glm::radians(angleValue), rotationVector);
+                    for (int i = 0; i < count; i++) {
+                        glm::vec3 offset((i % side - (side - 1) * 0.5f) * spacing, 0.0f, (i / side - (side - 1) * 0.5f) * spacing);
+                        copies.Add(glm::translate(glm::mat4(1.0f), offset) * copyModel, skins.LayerCount() > 0 ? i % skins.LayerCount() : -1, i);
+                    }
+                    copyTree.Build(testModel, copies);
+                    // Every copy poses on its own, spread over the clip
+                    if (testModel.IsSkinned()) {
+                        animator.Clear();
+                        for (int i = 0; i < std::max(count, 1); i++)
+                            animator.Add(clipChoice, i * 0.37f);
+                    }
+                    cout << "Drawing " << copies.Count() << " instances" << endl;
+                }
+                else if (input == "cull") {
+                    const CullStats& stats = testModel.getCullStats();
+                    cout << "Last frame: meshes culled " << stats.meshesCulled << "/" << stats.meshesTested
+                        << ", instances culled " << stats.instancesCulled << "/" << stats.instancesTested
+                        << ", draw calls " << testModel.getDrawCallCount() << endl;
+                    testModel.SetFrustumCulling(!testModel.IsFrustumCulling());
+                    cout << "Frustum culling " << (testModel.IsFrustumCulling() ? "on" : "off") << endl;
+                }
+                else if (input == "occlusion") {
+                    const OcclusionCuller::Stats& occlusionStats = occlusion.GetStats();
+                    const CullStats& stats = testModel.getCullStats();
+                    cout << "Last frame: " << occlusionStats.occluders << " occluders, " << occlusionStats.triangles << " triangles rasterized in "
+                        << occlusionStats.renderMs << " ms, instances occluded " << stats.instancesOccluded << "/" << stats.instancesTested
+                        << ", meshes occluded " << stats.meshesOccluded << ", tests took " << stats.occlusionMs << " ms" << endl;
+                    occlusionCulling = !occlusionCulling;
+                    cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << endl;
+                }
+                else if (input == "animate") {
+                    const vector<AnimationClip>& clips = testModel.getClips();
+                    if (clips.empty()) {
+                        cout << "Model has no animations!" << endl;
+                    }
+                    else {
+                        for (size_t i = 0; i < clips.size(); i++)
+                            cout << "    " << i << ": " << clips[i].name << " (" << clips[i].duration << " s)" << endl;
+                        cout << "Enter Clip (-1 for the bind pose): ";
+                        while (!(cin >> clipChoice)) {
+                            cout << "ENTER A WHOLE NUMBER: " << endl;
+                            cin.clear();
+                            cin.ignore(INT_MAX, '\n');
+                        }
+                        for (size_t i = 0; i < animator.Count(); i++)
+                            animator.SetClip(i, clipChoice);
+                        cout << "Last pose update: " << animator.LastUpdateMs() << " ms for " << animator.Count() << " characters" << endl;
+                    }
+                }
+                else if (input == "benchskin") {
+                    cout << "Enter Character Count: ";
+                    int characters;
+                    while (!(cin >> characters) || characters <= 0) {
+                        cout << "ENTER A POSITIVE WHOLE NUMBER: " << endl;
+                        cin.clear();
+                        cin.ignore(INT_MAX, '\n');
+                    }
+                    Benchmarks::Skinning(testModel, characters);
+                }
+                else if (input == "benchdxt") {
+                    Benchmarks::DxtCompression();
+                }
+                else if (input == "pick") {
+                    // The cursor is captured by the camera, so pick through the middle of the window
+                    Ray ray = Ray::FromScreen(1920.0f * 0.5f, 1080.0f * 0.5f, 1920.0f, 1080.0f, cam.GetViewMatrix(), proj);
+                    RayHit hit;
+                    auto pickStart = std::chrono::high_resolution_clock::now();
+                    if (copies.Count() > 0) {
+                        copyTree.Pick(ray, testModel, copies, hit);
+                    }
+                    else {
+                        glm::mat4 pickModel = glm::rotate(glm::scale(glm::mat4(1.0f), glm::vec3(scalingValue)), glm::radians(angleValue), rotationVector);
+                        testModel.Pick(ray, pickModel, hit);
+                    }
+                    float pickUs = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - pickStart).count();
+
+                    if (hit.Hit()) {
+                        cout << "Hit mesh " << hit.mesh << " triangle " << hit.triangle;
+                        if (hit.instance != RayHit::None)
+                            cout << " instance " << hit.instance;
+                        cout << " at distance " << hit.t << ", barycentrics (" << hit.barycentric.x << ", " << hit.barycentric.y
+                            << ", " << hit.barycentric.z << ")" << endl;
+                    }
+                    else {
+                        cout << "Nothing under the crosshair" << endl;
+                    }
+                    cout << "Pick took " << pickUs << " us" << endl;
+                }
                 else {
                     system("cls");
                     cout << "Command not found!" << endl;
@@ -349,7 +549,10 @@ int main() {
             curSelector = 4;
 
 
-        cam.CameraUpdate(window, deltaTime, sceneShader.ID);
+        cam.CameraUpdate(window, deltaTime);
+
+        // --- Stream in decoded textures, ~2ms of uploads per frame ---
+        TextureStreamer::Instance().Update(2.0);
 
         // ---------- Render to framebuffer ----------
         glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
@@ -357,8 +560,17 @@ int main() {
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // --- Draw Grid ---
+        // --- Camera and light for every program, one upload per frame ---
         glm::mat4 view = cam.GetViewMatrix();
+        frameData.view = view;
+        frameData.projection = proj;
+        frameData.viewProj = proj * view;
+        frameData.cameraPos = glm::vec4(cam.cameraPos, 1.0f);
+        frameData.lightPos = glm::vec4(lightPos, 1.0f);
+        frameData.ambientLight = glm::vec4(ambientLighting, ambientLighting, ambientLighting, 1);
+        frameUniforms.Update(frameData);
+
+        // --- Draw Grid ---
         glm::mat4 model = glm::mat4(1.0f);
         
         // --- Draw Model ---
@@ -367,32 +579,54 @@ int main() {
         testModelModel = glm::scale(testModelModel, glm::vec3(scalingValue));
         testModelModel = glm::rotate(testModelModel, glm::radians(angleValue), rotationVector);
 
-        modelShader.setMat4("model", testModelModel);
-        modelShader.setMat4("view", view);
-        modelShader.setMat4("projection", proj);
         modelShader.setInt("texture_diffuse1", 0);
         modelShader.setInt("texture_specular1", 1);
-        modelShader.setVec3("lightPos", lightPos);
-
-        glm::vec4 _ambientLight = glm::vec4(ambientLighting, ambientLighting, ambientLighting, 1);
-        modelShader.setVec4("ambientLight", _ambientLight);
 
         // Set your solid color
         modelShader.setVec3("aColor", glm::vec3(1, 1, 1)); // Red
-        testModel.Draw(modelShader);
+        // Frustum planes for culling instances, the single model Draw extracts its own from view/proj
+        Frustum frustum = Frustum::FromMatrix(proj * view);
+
+        // Pose every character and stream the joints before anything draws
+        if (animator.Count() > 0) {
+            animator.Update(deltaTime);
+            palette.Upload(animator.Palette());
+            testModel.SetSkinPalette(&palette);
+        }
+
+        // Occluders only pay off with many copies, the closest ones hide the most
+        if (occlusionCulling && copies.Count() > occluderCount) {
+            const vector<InstanceData>& copyData = copies.Instances();
+            nearestCopies.resize(copyData.size());
+            for (size_t i = 0; i < nearestCopies.size(); i++)
+                nearestCopies[i] = i;
+            auto distance = [&](size_t i) { return glm::length(glm::vec3(copyData[i].transform[3]) - cam.cameraPos); };
+            std::nth_element(nearestCopies.begin(), nearestCopies.begin() + occluderCount, nearestCopies.end(),
+                [&](size_t a, size_t b) { return distance(a) < distance(b); });
+            occlusion.ClearOccluders();
+            for (size_t i = 0; i < occluderCount; i++)
+                occlusion.AddOccluder(occluderMesh, copyData[nearestCopies[i]].transform);
+            occlusion.Render(proj * view);
+            testModel.SetOcclusionCuller(&occlusion);
+        }
+        else {
+            testModel.SetOcclusionCuller(nullptr);
+        }
+
+        if (copies.Count() > 0)
+            testModel.DrawInstanced(modelShader, proj * view, copies, 0, &frustum);
+        else
+            testModel.Draw(modelShader, testModelModel, view, proj, 1080.0f);
 
         glm::mat4 lightSphereModel = glm::mat4(1.0f);
         lightSphereModel = glm::translate(lightSphereModel, lightPos);
         lightShader.use();
         lightShader.setMat4("model", lightSphereModel);
-        lightShader.setMat4("view", view);
-        lightShader.setMat4("projection", proj);
         lightShader.setVec3("color", glm::vec3(1, 0, 0));
         lightSphere.DrawMesh(lightShader);
 
         //Set uniforms
         gridShader.use();
-        gridShader.setMat4("view", view);
         gridShader.setMat4("model", model);
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(-1.0f, -1.0f);   // negative pushes *toward* the camera
@@ -423,6 +657,11 @@ int main() {
 
     gridMesh.Deletion();
     quadMesh.EBODeletion();
+    TextureStreamer::Instance().Delete();
+    skins.Delete();
+    copies.Delete();
+    palette.Delete();
+    frameUniforms.Delete();
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -0,0 +1,126 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Same sized images packed as the layers of one GL_TEXTURE_2D_ARRAY with a shared mip chain.
+// Material variants (e.g. the Car color skins) become a layer index instead of a texture bind.
+class TextureArray {
+public:
+    GLuint id = 0;
+    int width = 0;
+    int height = 0;
+
+    TextureArray() {}
+    ~TextureArray() { Delete(); }
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    // Decodes every image on the worker pool and uploads the ones with the size of the first readable image.
+    // Images that don't match are skipped with a warning. Returns false if no layer could be built
+    bool Build(const vector<string>& paths, bool gamma = false) {
+        Delete();
+        layerPaths.clear();
+
+        struct Image {
+            unsigned char* pixels = nullptr;
+            int width = 0;
+            int height = 0;
+        };
+        vector<Image> images(paths.size());
+        ThreadPool::Instance().ParallelFor(paths.size(), [&](size_t i) {
+            int components;
+            // Always 4 channels so every layer shares one format
+            images[i].pixels = stbi_load(paths[i].c_str(), &images[i].width, &images[i].height, &components, 4);
+        });
+
+        vector<size_t> layers;
+        for (size_t i = 0; i < images.size(); i++) {
+            if (!images[i].pixels) {
+                std::cerr << "[TextureArray] Failed to load: " << paths[i] << std::endl;
+                continue;
+            }
+            if (layers.empty()) {
+                width = images[i].width;
+                height = images[i].height;
+            }
+            if (images[i].width != width || images[i].height != height) {
+                std::cout << "[TextureArray] Skipping " << paths[i] << ", " << images[i].width << "x" << images[i].height
+                    << " does not match " << width << "x" << height << std::endl;
+                continue;
+            }
+            layers.push_back(i);
+        }
+
+        if (!layers.empty()) {
+            glGenTextures(1, &id);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, gamma ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, (GLsizei)layers.size(),
+                0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            for (size_t layer = 0; layer < layers.size(); layer++) {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, images[layers[layer]].pixels);
+                layerPaths.push_back(paths[layers[layer]]);
+            }
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            std::cout << "[TextureArray] Built " << layers.size() << " layers of " << width << "x" << height << std::endl;
+        }
+
+        for (Image& image : images)
+            if (image.pixels) stbi_image_free(image.pixels);
+        return !layers.empty();
+    }
+
+    int LayerCount() const { return (int)layerPaths.size(); }
+
+    const string& LayerPath(int layer) const { return layerPaths[layer]; }
+
+    // Layer holding the image with this file name (directories and case ignored), -1 if none
+    int LayerOf(const string& path) const {
+        string name = FileName(path);
+        for (size_t i = 0; i < layerPaths.size(); i++)
+            if (FileName(layerPaths[i]) == name)
+                return (int)i;
+        return -1;
+    }
+
+    void Bind(unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void Delete() {
+        if (id && glfwGetCurrentContext())
+            glDeleteTextures(1, &id);
+        id = 0;
+    }
+
+private:
+    vector<string> layerPaths;
+
+    static string FileName(const string& path) {
+        size_t slash = path.find_last_of("/\\");
+        string name = slash != string::npos ? path.substr(slash + 1) : path;
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return name;
+    }
+};
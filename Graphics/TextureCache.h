@@ -0,0 +1,132 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include <cctype>
+#include "TextureStreamer.h"
+
+using namespace std;
+
+// Process wide texture cache shared by every Model.
+// Entries are keyed by canonical path plus load options and reference counted,
+// the GL texture is deleted when the last Model holding it releases it.
+class TextureCache {
+public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t resident = 0;
+    };
+
+    static TextureCache& Instance() {
+        static TextureCache cache;
+        return cache;
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Returns the texture for path, loading it on a miss. Every Acquire needs a matching Release
+    GLuint Acquire(const string& path, bool gamma) {
+        string key = MakeKey(path, gamma);
+        GLuint id = Find(key);
+        if (id)
+            return id;
+        return Insert(key, TextureStreamer::Instance().Request(path, gamma));
+    }
+
+    // Same as Acquire for an encoded image held in memory, name identifies it (e.g. "model.glb#image0").
+    // The bytes are only copied and decoded on a miss
+    GLuint AcquireEncoded(const string& name, const unsigned char* data, size_t size, bool gamma) {
+        string key = MakeKey(name, gamma);
+        GLuint id = Find(key);
+        if (id)
+            return id;
+        return Insert(key, TextureStreamer::Instance().RequestEncoded(vector<unsigned char>(data, data + size), name, gamma));
+    }
+
+    // Drops one reference, deletes the texture once nobody uses it
+    void Release(GLuint id) {
+        auto key = keysById.find(id);
+        if (key == keysById.end())
+            return;
+
+        auto entry = entries.find(key->second);
+        if (--entry->second.refCount > 0)
+            return;
+
+        // Nothing to delete into once the window (and its context) is gone at exit.
+        // The streamer holds the name back until a decode still in flight for it has come back
+        if (glfwGetCurrentContext())
+            TextureStreamer::Instance().Release(id);
+        entries.erase(entry);
+        keysById.erase(key);
+        stats.resident = entries.size();
+    }
+
+    const Stats& GetStats() const { return stats; }
+
+    void PrintStats() const {
+        size_t lookups = stats.hits + stats.misses;
+        std::cout << "[TextureCache] hits=" << stats.hits << " misses=" << stats.misses
+            << " hitRate=" << (lookups ? 100.0 * stats.hits / lookups : 0.0) << "%"
+            << " resident=" << stats.resident << std::endl;
+    }
+
+private:
+    struct Entry {
+        GLuint id = 0;
+        int refCount = 0;
+    };
+
+    unordered_map<string, Entry> entries;
+    unordered_map<GLuint, string> keysById;
+    Stats stats;
+
+    TextureCache() {}
+
+    // Adds a reference to an existing entry, 0 on a miss
+    GLuint Find(const string& key) {
+        auto found = entries.find(key);
+        if (found == entries.end())
+            return 0;
+        found->second.refCount++;
+        stats.hits++;
+        return found->second.id;
+    }
+
+    GLuint Insert(const string& key, GLuint id) {
+        stats.misses++;
+        Entry entry;
+        entry.id = id;
+        entry.refCount = 1;
+        entries.emplace(key, entry);
+        keysById.emplace(entry.id, key);
+        stats.resident = entries.size();
+        return entry.id;
+    }
+
+    // Canonical absolute path so the same file reached through different relative paths shares one entry
+    static string MakeKey(const string& path, bool gamma) {
+        std::error_code ec;
+        std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+        std::filesystem::path canonical;
+        if (!ec)
+            canonical = std::filesystem::weakly_canonical(absolute, ec);
+        string key = ec ? path : canonical.generic_string();
+#ifdef _WIN32
+        // Windows paths are case insensitive
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+        key += gamma ? "|srgb" : "|linear";
+        return key;
+    }
+};
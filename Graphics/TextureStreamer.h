@@ -0,0 +1,331 @@
+#pragma once
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <stb_image.h>
+#include <SOIL.h>
+
+#include <iostream>
+#include <string>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "DdsCache.h"
+#include "MipGenerator.h"
+
+using namespace std;
+
+// Defined in SOIL.c but not exported by SOIL.h
+extern "C" unsigned int SOIL_direct_load_DDS_from_memory(const unsigned char* const buffer, int buffer_length,
+    unsigned int reuse_texture_ID, int flags, int loading_as_cubemap);
+
+// Streams textures in the background.
+// Request() hands out a real texture name right away holding a 1x1 placeholder,
+// decoding and the mip chain (MipGenerator) run on the worker pool and Update() swaps every level into the same name
+// through a pixel buffer object, so meshes never need to know when the data arrived.
+// With compression on, linear textures go through DdsCache: the first load encodes a BC1/BC3 mip chain on the worker,
+// later loads only read the cached DDS, and either way the GL thread uploads the compressed levels directly.
+class TextureStreamer {
+public:
+    static TextureStreamer& Instance() {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // GL thread: creates the texture with placeholder content and queues the decode
+    GLuint Request(const string& path, bool gamma) {
+        GLuint textureID = CreatePlaceholder();
+        bool compress = UseDdsCache(gamma);
+        MipGenerator::Filter filter = mipFilter;
+
+        inFlight++;
+        requested++;
+        pending.insert(textureID);
+        ThreadPool::Instance().Submit([this, textureID, path, gamma, compress, filter] {
+            Decoded decoded;
+            decoded.id = textureID;
+            decoded.path = path;
+            decoded.gamma = gamma;
+            MappedFile file;
+            if (file.open(path))
+                Decode(decoded, file.data(), file.size(), compress, filter);
+
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(std::move(decoded));
+        });
+        return textureID;
+    }
+
+    // Same as Request for an image that is already in memory in an encoded format (e.g. PNG inside a GLB).
+    // name is only used for logging
+    GLuint RequestEncoded(vector<unsigned char> encoded, const string& name, bool gamma) {
+        GLuint textureID = CreatePlaceholder();
+        bool compress = UseDdsCache(gamma);
+        MipGenerator::Filter filter = mipFilter;
+
+        inFlight++;
+        requested++;
+        pending.insert(textureID);
+        auto bytes = std::make_shared<vector<unsigned char>>(std::move(encoded));
+        ThreadPool::Instance().Submit([this, textureID, bytes, name, gamma, compress, filter] {
+            Decoded decoded;
+            decoded.id = textureID;
+            decoded.path = name;
+            decoded.gamma = gamma;
+            Decode(decoded, bytes->data(), bytes->size(), compress, filter);
+
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(std::move(decoded));
+        });
+        return textureID;
+    }
+
+    // GL thread, once per frame: uploads decoded images until the time budget is spent.
+    // At least one image goes up per call so streaming always makes progress.
+    void Update(double budgetMs = 2.0) {
+        auto start = std::chrono::high_resolution_clock::now();
+        bool uploadedAny = false;
+
+        for (;;) {
+            Decoded decoded;
+            {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                if (ready.empty())
+                    break;
+                decoded = std::move(ready.front());
+                ready.pop_front();
+            }
+
+            pending.erase(decoded.id);
+            if (released.erase(decoded.id))
+                Discard(decoded);
+            else
+                Upload(decoded);
+            inFlight--;
+            uploadedAny = true;
+
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if (elapsed >= budgetMs)
+                break;
+        }
+
+        if (uploadedAny && inFlight == 0)
+            std::cout << "[TextureStreamer] All " << requested << " textures streamed in" << std::endl;
+    }
+
+    // Blocks until every requested texture is uploaded, for tools that need final data
+    void Flush() {
+        while (inFlight > 0) {
+            Update(1000.0);
+            std::this_thread::yield();
+        }
+    }
+
+    size_t Pending() const { return inFlight; }
+
+    // GL thread: deletes a texture handed out by Request. A name whose decode is still in flight is only deleted
+    // once the decode comes back, and its upload is dropped, so Update never writes into a freed (or recycled) name
+    void Release(GLuint id) {
+        if (pending.count(id))
+            released.insert(id);
+        else
+            glDeleteTextures(1, &id);
+    }
+
+    // Block compression for textures requested from now on, on by default
+    void SetCompression(bool enabled) { compression = enabled; }
+    bool IsCompression() const { return compression; }
+
+    // Mip filter for textures requested from now on, Kaiser by default
+    void SetMipFilter(MipGenerator::Filter filter) { mipFilter = filter; }
+    MipGenerator::Filter GetMipFilter() const { return mipFilter; }
+
+    void Delete() {
+        if (pbos[0]) glDeleteBuffers(PboCount, pbos);
+        memset(pbos, 0, sizeof(pbos));
+    }
+
+private:
+    struct Decoded {
+        GLuint id = 0;
+        string path;
+        bool gamma = false;
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        vector<unsigned char> dds;  // cached or freshly encoded DDS, used instead of pixels when not empty
+        vector<unsigned char> mips; // levels 1 and up for pixels, see MipGenerator::Build
+    };
+
+    static const int PboCount = 2;
+
+    std::mutex readyMutex;
+    std::deque<Decoded> ready;
+    std::atomic<size_t> inFlight{ 0 };
+    size_t requested = 0;
+    unordered_set<GLuint> pending;   // names with a decode in flight, GL thread only
+    unordered_set<GLuint> released;  // pending names released before their decode came back
+    GLuint pbos[PboCount] = {};
+    int nextPbo = 0;
+    bool compression = true;
+    MipGenerator::Filter mipFilter = MipGenerator::Kaiser;
+
+    TextureStreamer() {}
+
+    // 1x1 white texel, complete with the final sampler state so it can be bound immediately
+    static GLuint CreatePlaceholder() {
+        static const unsigned char white[4] = { 255, 255, 255, 255 };
+
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return textureID;
+    }
+
+    // SOIL's direct DDS upload only knows the linear S3TC formats, sRGB textures stay uncompressed
+    bool UseDdsCache(bool gamma) const {
+        return compression && !gamma && GLEW_EXT_texture_compression_s3tc;
+    }
+
+    // Worker side: the cached DDS if the source is unchanged, otherwise decode and (when compressing) encode and cache.
+    // Uncompressed images get their mip chain here too, sRGB ones filtered in linear light
+    static void Decode(Decoded& decoded, const unsigned char* encoded, size_t size, bool compress, MipGenerator::Filter filter) {
+        uint64_t sourceHash = 0;
+        if (compress) {
+            sourceHash = ModelCache::HashBytes(encoded, size);
+            if (DdsCache::Instance().Load(decoded.path, sourceHash, filter, decoded.dds))
+                return;
+        }
+
+        decoded.pixels = stbi_load_from_memory(encoded, (int)size, &decoded.width, &decoded.height, &decoded.components, 0);
+        if (!decoded.pixels)
+            return;
+        if (compress && DdsCache::Instance().Store(decoded.path, sourceHash, filter, decoded.pixels, decoded.width, decoded.height,
+            decoded.components, decoded.dds)) {
+            stbi_image_free(decoded.pixels);
+            decoded.pixels = nullptr;
+            return;
+        }
+        MipGenerator::Build(decoded.pixels, decoded.width, decoded.height, decoded.components, filter, decoded.gamma, decoded.mips);
+    }
+
+    // Decode of a texture released while in flight, nothing is uploaded and the name is deleted now
+    static void Discard(Decoded& decoded) {
+        if (decoded.pixels)
+            stbi_image_free(decoded.pixels);
+        decoded.pixels = nullptr;
+        glDeleteTextures(1, &decoded.id);
+    }
+
+    // Re-specifies the texture with every compressed level of the DDS, no PBO since the data is already small
+    void UploadCompressed(Decoded& decoded) {
+        int width = 0, height = 0, levels = 0;
+        bool alpha = false;
+        DdsCache::Parse(decoded.dds, width, height, levels, alpha);
+        GLuint id = SOIL_direct_load_DDS_from_memory(decoded.dds.data(), (int)decoded.dds.size(), decoded.id, SOIL_FLAG_TEXTURE_REPEATS, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (!id) {
+            std::cerr << "[TextureStreamer] DDS upload failed for: " << decoded.path << " (" << SOIL_last_result() << ")" << std::endl;
+            return;
+        }
+
+        std::cout << "[TextureFromFile] OK: " << decoded.path << " " << width << "x" << height << " " << (alpha ? "BC3" : "BC1")
+            << " levels=" << levels << " " << decoded.dds.size() / 1024 << " KB" << std::endl;
+        decoded.dds.clear();
+        decoded.dds.shrink_to_fit();
+    }
+
+    // Copies the pixels and their mip chain into a PBO and re-specifies every level from it
+    void Upload(Decoded& decoded) {
+        if (!decoded.dds.empty()) {
+            UploadCompressed(decoded);
+            return;
+        }
+        if (!decoded.pixels) {
+            std::cerr << "[TextureFromFile] Failed to load: " << decoded.path << std::endl;
+            return;
+        }
+
+        GLenum format = GL_RGB;
+        if (decoded.components == 1) format = GL_RED;
+        else if (decoded.components == 2) format = GL_RG;
+        else if (decoded.components == 3) format = GL_RGB;
+        else if (decoded.components == 4) format = GL_RGBA;
+
+        GLenum internalFormat = format;
+        if (decoded.gamma && format == GL_RGB) internalFormat = GL_SRGB;
+        else if (decoded.gamma && format == GL_RGBA) internalFormat = GL_SRGB_ALPHA;
+
+        GLsizeiptr baseSize = (GLsizeiptr)decoded.width * decoded.height * decoded.components;
+        GLsizeiptr size = baseSize + (GLsizeiptr)decoded.mips.size();
+
+        if (!pbos[0])
+            glGenBuffers(PboCount, pbos);
+        GLuint pbo = pbos[nextPbo];
+        nextPbo = (nextPbo + 1) % PboCount;
+
+        // Orphan the previous storage so the copy never waits on an upload still in flight
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+            memcpy(mapped, decoded.pixels, (size_t)baseSize);
+            if (!decoded.mips.empty())
+                memcpy((unsigned char*)mapped + baseSize, decoded.mips.data(), decoded.mips.size());
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        stbi_image_free(decoded.pixels);
+        decoded.pixels = nullptr;
+
+        if (!mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            std::cerr << "[TextureStreamer] Could not map upload buffer for: " << decoded.path << std::endl;
+            return;
+        }
+
+        // Rows of 1 and 3 channel images are not 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, decoded.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, decoded.width, decoded.height, 0, format,
+            GL_UNSIGNED_BYTE, (void*)0);
+        int levels = 1;
+        if (decoded.mips.empty()) {
+            // MipGenerator failed, let the driver build the chain
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        else {
+            levels = MipGenerator::LevelCount(decoded.width, decoded.height);
+            for (int l = 1; l < levels; l++) {
+                size_t offset = (size_t)baseSize + MipGenerator::LevelOffset(decoded.width, decoded.height, decoded.components, l);
+                glTexImage2D(GL_TEXTURE_2D, l, internalFormat, MipGenerator::LevelSize(decoded.width, l),
+                    MipGenerator::LevelSize(decoded.height, l), 0, format, GL_UNSIGNED_BYTE, (void*)offset);
+            }
+            decoded.mips.clear();
+            decoded.mips.shrink_to_fit();
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        std::cout << "[TextureFromFile] OK: " << decoded.path << " " << decoded.width << "x" << decoded.height
+            << " channels=" << decoded.components << " levels=" << levels << std::endl;
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <queue>
+#include <vector>
+
+// Shared worker pool for CPU side loading work (mesh conversion, decoding, ...).
+// Workers never touch GL, anything that needs the context goes back to the main thread.
+class ThreadPool {
+public:
+    // Process wide pool, leaves one core for the GL/main thread
+    static ThreadPool& Instance() {
+        static ThreadPool pool(DefaultWorkerCount());
+        return pool;
+    }
+
+    static unsigned int DefaultWorkerCount() {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    explicit ThreadPool(unsigned int workerCount) {
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t WorkerCount() const { return workers.size(); }
+
+    //Queues a job, the future holds its result
+    template <typename F>
+    auto Submit(F&& job) -> std::future<decltype(job())> {
+        using Result = decltype(job());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.push([task] { (*task)(); });
+        }
+        queueCondition.notify_one();
+        return result;
+    }
+
+    // Runs body(i) for every i in [0, count) and blocks until all are done.
+    // The calling thread takes part, so it is safe to call from inside a job.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body, size_t grain = 1) {
+        if (count == 0)
+            return;
+        if (grain == 0)
+            grain = 1;
+
+        struct Batch {
+            std::atomic<size_t> next{ 0 };
+            std::atomic<size_t> finished{ 0 };
+            std::mutex doneMutex;
+            std::condition_variable doneCondition;
+        };
+        auto batch = std::make_shared<Batch>();
+        size_t chunks = (count + grain - 1) / grain;
+
+        // Body is only borrowed by helpers that find work before the batch finishes
+        auto run = [batch, &body, count, grain, chunks] {
+            size_t chunk;
+            while ((chunk = batch->next.fetch_add(1)) < chunks) {
+                size_t begin = chunk * grain;
+                size_t end = begin + grain < count ? begin + grain : count;
+                for (size_t i = begin; i < end; i++)
+                    body(i);
+                if (batch->finished.fetch_add(1) + 1 == chunks) {
+                    std::lock_guard<std::mutex> lock(batch->doneMutex);
+                    batch->doneCondition.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = chunks - 1 < workers.size() ? chunks - 1 : workers.size();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (size_t i = 0; i < helpers; i++)
+                jobs.push(run);
+        }
+        queueCondition.notify_all();
+
+        run();
+
+        std::unique_lock<std::mutex> lock(batch->doneMutex);
+        batch->doneCondition.wait(lock, [&] { return batch->finished.load() == chunks; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void WorkerLoop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+};
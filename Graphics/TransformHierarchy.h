@@ -0,0 +1,118 @@
+#pragma once
+#include <glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE 1
+#endif
+
+using namespace std;
+
+// Importer side description of one scene node, parents always come before their children
+struct NodeData {
+    string name;
+    int parent = -1;
+    glm::mat4 local = glm::mat4(1.0f);
+};
+
+// Flattened node tree as parallel arrays in parent-before-child order.
+// SetLocal only flags a node, Update then walks the arrays once and recomputes world matrices
+// for flagged nodes and everything below them, so untouched subtrees cost a flag test each.
+class TransformHierarchy {
+public:
+    void Build(const vector<NodeData>& nodes) {
+        names.clear();
+        parents.clear();
+        locals.clear();
+        for (const NodeData& node : nodes) {
+            names.push_back(node.name);
+            // A parent that doesn't come first would be read before it is computed, treat it as a root
+            parents.push_back(node.parent < (int)parents.size() ? node.parent : -1);
+            locals.push_back(node.local);
+        }
+        worlds.assign(locals.size(), glm::mat4(1.0f));
+        flags.assign(locals.size(), LocalDirty);
+        Update();
+    }
+
+    size_t Size() const { return locals.size(); }
+
+    int Parent(int node) const { return parents[node]; }
+    const string& Name(int node) const { return names[node]; }
+
+    int Find(const string& name) const {
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return (int)i;
+        return -1;
+    }
+
+    const glm::mat4& Local(int node) const { return locals[node]; }
+
+    void SetLocal(int node, const glm::mat4& local) {
+        locals[node] = local;
+        flags[node] |= LocalDirty;
+    }
+
+    // Model space matrix of a node, current as of the last Update
+    const glm::mat4& World(int node) const { return worlds[node]; }
+
+    // Recomputes dirty subtrees, returns how many world matrices changed
+    size_t Update() {
+        size_t updated = 0;
+        size_t count = locals.size();
+        for (size_t i = 0; i < count; i++) {
+            int parent = parents[i];
+            bool changed = (flags[i] & LocalDirty) || (parent >= 0 && (flags[parent] & WorldChanged));
+            if (!changed) {
+                flags[i] = 0;
+                continue;
+            }
+            if (parent >= 0)
+                Multiply(worlds[parent], locals[i], worlds[i]);
+            else
+                worlds[i] = locals[i];
+            flags[i] = WorldChanged;
+            updated++;
+        }
+        // WorldChanged is only needed within one pass, children always come after their parent
+        if (updated)
+            for (uint8_t& flag : flags) flag = 0;
+        return updated;
+    }
+
+    // out = a * b for column major matrices, out may not alias a or b
+    static void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef TRANSFORM_HIERARCHY_SSE
+        const float* pa = &a[0][0];
+        const float* pb = &b[0][0];
+        float* po = &out[0][0];
+        __m128 a0 = _mm_loadu_ps(pa);
+        __m128 a1 = _mm_loadu_ps(pa + 4);
+        __m128 a2 = _mm_loadu_ps(pa + 8);
+        __m128 a3 = _mm_loadu_ps(pa + 12);
+        for (int column = 0; column < 4; column++) {
+            const float* bc = pb + column * 4;
+            __m128 r = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+            _mm_storeu_ps(po + column * 4, r);
+        }
+#else
+        out = a * b;
+#endif
+    }
+
+private:
+    static constexpr uint8_t LocalDirty = 1;
+    static constexpr uint8_t WorldChanged = 2;
+
+    vector<string> names;
+    vector<int> parents;
+    vector<glm::mat4> locals;
+    vector<glm::mat4> worlds;
+    vector<uint8_t> flags;
+};
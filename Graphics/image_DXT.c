@@ -13,6 +13,15 @@
 #include <string.h>
 #include <stdio.h>
 
+/*	SSE2 block encoder.  It does every floating point operation of the
+	scalar encoder below in the same order, so both write the same bits.
+	That breaks if the compiler fuses a*b+c into FMAs, so don't build
+	this file with floating point contraction enabled	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DXT_SSE 1
+#endif
+
 /*	set this =1 if you want to use the covarince matrix method...
 	which is better than my method of using standard deviations
 	overall, except on the infintesimal chance that the power
@@ -37,6 +46,27 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+#ifdef DXT_SSE
+/*	SIMD versions of the two above, bit identical results	*/
+void compress_DDS_color_block_SSE(
+				int channels,
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8] );
+void compress_DDS_alpha_block_SSE(
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8] );
+#endif
+/*	the SIMD block encoder if use_SIMD and it is compiled in,
+	otherwise the scalar one	*/
+static void encode_color_block(
+				int channels,
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8],
+				int use_SIMD );
+static void encode_alpha_block(
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8],
+				int use_SIMD );
 
 /********* Actual Exposed Functions *********/
 int
@@ -104,11 +134,6 @@ unsigned char* convert_image_to_DXT1(
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -117,17 +142,48 @@ unsigned char* convert_image_to_DXT1(
 	{
 		return NULL;
 	}
+	/*	get the RAM for the compressed image
+		(8 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
+	compressed = (unsigned char*)malloc( *out_size );
+	convert_image_to_DXT1_rows( uncompressed, width, height, channels,
+		0, (height+3) >> 2, compressed, 1 );
+	return compressed;
+}
+
+void convert_image_to_DXT1_rows(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int first_block_row, int block_rows,
+		unsigned char *compressed, int use_SIMD )
+{
+	int i, j, x, y;
+	unsigned char ublock[16*3];
+	unsigned char cblock[8];
+	int index, chan_step = 1;
+	int end_row;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) || (NULL == compressed) ||
+		(channels < 1) || (channels > 4) ||
+		(first_block_row < 0) || (block_rows < 1) )
+	{
+		return;
+	}
 	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
 	if( channels < 3 )
 	{
 		chan_step = 0;
 	}
-	/*	get the RAM for the compressed image
-		(8 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
-	compressed = (unsigned char*)malloc( *out_size );
+	/*	rows past the bottom of the image are ignored	*/
+	end_row = (first_block_row + block_rows) * 4;
+	if( end_row > height )
+	{
+		end_row = height;
+	}
+	index = first_block_row * ((width+3) >> 2) * 8;
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	for( j = first_block_row * 4; j < end_row; j += 4 )
 	{
 		for( i = 0; i < width; i += 4 )
 		{
@@ -167,8 +223,7 @@ unsigned char* convert_image_to_DXT1(
 				}
 			}
 			/*	compress the block	*/
-			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
+			encode_color_block( 3, ublock, cblock, use_SIMD );
 			/*	copy the data from the block into the main block	*/
 			for( x = 0; x < 8; ++x )
 			{
@@ -176,7 +231,6 @@ unsigned char* convert_image_to_DXT1(
 			}
 		}
 	}
-	return compressed;
 }
 
 unsigned char* convert_image_to_DXT5(
@@ -185,11 +239,6 @@ unsigned char* convert_image_to_DXT5(
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*4];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0, has_alpha;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -198,6 +247,34 @@ unsigned char* convert_image_to_DXT5(
 	{
 		return NULL;
 	}
+	/*	get the RAM for the compressed image
+		(16 bytes per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
+	compressed = (unsigned char*)malloc( *out_size );
+	convert_image_to_DXT5_rows( uncompressed, width, height, channels,
+		0, (height+3) >> 2, compressed, 1 );
+	return compressed;
+}
+
+void convert_image_to_DXT5_rows(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int first_block_row, int block_rows,
+		unsigned char *compressed, int use_SIMD )
+{
+	int i, j, x, y;
+	unsigned char ublock[16*4];
+	unsigned char cblock[8];
+	int index, chan_step = 1;
+	int has_alpha, end_row;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) || (NULL == compressed) ||
+		(channels < 1) || (channels > 4) ||
+		(first_block_row < 0) || (block_rows < 1) )
+	{
+		return;
+	}
 	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
 	if( channels < 3 )
 	{
@@ -205,12 +282,15 @@ unsigned char* convert_image_to_DXT5(
 	}
 	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
 	has_alpha = 1 - (channels & 1);
-	/*	get the RAM for the compressed image
-		(16 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
-	compressed = (unsigned char*)malloc( *out_size );
+	/*	rows past the bottom of the image are ignored	*/
+	end_row = (first_block_row + block_rows) * 4;
+	if( end_row > height )
+	{
+		end_row = height;
+	}
+	index = first_block_row * ((width+3) >> 2) * 16;
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	for( j = first_block_row * 4; j < end_row; j += 4 )
 	{
 		for( i = 0; i < width; i += 4 )
 		{
@@ -255,15 +335,14 @@ unsigned char* convert_image_to_DXT5(
 				}
 			}
 			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
+			encode_alpha_block( ublock, cblock, use_SIMD );
 			/*	copy the data from the compressed alpha block into the main buffer	*/
 			for( x = 0; x < 8; ++x )
 			{
 				compressed[index++] = cblock[x];
 			}
 			/*	then compress the color block	*/
-			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
+			encode_color_block( 4, ublock, cblock, use_SIMD );
 			/*	copy the data from the compressed color block into the main buffer	*/
 			for( x = 0; x < 8; ++x )
 			{
@@ -271,7 +350,15 @@ unsigned char* convert_image_to_DXT5(
 			}
 		}
 	}
-	return compressed;
+}
+
+int DXT_has_SIMD( void )
+{
+#ifdef DXT_SSE
+	return 1;
+#else
+	return 0;
+#endif
 }
 
 /********* Helper Functions *********/
@@ -296,30 +383,16 @@ void rgb_888_from_565( unsigned int c, int *r, int *g, int *b )
 	*b = convert_bit_range( (c >> 00) & 31, 5, 8 );
 }
 
-void compute_color_line_STDEV(
-		const unsigned char *const uncompressed,
-		int channels,
+/*	the covariance sums of a block are integers below 2^24, so they are
+	exact in floats and the same whatever order they are added in.
+	Everything from the sums on is shared by the scalar and SIMD encoders	*/
+static void color_line_from_sums(
+		float sum_r, float sum_g, float sum_b,
+		float sum_rr, float sum_gg, float sum_bb,
+		float sum_rg, float sum_rb, float sum_gb,
 		float point[3], float direction[3] )
 {
 	const float inv_16 = 1.0f / 16.0f;
-	int i;
-	float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
-	float sum_rr = 0.0f, sum_gg = 0.0f, sum_bb = 0.0f;
-	float sum_rg = 0.0f, sum_rb = 0.0f, sum_gb = 0.0f;
-	/*	calculate all data needed for the covariance matrix
-		( to compare with _rygdxt code)	*/
-	for( i = 0; i < 16*channels; i += channels )
-	{
-		sum_r += uncompressed[i+0];
-		sum_rr += uncompressed[i+0] * uncompressed[i+0];
-		sum_g += uncompressed[i+1];
-		sum_gg += uncompressed[i+1] * uncompressed[i+1];
-		sum_b += uncompressed[i+2];
-		sum_bb += uncompressed[i+2] * uncompressed[i+2];
-		sum_rg += uncompressed[i+0] * uncompressed[i+1];
-		sum_rb += uncompressed[i+0] * uncompressed[i+2];
-		sum_gb += uncompressed[i+1] * uncompressed[i+2];
-	}
 	/*	convert the sums to averages	*/
 	sum_r *= inv_16;
 	sum_g *= inv_16;
@@ -408,54 +481,49 @@ void compute_color_line_STDEV(
 	#endif
 }
 
-void LSE_master_colors_max_min(
-		int *cmax, int *cmin,
+void compute_color_line_STDEV(
+		const unsigned char *const uncompressed,
 		int channels,
-		const unsigned char *const uncompressed )
+		float point[3], float direction[3] )
+{
+	int i;
+	float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
+	float sum_rr = 0.0f, sum_gg = 0.0f, sum_bb = 0.0f;
+	float sum_rg = 0.0f, sum_rb = 0.0f, sum_gb = 0.0f;
+	/*	calculate all data needed for the covariance matrix
+		( to compare with _rygdxt code)	*/
+	for( i = 0; i < 16*channels; i += channels )
+	{
+		sum_r += uncompressed[i+0];
+		sum_rr += uncompressed[i+0] * uncompressed[i+0];
+		sum_g += uncompressed[i+1];
+		sum_gg += uncompressed[i+1] * uncompressed[i+1];
+		sum_b += uncompressed[i+2];
+		sum_bb += uncompressed[i+2] * uncompressed[i+2];
+		sum_rg += uncompressed[i+0] * uncompressed[i+1];
+		sum_rb += uncompressed[i+0] * uncompressed[i+2];
+		sum_gb += uncompressed[i+1] * uncompressed[i+2];
+	}
+	color_line_from_sums( sum_r, sum_g, sum_b, sum_rr, sum_gg, sum_bb,
+		sum_rg, sum_rb, sum_gb, point, direction );
+}
+
+/*	turns the extent of the block along the color line into the two
+	565 master colors, cmax > cmin	*/
+static void master_colors_from_line(
+		const float point[3], const float direction[3],
+		float dot_min, float dot_max,
+		int *cmax, int *cmin )
 {
 	int i, j;
 	/*	the master colors	*/
 	int c0[3], c1[3];
-	/*	used for fitting the line	*/
-	float sum_x[] = { 0.0f, 0.0f, 0.0f };
-	float sum_x2[] = { 0.0f, 0.0f, 0.0f };
-	float dot_max = 1.0f, dot_min = -1.0f;
-	float vec_len2 = 0.0f;
+	float vec_len2;
 	float dot;
-	/*	error check	*/
-	if( (channels < 3) || (channels > 4) )
-	{
-		return;
-	}
-	compute_color_line_STDEV( uncompressed, channels, sum_x, sum_x2 );
 	vec_len2 = 1.0f / ( 0.00001f +
-			sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2] );
-	/*	finding the max and min vector values	*/
-	dot_max =
-			(
-				sum_x2[0] * uncompressed[0] +
-				sum_x2[1] * uncompressed[1] +
-				sum_x2[2] * uncompressed[2]
-			);
-	dot_min = dot_max;
-	for( i = 1; i < 16; ++i )
-	{
-		dot =
-			(
-				sum_x2[0] * uncompressed[i*channels+0] +
-				sum_x2[1] * uncompressed[i*channels+1] +
-				sum_x2[2] * uncompressed[i*channels+2]
-			);
-		if( dot < dot_min )
-		{
-			dot_min = dot;
-		} else if( dot > dot_max )
-		{
-			dot_max = dot;
-		}
-	}
+			direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2] );
 	/*	and the offset (from the average location)	*/
-	dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
+	dot = direction[0]*point[0] + direction[1]*point[1] + direction[2]*point[2];
 	dot_min -= dot;
 	dot_max -= dot;
 	/*	post multiply by the scaling factor	*/
@@ -465,7 +533,7 @@ void LSE_master_colors_max_min(
 	for( i = 0; i < 3; ++i )
 	{
 		/*	color 0	*/
-		c0[i] = (int)(0.5f + sum_x[i] + dot_max * sum_x2[i]);
+		c0[i] = (int)(0.5f + point[i] + dot_max * direction[i]);
 		if( c0[i] < 0 )
 		{
 			c0[i] = 0;
@@ -474,7 +542,7 @@ void LSE_master_colors_max_min(
 			c0[i] = 255;
 		}
 		/*	color 1	*/
-		c1[i] = (int)(0.5f + sum_x[i] + dot_min * sum_x2[i]);
+		c1[i] = (int)(0.5f + point[i] + dot_min * direction[i]);
 		if( c1[i] < 0 )
 		{
 			c1[i] = 0;
@@ -497,40 +565,63 @@ void LSE_master_colors_max_min(
 	}
 }
 
-void
-	compress_DDS_color_block
-	(
+void LSE_master_colors_max_min(
+		int *cmax, int *cmin,
 		int channels,
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
-	)
+		const unsigned char *const uncompressed )
+{
+	int i;
+	/*	used for fitting the line	*/
+	float sum_x[] = { 0.0f, 0.0f, 0.0f };
+	float sum_x2[] = { 0.0f, 0.0f, 0.0f };
+	float dot_max = 1.0f, dot_min = -1.0f;
+	float dot;
+	/*	error check	*/
+	if( (channels < 3) || (channels > 4) )
+	{
+		return;
+	}
+	compute_color_line_STDEV( uncompressed, channels, sum_x, sum_x2 );
+	/*	finding the max and min vector values	*/
+	dot_max =
+			(
+				sum_x2[0] * uncompressed[0] +
+				sum_x2[1] * uncompressed[1] +
+				sum_x2[2] * uncompressed[2]
+			);
+	dot_min = dot_max;
+	for( i = 1; i < 16; ++i )
+	{
+		dot =
+			(
+				sum_x2[0] * uncompressed[i*channels+0] +
+				sum_x2[1] * uncompressed[i*channels+1] +
+				sum_x2[2] * uncompressed[i*channels+2]
+			);
+		if( dot < dot_min )
+		{
+			dot_min = dot;
+		} else if( dot > dot_max )
+		{
+			dot_max = dot;
+		}
+	}
+	master_colors_from_line( sum_x, sum_x2, dot_min, dot_max, cmax, cmin );
+}
+
+/*	the line between the decoded master colors, pre-scaled so a pixel's
+	dot product minus the returned offset lands in [0,1]	*/
+static float color_palette_line(
+		int enc_c0, int enc_c1,
+		float color_line[3] )
 {
-	/*	variables	*/
 	int i;
-	int next_bit;
-	int enc_c0, enc_c1;
 	int c0[4], c1[4];
-	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	float vec_len2 = 0.0f, dot_offset = 0.0f;
-	/*	stupid order	*/
-	int swizzle4[] = { 0, 2, 3, 1 };
-	/*	get the master colors	*/
-	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
-	/*	store the 565 color 0 and color 1	*/
-	compressed[0] = (enc_c0 >> 0) & 255;
-	compressed[1] = (enc_c0 >> 8) & 255;
-	compressed[2] = (enc_c1 >> 0) & 255;
-	compressed[3] = (enc_c1 >> 8) & 255;
-	/*	zero out the compressed data	*/
-	compressed[4] = 0;
-	compressed[5] = 0;
-	compressed[6] = 0;
-	compressed[7] = 0;
+	float vec_len2 = 0.0f;
 	/*	reconstitute the master color vectors	*/
 	rgb_888_from_565( enc_c0, &c0[0], &c0[1], &c0[2] );
 	rgb_888_from_565( enc_c1, &c1[0], &c1[1], &c1[2] );
 	/*	the new vector	*/
-	vec_len2 = 0.0f;
 	for( i = 0; i < 3; ++i )
 	{
 		color_line[i] = (float)(c1[i] - c0[i]);
@@ -545,10 +636,56 @@ void
 	color_line[1] *= vec_len2;
 	color_line[2] *= vec_len2;
 	/*	compute the offset (constant) portion of the dot product	*/
-	dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+	return color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+}
+
+/*	writes the master colors and the 16 palette positions (0..3 along the line)	*/
+static void store_color_block(
+		int enc_c0, int enc_c1,
+		const int values[16],
+		unsigned char compressed[8] )
+{
+	int i;
+	int next_bit;
+	/*	stupid order	*/
+	static const int swizzle4[] = { 0, 2, 3, 1 };
+	/*	store the 565 color 0 and color 1	*/
+	compressed[0] = (enc_c0 >> 0) & 255;
+	compressed[1] = (enc_c0 >> 8) & 255;
+	compressed[2] = (enc_c1 >> 0) & 255;
+	compressed[3] = (enc_c1 >> 8) & 255;
+	/*	zero out the compressed data	*/
+	compressed[4] = 0;
+	compressed[5] = 0;
+	compressed[6] = 0;
+	compressed[7] = 0;
 	/*	store the rest of the bits	*/
 	next_bit = 8*4;
 	for( i = 0; i < 16; ++i )
+	{
+		compressed[next_bit >> 3] |= swizzle4[ values[i] ] << (next_bit & 7);
+		next_bit += 2;
+	}
+}
+
+void
+	compress_DDS_color_block
+	(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int enc_c0, enc_c1;
+	int values[16];
+	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float dot_offset = 0.0f;
+	/*	get the master colors	*/
+	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
+	dot_offset = color_palette_line( enc_c0, enc_c1, color_line );
+	for( i = 0; i < 16; ++i )
 	{
 		/*	find the dot product of this color, to place it on the line
 			(should be [-1,1])	*/
@@ -567,39 +704,22 @@ void
 		{
 			next_value = 0;
 		}
-		/*	OK, store this value	*/
-		compressed[next_bit >> 3] |= swizzle4[ next_value ] << (next_bit & 7);
-		next_bit += 2;
+		values[i] = next_value;
 	}
+	store_color_block( enc_c0, enc_c1, values, compressed );
 	/*	done compressing to DXT1	*/
 }
 
-void
-	compress_DDS_alpha_block
-	(
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
-	)
+/*	writes the alpha limits and the 16 3 bit positions between them	*/
+static void store_alpha_block(
+		int a0, int a1,
+		const int values[16],
+		unsigned char compressed[8] )
 {
-	/*	variables	*/
 	int i;
 	int next_bit;
-	int a0, a1;
-	float scale_me;
 	/*	stupid order	*/
-	int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
-	/*	get the alpha limits (a0 > a1)	*/
-	a0 = a1 = uncompressed[3];
-	for( i = 4+3; i < 16*4; i += 4 )
-	{
-		if( uncompressed[i] > a0 )
-		{
-			a0 = uncompressed[i];
-		} else if( uncompressed[i] < a1 )
-		{
-			a1 = uncompressed[i];
-		}
-	}
+	static const int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
 	/*	store those limits, and zero the rest of the compressed dataset	*/
 	compressed[0] = a0;
 	compressed[1] = a1;
@@ -612,13 +732,10 @@ void
 	compressed[7] = 0;
 	/*	store the all of the alpha values	*/
 	next_bit = 8*2;
-	scale_me = 7.9999f / (a0 - a1);
-	for( i = 3; i < 16*4; i += 4 )
+	for( i = 0; i < 16; ++i )
 	{
 		/*	convert this alpha value to a 3 bit number	*/
-		int svalue;
-		int value = (int)((uncompressed[i] - a1) * scale_me);
-		svalue = swizzle8[ value&7 ];
+		int svalue = swizzle8[ values[i]&7 ];
 		/*	OK, store this value, start with the 1st byte	*/
 		compressed[next_bit >> 3] |= svalue << (next_bit & 7);
 		if( (next_bit & 7) > 5 )
@@ -628,5 +745,228 @@ void
 		}
 		next_bit += 3;
 	}
+}
+
+void
+	compress_DDS_alpha_block
+	(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int a0, a1;
+	int values[16];
+	float scale_me;
+	/*	get the alpha limits (a0 > a1)	*/
+	a0 = a1 = uncompressed[3];
+	for( i = 4+3; i < 16*4; i += 4 )
+	{
+		if( uncompressed[i] > a0 )
+		{
+			a0 = uncompressed[i];
+		} else if( uncompressed[i] < a1 )
+		{
+			a1 = uncompressed[i];
+		}
+	}
+	scale_me = 7.9999f / (a0 - a1);
+	for( i = 0; i < 16; ++i )
+	{
+		values[i] = (int)((uncompressed[i*4+3] - a1) * scale_me);
+	}
+	store_alpha_block( a0, a1, values, compressed );
 	/*	done compressing to DXT1	*/
 }
+
+#ifdef DXT_SSE
+/*	lane reductions, the sums are exact so their order doesn't matter	*/
+static float sum_lanes( __m128 v )
+{
+	v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+
+static float min_lanes( __m128 v )
+{
+	v = _mm_min_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_min_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+
+static float max_lanes( __m128 v )
+{
+	v = _mm_max_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_max_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+
+void
+	compress_DDS_color_block_SSE
+	(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	the block split into channel planes	*/
+	float r[16], g[16], b[16];
+	float point[3], direction[3];
+	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float dot_min, dot_max, dot_offset;
+	int enc_c0, enc_c1;
+	int values[16];
+	int i;
+	__m128 sum_r, sum_g, sum_b, sum_rr, sum_gg, sum_bb, sum_rg, sum_rb, sum_gb;
+	for( i = 0; i < 16; ++i )
+	{
+		r[i] = uncompressed[i*channels+0];
+		g[i] = uncompressed[i*channels+1];
+		b[i] = uncompressed[i*channels+2];
+	}
+	/*	covariance sums, 4 pixels at a time	*/
+	sum_r = sum_g = sum_b = _mm_setzero_ps();
+	sum_rr = sum_gg = sum_bb = _mm_setzero_ps();
+	sum_rg = sum_rb = sum_gb = _mm_setzero_ps();
+	for( i = 0; i < 16; i += 4 )
+	{
+		__m128 vr = _mm_loadu_ps( r + i );
+		__m128 vg = _mm_loadu_ps( g + i );
+		__m128 vb = _mm_loadu_ps( b + i );
+		sum_r = _mm_add_ps( sum_r, vr );
+		sum_g = _mm_add_ps( sum_g, vg );
+		sum_b = _mm_add_ps( sum_b, vb );
+		sum_rr = _mm_add_ps( sum_rr, _mm_mul_ps( vr, vr ) );
+		sum_gg = _mm_add_ps( sum_gg, _mm_mul_ps( vg, vg ) );
+		sum_bb = _mm_add_ps( sum_bb, _mm_mul_ps( vb, vb ) );
+		sum_rg = _mm_add_ps( sum_rg, _mm_mul_ps( vr, vg ) );
+		sum_rb = _mm_add_ps( sum_rb, _mm_mul_ps( vr, vb ) );
+		sum_gb = _mm_add_ps( sum_gb, _mm_mul_ps( vg, vb ) );
+	}
+	color_line_from_sums(
+		sum_lanes( sum_r ), sum_lanes( sum_g ), sum_lanes( sum_b ),
+		sum_lanes( sum_rr ), sum_lanes( sum_gg ), sum_lanes( sum_bb ),
+		sum_lanes( sum_rg ), sum_lanes( sum_rb ), sum_lanes( sum_gb ),
+		point, direction );
+	/*	extent of the pixels along the line	*/
+	{
+		__m128 dx = _mm_set1_ps( direction[0] );
+		__m128 dy = _mm_set1_ps( direction[1] );
+		__m128 dz = _mm_set1_ps( direction[2] );
+		__m128 mn = _mm_set1_ps( 0.0f ), mx = _mm_set1_ps( 0.0f );
+		for( i = 0; i < 16; i += 4 )
+		{
+			__m128 dot = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( dx, _mm_loadu_ps( r + i ) ), _mm_mul_ps( dy, _mm_loadu_ps( g + i ) ) ),
+				_mm_mul_ps( dz, _mm_loadu_ps( b + i ) ) );
+			mn = i ? _mm_min_ps( mn, dot ) : dot;
+			mx = i ? _mm_max_ps( mx, dot ) : dot;
+		}
+		dot_min = min_lanes( mn );
+		dot_max = max_lanes( mx );
+	}
+	master_colors_from_line( point, direction, dot_min, dot_max, &enc_c0, &enc_c1 );
+	/*	palette index of every pixel	*/
+	dot_offset = color_palette_line( enc_c0, enc_c1, color_line );
+	{
+		__m128 cx = _mm_set1_ps( color_line[0] );
+		__m128 cy = _mm_set1_ps( color_line[1] );
+		__m128 cz = _mm_set1_ps( color_line[2] );
+		__m128 offset = _mm_set1_ps( dot_offset );
+		for( i = 0; i < 16; i += 8 )
+		{
+			__m128 dot0 = _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( cx, _mm_loadu_ps( r + i ) ), _mm_mul_ps( cy, _mm_loadu_ps( g + i ) ) ),
+				_mm_mul_ps( cz, _mm_loadu_ps( b + i ) ) ), offset );
+			__m128 dot1 = _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( cx, _mm_loadu_ps( r + i + 4 ) ), _mm_mul_ps( cy, _mm_loadu_ps( g + i + 4 ) ) ),
+				_mm_mul_ps( cz, _mm_loadu_ps( b + i + 4 ) ) ), offset );
+			__m128i value0 = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( dot0, _mm_set1_ps( 3.0f ) ), _mm_set1_ps( 0.5f ) ) );
+			__m128i value1 = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( dot1, _mm_set1_ps( 3.0f ) ), _mm_set1_ps( 0.5f ) ) );
+			/*	SSE2 has no 32 bit min/max, clamp as saturated 16 bit values	*/
+			__m128i packed = _mm_packs_epi32( value0, value1 );
+			packed = _mm_max_epi16( _mm_min_epi16( packed, _mm_set1_epi16( 3 ) ), _mm_setzero_si128() );
+			_mm_storeu_si128( (__m128i*)(values + i), _mm_unpacklo_epi16( packed, _mm_setzero_si128() ) );
+			_mm_storeu_si128( (__m128i*)(values + i + 4), _mm_unpackhi_epi16( packed, _mm_setzero_si128() ) );
+		}
+	}
+	store_color_block( enc_c0, enc_c1, values, compressed );
+}
+
+void
+	compress_DDS_alpha_block_SSE
+	(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	unsigned char alpha[16];
+	int values[16];
+	int i, a0, a1;
+	float scale_me;
+	__m128i a, lo, hi, words;
+	__m128 scale, base;
+	for( i = 0; i < 16; ++i )
+	{
+		alpha[i] = uncompressed[i*4+3];
+	}
+	/*	get the alpha limits (a0 > a1)	*/
+	a = _mm_loadu_si128( (const __m128i*)alpha );
+	hi = _mm_max_epu8( a, _mm_srli_si128( a, 8 ) );
+	hi = _mm_max_epu8( hi, _mm_srli_si128( hi, 4 ) );
+	hi = _mm_max_epu8( hi, _mm_srli_si128( hi, 2 ) );
+	hi = _mm_max_epu8( hi, _mm_srli_si128( hi, 1 ) );
+	lo = _mm_min_epu8( a, _mm_srli_si128( a, 8 ) );
+	lo = _mm_min_epu8( lo, _mm_srli_si128( lo, 4 ) );
+	lo = _mm_min_epu8( lo, _mm_srli_si128( lo, 2 ) );
+	lo = _mm_min_epu8( lo, _mm_srli_si128( lo, 1 ) );
+	a0 = _mm_cvtsi128_si32( hi ) & 255;
+	a1 = _mm_cvtsi128_si32( lo ) & 255;
+	/*	3 bit positions, (alpha - a1) * scale truncated like the scalar code	*/
+	scale_me = 7.9999f / (a0 - a1);
+	scale = _mm_set1_ps( scale_me );
+	base = _mm_set1_ps( (float)a1 );
+	for( i = 0; i < 16; i += 8 )
+	{
+		words = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)(alpha + i) ), _mm_setzero_si128() );
+		_mm_storeu_si128( (__m128i*)(values + i), _mm_cvttps_epi32( _mm_mul_ps( _mm_sub_ps(
+			_mm_cvtepi32_ps( _mm_unpacklo_epi16( words, _mm_setzero_si128() ) ), base ), scale ) ) );
+		_mm_storeu_si128( (__m128i*)(values + i + 4), _mm_cvttps_epi32( _mm_mul_ps( _mm_sub_ps(
+			_mm_cvtepi32_ps( _mm_unpackhi_epi16( words, _mm_setzero_si128() ) ), base ), scale ) ) );
+	}
+	store_alpha_block( a0, a1, values, compressed );
+}
+#endif
+
+static void encode_color_block(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8],
+		int use_SIMD )
+{
+#ifdef DXT_SSE
+	if( use_SIMD )
+	{
+		compress_DDS_color_block_SSE( channels, uncompressed, compressed );
+		return;
+	}
+#endif
+	compress_DDS_color_block( channels, uncompressed, compressed );
+}
+
+static void encode_alpha_block(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8],
+		int use_SIMD )
+{
+#ifdef DXT_SSE
+	if( use_SIMD )
+	{
+		compress_DDS_alpha_block_SSE( uncompressed, compressed );
+		return;
+	}
+#endif
+	compress_DDS_alpha_block( uncompressed, compressed );
+}
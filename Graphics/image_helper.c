@@ -8,8 +8,21 @@
 
 #include "image_helper.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+/*	SSE2 kernels for mipmap_image_rows, AVX2 for the vertical pass when
+	the compiler targets it.  Every path adds the filter taps in the same
+	order, so the results don't depend on which one ran	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SSE 1
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_AVX2 1
+#endif
+#endif
+
 /*	Upscaling the image uses simple bilinear interpolation	*/
 int
 	up_scale_image
@@ -151,6 +164,423 @@ int
 	return 1;
 }
 
+/*	sRGB code -> linear light, and the linear value at which each code
+	starts when rounding back (halfway between two codes in sRGB space)	*/
+static const float srgb_to_linear[256] =
+{
+	0.0f, 0.000303526984f, 0.000607053967f, 0.000910580951f, 0.00121410793f, 0.00151763492f, 0.0018211619f, 0.00212468888f,
+	0.00242821587f, 0.00273174285f, 0.00303526984f, 0.00334653576f, 0.00367650732f, 0.00402471702f, 0.00439144204f, 0.00477695348f,
+	0.0051815167f, 0.00560539162f, 0.00604883302f, 0.00651209079f, 0.00699541019f, 0.00749903204f, 0.00802319299f, 0.00856812562f,
+	0.0091340587f, 0.00972121732f, 0.010329823f, 0.010960094f, 0.0116122452f, 0.0122864884f, 0.0129830323f, 0.013702083f,
+	0.0144438436f, 0.0152085144f, 0.0159962934f, 0.0168073758f, 0.0176419545f, 0.0185002201f, 0.019382361f, 0.0202885631f,
+	0.0212190104f, 0.0221738848f, 0.0231533662f, 0.0241576324f, 0.0251868596f, 0.0262412219f, 0.0273208916f, 0.0284260395f,
+	0.0295568344f, 0.0307134437f, 0.0318960331f, 0.0331047666f, 0.0343398068f, 0.0356013149f, 0.0368894504f, 0.0382043716f,
+	0.0395462353f, 0.0409151969f, 0.0423114106f, 0.0437350293f, 0.0451862044f, 0.0466650863f, 0.0481718242f, 0.049706566f,
+	0.0512694584f, 0.052860647f, 0.0544802764f, 0.05612849f, 0.0578054302f, 0.0595112382f, 0.0612460542f, 0.0630100177f,
+	0.0648032667f, 0.0666259386f, 0.0684781698f, 0.0703600957f, 0.0722718507f, 0.0742135684f, 0.0761853815f, 0.0781874218f,
+	0.0802198203f, 0.0822827071f, 0.0843762115f, 0.086500462f, 0.0886555863f, 0.0908417112f, 0.0930589628f, 0.0953074666f,
+	0.0975873471f, 0.0998987282f, 0.102241733f, 0.104616484f, 0.107023103f, 0.109461711f, 0.111932428f, 0.114435374f,
+	0.116970668f, 0.119538428f, 0.122138772f, 0.124771818f, 0.12743768f, 0.130136477f, 0.132868322f, 0.13563333f,
+	0.138431615f, 0.141263291f, 0.144128471f, 0.147027266f, 0.14995979f, 0.152926152f, 0.155926464f, 0.158960835f,
+	0.162029376f, 0.165132195f, 0.1682694f, 0.171441101f, 0.174647404f, 0.177888416f, 0.181164244f, 0.184474995f,
+	0.187820772f, 0.191201683f, 0.19461783f, 0.19806932f, 0.201556254f, 0.205078736f, 0.20863687f, 0.212230757f,
+	0.2158605f, 0.2195262f, 0.223227957f, 0.226965874f, 0.230740049f, 0.234550582f, 0.238397574f, 0.242281122f,
+	0.246201327f, 0.250158285f, 0.254152094f, 0.258182853f, 0.262250658f, 0.266355605f, 0.270497791f, 0.274677312f,
+	0.278894263f, 0.28314874f, 0.287440838f, 0.29177065f, 0.296138271f, 0.300543794f, 0.304987314f, 0.309468923f,
+	0.313988713f, 0.318546778f, 0.323143209f, 0.327778098f, 0.332451536f, 0.337163615f, 0.341914425f, 0.346704056f,
+	0.3515326f, 0.356400144f, 0.36130678f, 0.366252596f, 0.37123768f, 0.376262123f, 0.381326011f, 0.386429434f,
+	0.391572478f, 0.396755231f, 0.40197778f, 0.407240212f, 0.412542613f, 0.417885071f, 0.42326767f, 0.428690497f,
+	0.434153636f, 0.439657174f, 0.445201195f, 0.450785783f, 0.456411023f, 0.462077f, 0.467783796f, 0.473531496f,
+	0.479320183f, 0.48514994f, 0.49102085f, 0.496932995f, 0.502886458f, 0.508881321f, 0.514917665f, 0.520995573f,
+	0.527115126f, 0.533276404f, 0.539479489f, 0.545724461f, 0.552011402f, 0.55834039f, 0.564711506f, 0.571124829f,
+	0.57758044f, 0.584078418f, 0.590618841f, 0.597201788f, 0.603827339f, 0.610495571f, 0.617206562f, 0.623960392f,
+	0.630757136f, 0.637596874f, 0.644479682f, 0.651405637f, 0.658374817f, 0.665387298f, 0.672443157f, 0.67954247f,
+	0.686685312f, 0.693871761f, 0.701101892f, 0.70837578f, 0.715693501f, 0.723055129f, 0.73046074f, 0.737910409f,
+	0.74540421f, 0.752942217f, 0.760524505f, 0.768151147f, 0.775822218f, 0.783537792f, 0.79129794f, 0.799102738f,
+	0.806952258f, 0.814846572f, 0.822785754f, 0.830769877f, 0.838799012f, 0.846873232f, 0.854992608f, 0.863157213f,
+	0.871367119f, 0.879622397f, 0.887923118f, 0.896269353f, 0.904661174f, 0.913098652f, 0.921581856f, 0.930110858f,
+	0.938685728f, 0.947306537f, 0.955973353f, 0.964686248f, 0.97344529f, 0.98225055f, 0.991102097f, 1.0f
+};
+
+static const float srgb_thresholds[255] =
+{
+	0.000151763492f, 0.000455290475f, 0.000758817459f, 0.00106234444f, 0.00136587143f, 0.00166939841f, 0.00197292539f, 0.00227645238f,
+	0.00257997936f, 0.00288350634f, 0.0031883009f, 0.00350925935f, 0.00384831493f, 0.00420574803f, 0.00458183274f, 0.00497683725f,
+	0.00539102416f, 0.00582465078f, 0.00627796943f, 0.00675122763f, 0.00724466842f, 0.0077585305f, 0.00829304845f, 0.00884845295f,
+	0.00942497089f, 0.0100228256f, 0.0106422369f, 0.0112834213f, 0.0119465921f, 0.0126319598f, 0.0133397316f, 0.014070112f,
+	0.0148233028f, 0.0155995031f, 0.0163989095f, 0.0172217161f, 0.0180681146f, 0.0189382945f, 0.0198324428f, 0.0207507446f,
+	0.0216933829f, 0.0226605384f, 0.0236523902f, 0.024669115f, 0.0257108881f, 0.0267778826f, 0.0278702702f, 0.0289882206f,
+	0.0301319019f, 0.0313014806f, 0.0324971216f, 0.0337189882f, 0.0349672424f, 0.0362420443f, 0.037543553f, 0.0388719259f,
+	0.0402273192f, 0.0416098877f, 0.0430197848f, 0.0444571628f, 0.0459221727f, 0.047414964f, 0.0489356854f, 0.0504844842f,
+	0.0520615066f, 0.0536668976f, 0.0553008013f, 0.0569633604f, 0.0586547169f, 0.0603750115f, 0.0621243839f, 0.0639029729f,
+	0.0657109163f, 0.0675483509f, 0.0694154125f, 0.0713122362f, 0.0732389559f, 0.0751957047f, 0.077182615f, 0.0791998181f,
+	0.0812474446f, 0.0833256241f, 0.0854344855f, 0.087574157f, 0.0897447658f, 0.0919464383f, 0.0941793004f, 0.096443477f,
+	0.0987390924f, 0.10106627f, 0.103425133f, 0.105815802f, 0.108238401f, 0.110693048f, 0.113179865f, 0.11569897f,
+	0.118250482f, 0.12083452f, 0.1234512f, 0.12610064f, 0.128782955f, 0.131498261f, 0.134246673f, 0.137028306f,
+	0.139843272f, 0.142691686f, 0.14557366f, 0.148489305f, 0.151438734f, 0.154422057f, 0.157439385f, 0.160490827f,
+	0.163576493f, 0.166696492f, 0.169850932f, 0.17303992f, 0.176263564f, 0.179521971f, 0.182815248f, 0.186143498f,
+	0.189506829f, 0.192905345f, 0.196339151f, 0.19980835f, 0.203313045f, 0.20685334f, 0.210429338f, 0.21404114f,
+	0.217688849f, 0.221372565f, 0.225092389f, 0.228848422f, 0.232640764f, 0.236469515f, 0.240334772f, 0.244236636f,
+	0.248175205f, 0.252150577f, 0.256162849f, 0.260212118f, 0.264298482f, 0.268422037f, 0.272582879f, 0.276781103f,
+	0.281016805f, 0.285290081f, 0.289601024f, 0.293949728f, 0.298336289f, 0.302760799f, 0.307223352f, 0.31172404f,
+	0.316262956f, 0.320840192f, 0.325455841f, 0.330109993f, 0.33480274f, 0.339534173f, 0.344304382f, 0.349113458f,
+	0.353961491f, 0.35884857f, 0.363774785f, 0.368740224f, 0.373744977f, 0.378789131f, 0.383872775f, 0.388995998f,
+	0.394158885f, 0.399361525f, 0.404604005f, 0.409886411f, 0.41520883f, 0.420571347f, 0.42597405f, 0.431417022f,
+	0.43690035f, 0.442424119f, 0.447988412f, 0.453593316f, 0.459238914f, 0.46492529f, 0.470652528f, 0.476420711f,
+	0.482229923f, 0.488080246f, 0.493971763f, 0.499904557f, 0.505878709f, 0.511894303f, 0.517951419f, 0.524050139f,
+	0.530190544f, 0.536372716f, 0.542596734f, 0.54886268f, 0.555170635f, 0.561520677f, 0.567912887f, 0.574347344f,
+	0.580824128f, 0.587343319f, 0.593904994f, 0.600509233f, 0.607156115f, 0.613845717f, 0.620578117f, 0.627353395f,
+	0.634171626f, 0.641032889f, 0.647937261f, 0.654884819f, 0.66187564f, 0.668909801f, 0.675987377f, 0.683108445f,
+	0.690273081f, 0.697481362f, 0.704733362f, 0.712029156f, 0.719368822f, 0.726752432f, 0.734180063f, 0.741651788f,
+	0.749167683f, 0.756727821f, 0.764332277f, 0.771981125f, 0.779674438f, 0.787412289f, 0.795194753f, 0.803021903f,
+	0.810893811f, 0.81881055f, 0.826772194f, 0.834778813f, 0.842830482f, 0.850927271f, 0.859069253f, 0.867256499f,
+	0.875489082f, 0.883767073f, 0.892090542f, 0.900459561f, 0.908874202f, 0.917334534f, 0.925840628f, 0.934392556f,
+	0.942990386f, 0.95163419f, 0.960324036f, 0.969059996f, 0.977842139f, 0.986670534f, 0.99554525f
+};
+
+/*	downsampling filters, tap 0 sits first_tap source pixels before the
+	first of the two source pixels under a destination pixel	*/
+static const float box_weights[2] = { 0.5f, 0.5f };
+/*	Kaiser windowed sinc (alpha 4, 2 destination pixels each side),
+	normalized.  Sharper than the box, the negative lobes get clamped	*/
+static const float kaiser_weights[8] =
+{
+	-0.012423150f, -0.042995105f, 0.116919843f, 0.438498412f,
+	0.438498412f, 0.116919843f, -0.042995105f, -0.012423150f
+};
+/*	edge pixels replicated on each side of a filtered row, enough for the
+	widest filter plus the 4 float loads of the 3 channel kernel	*/
+#define MIP_PAD 5
+
+/*	round(encode(value) * 255) by binary search over the thresholds	*/
+static unsigned char linear_to_srgb_byte( float value )
+{
+	int code = 0, step;
+	for( step = 128; step > 0; step >>= 1 )
+	{
+		if( (code + step <= 255) && (srgb_thresholds[code + step - 1] <= value) )
+		{
+			code += step;
+		}
+	}
+	return (unsigned char)code;
+}
+
+static unsigned char unit_to_byte( float value )
+{
+	int v = (int)(value * 255.0f + 0.5f);
+	return (unsigned char)( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+}
+
+/*	writes count channels of one filtered pixel	*/
+static void store_mip_pixel(
+		const float *value, const int *gamma,
+		int count, unsigned char *out )
+{
+	int c;
+	for( c = 0; c < count; ++c )
+	{
+		out[c] = gamma[c] ? linear_to_srgb_byte( value[c] ) : unit_to_byte( value[c] );
+	}
+}
+
+#ifdef MIP_SSE
+/*	unit_to_byte on 4 lanes, writes the first count	*/
+static void store_mip_lanes( __m128 value, int count, unsigned char *out )
+{
+	__m128i v = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( value, _mm_set1_ps( 255.0f ) ), _mm_set1_ps( 0.5f ) ) );
+	int packed;
+	v = _mm_packs_epi32( v, v );
+	v = _mm_packus_epi16( v, v );
+	packed = _mm_cvtsi128_si32( v );
+	memcpy( out, &packed, count );
+}
+#endif
+
+/*	one source row to float, through the per channel decode tables	*/
+static void mip_decode_row(
+		const unsigned char *in, int count, int channels,
+		const float *const *decode, float *out )
+{
+	int x = 0, c;
+#ifdef MIP_SSE
+	if( decode[0] != srgb_to_linear )
+	{
+		/*	no sRGB channel, 16 bytes at a time times 1/255 like the tables	*/
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps( 1.0f / 255.0f );
+		for( ; x + 16 <= count; x += 16 )
+		{
+			__m128i bytes = _mm_loadu_si128( (const __m128i*)(in + x) );
+			__m128i low = _mm_unpacklo_epi8( bytes, zero );
+			__m128i high = _mm_unpackhi_epi8( bytes, zero );
+			_mm_storeu_ps( out + x, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( low, zero ) ), scale ) );
+			_mm_storeu_ps( out + x + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( low, zero ) ), scale ) );
+			_mm_storeu_ps( out + x + 8, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( high, zero ) ), scale ) );
+			_mm_storeu_ps( out + x + 12, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( high, zero ) ), scale ) );
+		}
+		/*	every channel shares the table, the tail needn't start on a pixel	*/
+		for( ; x < count; ++x )
+		{
+			out[x] = decode[0][in[x]];
+		}
+		return;
+	}
+#endif
+	for( ; x < count; x += channels )
+	{
+		for( c = 0; c < channels; ++c )
+		{
+			out[x + c] = decode[c][in[x + c]];
+		}
+	}
+}
+
+/*	sum of tap_count source rows weighted, count floats	*/
+static void mip_vertical_pass(
+		const float *const *rows, const float *weights, int tap_count,
+		float *out, int count )
+{
+	int i = 0, k;
+#ifdef MIP_AVX2
+	for( ; i + 8 <= count; i += 8 )
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for( k = 0; k < tap_count; ++k )
+		{
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_set1_ps( weights[k] ), _mm256_loadu_ps( rows[k] + i ) ) );
+		}
+		_mm256_storeu_ps( out + i, sum );
+	}
+#endif
+#ifdef MIP_SSE
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128 sum = _mm_setzero_ps();
+		for( k = 0; k < tap_count; ++k )
+		{
+			sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[k] ), _mm_loadu_ps( rows[k] + i ) ) );
+		}
+		_mm_storeu_ps( out + i, sum );
+	}
+#endif
+	for( ; i < count; ++i )
+	{
+		float sum = 0.0f;
+		for( k = 0; k < tap_count; ++k )
+		{
+			sum += weights[k] * rows[k][i];
+		}
+		out[i] = sum;
+	}
+}
+
+/*	filters a padded row of width pixels down to mip_width pixels	*/
+static void mip_horizontal_pass(
+		const float *row, int mip_width, int channels,
+		int first_tap, int tap_count, const float *weights,
+		const int *gamma, unsigned char *out )
+{
+	int x = 0, k, c;
+	float value[4];
+#ifdef MIP_SSE
+	/*	only the sRGB encode needs the lanes one at a time	*/
+	int linear = !gamma[0];
+	if( channels == 1 )
+	{
+		/*	4 destination pixels at a time, the even lanes of 8 loaded floats	*/
+		for( ; x + 4 <= mip_width; x += 4 )
+		{
+			__m128 sum = _mm_setzero_ps();
+			for( k = 0; k < tap_count; ++k )
+			{
+				const float *tap = row + 2*x + first_tap + k;
+				__m128 even = _mm_shuffle_ps( _mm_loadu_ps( tap ), _mm_loadu_ps( tap + 4 ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+				sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[k] ), even ) );
+			}
+			if( linear )
+			{
+				store_mip_lanes( sum, 4, out + x );
+			} else
+			{
+				_mm_storeu_ps( value, sum );
+				store_mip_pixel( value, gamma, 1, out + x );
+				store_mip_pixel( value + 1, gamma, 1, out + x + 1 );
+				store_mip_pixel( value + 2, gamma, 1, out + x + 2 );
+				store_mip_pixel( value + 3, gamma, 1, out + x + 3 );
+			}
+		}
+	} else if( (channels == 3) || (channels == 4) )
+	{
+		/*	one pixel per register, the 4th lane of RGB is the next pixel's red and ignored	*/
+		for( ; x < mip_width; ++x )
+		{
+			__m128 sum = _mm_setzero_ps();
+			for( k = 0; k < tap_count; ++k )
+			{
+				__m128 pixel = _mm_loadu_ps( row + (2*x + first_tap + k) * channels );
+				sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[k] ), pixel ) );
+			}
+			if( linear )
+			{
+				store_mip_lanes( sum, channels, out + x*channels );
+			} else
+			{
+				_mm_storeu_ps( value, sum );
+				store_mip_pixel( value, gamma, channels, out + x*channels );
+			}
+		}
+	}
+#endif
+	for( ; x < mip_width; ++x )
+	{
+		for( c = 0; c < channels; ++c )
+		{
+			float sum = 0.0f;
+			for( k = 0; k < tap_count; ++k )
+			{
+				sum += weights[k] * row[(2*x + first_tap + k) * channels + c];
+			}
+			value[c] = sum;
+		}
+		store_mip_pixel( value, gamma, channels, out + x*channels );
+	}
+}
+
+int
+	mipmap_image_rows
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int filter, int srgb,
+		int first_row, int row_count
+	)
+{
+	const float *weights;
+	const float *decode[4];
+	const float *rows[8];
+	float unit[256];
+	float *lines, *padded;
+	int gamma[4];
+	int first_tap, tap_count;
+	int mip_width, mip_height, end_row;
+	int src_first, src_last;
+	int stride, color_channels;
+	int x, y, c, k;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(orig == NULL) || (resampled == NULL) ||
+		(first_row < 0) || (row_count < 1) )
+	{
+		return 0;
+	}
+	mip_width = width / 2;
+	mip_height = height / 2;
+	if( mip_width < 1 )
+	{
+		mip_width = 1;
+	}
+	if( mip_height < 1 )
+	{
+		mip_height = 1;
+	}
+	end_row = first_row + row_count;
+	if( end_row > mip_height )
+	{
+		end_row = mip_height;
+	}
+	if( first_row >= end_row )
+	{
+		/*	nothing to do	*/
+		return 1;
+	}
+	if( filter == MIP_FILTER_KAISER )
+	{
+		first_tap = -3;
+		tap_count = 8;
+		weights = kaiser_weights;
+	} else
+	{
+		first_tap = 0;
+		tap_count = 2;
+		weights = box_weights;
+	}
+	/*	for channels = 2 or 4 the alpha stays linear	*/
+	color_channels = channels - (1 - (channels & 1));
+	for( x = 0; x < 256; ++x )
+	{
+		unit[x] = x * (1.0f / 255.0f);
+	}
+	for( c = 0; c < channels; ++c )
+	{
+		gamma[c] = srgb && (c < color_channels);
+		decode[c] = gamma[c] ? srgb_to_linear : unit;
+	}
+	/*	source rows this band reads, clamped to the image	*/
+	src_first = 2*first_row + first_tap;
+	src_last = 2*(end_row - 1) + first_tap + tap_count - 1;
+	if( src_first < 0 )
+	{
+		src_first = 0;
+	}
+	if( src_last > height - 1 )
+	{
+		src_last = height - 1;
+	}
+	stride = width * channels;
+	lines = (float*)malloc( (size_t)(src_last - src_first + 1) * stride * sizeof(float) );
+	padded = (float*)malloc( ((size_t)(width + 2*MIP_PAD) * channels + 4) * sizeof(float) );
+	if( (lines == NULL) || (padded == NULL) )
+	{
+		free( lines );
+		free( padded );
+		return 0;
+	}
+	/*	each source row goes to float once, color in linear light for srgb	*/
+	for( y = src_first; y <= src_last; ++y )
+	{
+		mip_decode_row( orig + (size_t)y * stride, stride, channels, decode,
+			lines + (size_t)(y - src_first) * stride );
+	}
+	for( x = 0; x < 4; ++x )
+	{
+		padded[(width + 2*MIP_PAD) * channels + x] = 0.0f;
+	}
+	for( y = first_row; y < end_row; ++y )
+	{
+		float *row = padded + MIP_PAD * channels;
+		for( k = 0; k < tap_count; ++k )
+		{
+			int source_row = 2*y + first_tap + k;
+			if( source_row < 0 )
+			{
+				source_row = 0;
+			} else if( source_row > height - 1 )
+			{
+				source_row = height - 1;
+			}
+			rows[k] = lines + (size_t)(source_row - src_first) * stride;
+		}
+		mip_vertical_pass( rows, weights, tap_count, row, stride );
+		/*	clamp to edge addressing for the horizontal taps	*/
+		for( x = 1; x <= MIP_PAD; ++x )
+		{
+			for( c = 0; c < channels; ++c )
+			{
+				row[-x * channels + c] = row[c];
+				row[(width - 1 + x) * channels + c] = row[(width - 1) * channels + c];
+			}
+		}
+		mip_horizontal_pass( row, mip_width, channels, first_tap, tap_count, weights, gamma,
+			resampled + (size_t)y * mip_width * channels );
+	}
+	free( lines );
+	free( padded );
+	return 1;
+}
+
 int
 	scale_image_RGB_to_NTSC_safe
 	(